@@ -1,21 +1,69 @@
+#ifdef __APPLE__
 #include <GLUT/glut.h>
+#include <OpenGL/OpenGL.h>
+#elif defined(_WIN32)
+#define GL_GLEXT_PROTOTYPES
+#include <GL/glut.h>
+#include <GL/wglext.h>
+#else
+#define GL_GLEXT_PROTOTYPES
+#include <GL/glut.h>
+#include <GL/glx.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#define PENALTY_HAS_EGL 1
+#endif
+#ifdef FREEGLUT
+#include <GL/freeglut_ext.h> // glutInitContextVersion() for --gl-core
+#endif
 #include <iostream>
 #include <string>
 #include <sstream>
+#include <fstream>
 #include <vector>
 #include <cmath>
 #include <cstdlib>
+#include <cstring>
+#include <cstdint>
 #include <ctime>
+#include <chrono>
+#include <thread>
 #include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <cstdio>
+#include <cerrno>
+#include <cctype>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#define PENALTY_HAS_SOCKETS 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define PENALTY_HAS_SSE2 1
+#endif
 
 #define PI 3.14159265359
 
 // --- Game Constants ---
 const int MAX_ROUNDS = 5;
-const int ANIMATION_FPS = 60;
 const int ANIMATION_DURATION_MS = 500;
-const int ANIMATION_TIMER_MS = 1000 / ANIMATION_FPS;
-const int TOTAL_ANIMATION_STEPS = ANIMATION_DURATION_MS / ANIMATION_TIMER_MS;
+// The simulation advances in fixed steps driven by the real clock; rendering interpolates
+// between the last two steps, so shot timing does not depend on frame rate or timer lateness.
+const int SIM_STEPS_PER_SECOND = 120;
+const double SIM_STEP_SECONDS = 1.0 / SIM_STEPS_PER_SECOND;
+const int TOTAL_ANIMATION_STEPS = ANIMATION_DURATION_MS * SIM_STEPS_PER_SECOND / 1000;
+const double MAX_FRAME_SECONDS = 0.25; // Clamp for long stalls so the loop never spirals
 
 // --- 3D Scene Coordinates ---
 const float GOAL_LINE_Z = -8.0f;
@@ -29,16 +77,36 @@ const float PLAYER_BODY_DEPTH = 0.2f;
 const float PLAYER_LIMB_THICKNESS = 0.12f;
 const float KICKER_POS_Z = PENALTY_SPOT_Z + 0.8f;
 const float GK_BODY_Y_OFFSET = 0.8f;
-const float GK_CENTER_X = 0.0f;
-const float GK_LEFT_X = -1.8f;
-const float GK_RIGHT_X = 1.8f;
+constexpr float GK_CENTER_X = 0.0f;
+constexpr float GK_LEFT_X = -1.8f;
+constexpr float GK_RIGHT_X = 1.8f;
+constexpr float GK_REACH_HEIGHT = 2.0f; // Standing reach with the arms up
 const float GOAL_WIDTH = 4.0f;
 const float GOAL_HEIGHT = 2.0f;
 const float POST_THICKNESS = 0.1f;
 const float NET_DEPTH = 1.5f;
+const float PITCH_MIN_X = -20.0f, PITCH_MAX_X = 20.0f;
+const float PITCH_NEAR_Z = 10.0f, PITCH_FAR_Z = -20.0f;
+const float CAMERA_FOV_Y = 45.0f;
+const float CAMERA_EYE_Y = 1.5f;
+const float CAMERA_EYE_Z = KICKER_POS_Z + 3.0f;
+const float CAMERA_TARGET_Y = 0.8f;
+const float CAMERA_TARGET_Z = GOAL_LINE_Z + 1.0f;
+const float CAMERA_NEAR = 0.1f, CAMERA_FAR = 100.0f;
+
+// Ball levels of detail, finest first. A level is used while the ball's projected radius is at
+// least min_pixel_radius; the seams are precomputed latitude/longitude lines.
+struct BallLodSpec
+{
+    int slices, stacks;
+    int seam_slices, seam_stacks;
+    float min_pixel_radius;
+};
+const BallLodSpec BALL_LODS[] = {{32, 24, 12, 10, 24.0f}, {16, 16, 10, 10, 8.0f}, {10, 8, 6, 6, 0.0f}};
+const int BALL_LOD_COUNT = sizeof(BALL_LODS) / sizeof(BALL_LODS[0]);
 
 // --- Game State Enums ---
-enum GameState
+enum GameState : unsigned char
 {
     INTRO,
     WAITING_FOR_SHOT,
@@ -47,551 +115,8460 @@ enum GameState
     DISPLAY_RESULT,
     GAME_OVER
 };
-enum Direction
+enum ShotOutcome : unsigned char
 {
-    LEFT,
-    MIDDLE,
-    RIGHT,
-    NONE
+    SHOT_PENDING,
+    SHOT_GOAL,
+    SHOT_SAVED,
+    SHOT_WOODWORK, // Hit the post or bar and stayed out
+    SHOT_WIDE
 };
 
-// --- Global State Variables ---
-GameState game_state = INTRO;
-int player_goals = 0, ai_goals = 0, current_round = 1;
-bool is_player_turn = true, last_shot_was_goal = false;
-Direction player_shot_choice = MIDDLE, player_dive_choice = NONE;
-Direction ai_shot_choice = MIDDLE, ai_dive_choice = MIDDLE;
-float ball_x = GK_CENTER_X, ball_y = BALL_Y, ball_z = PENALTY_SPOT_Z;
-float gk_x = GK_CENTER_X, gk_y = GROUND_Y + GK_BODY_Y_OFFSET, gk_z = GOAL_LINE_Z;
-float target_ball_x = GK_CENTER_X, target_gk_x = GK_CENTER_X;
-float start_ball_x = GK_CENTER_X, start_ball_z = PENALTY_SPOT_Z, start_gk_x = GK_CENTER_X;
-int animation_steps = 0;
-GLuint grassTextureID;
-int window_width = 800, window_height = 600;
+// --- Shootout Rules ---
+// Round and scoring rules shared by the game and the headless simulator. The game decides each
+// kick with the ball-flight physics below; the simulator uses isGoal() as its direction-only model,
+// which has no wides or woodwork, so its win rates describe a different game from the window's.
+const int MAX_SUDDEN_DEATH_ROUNDS = 100; // Headless cap; a match still level after this counts as a draw
 
-// --- Forward Declarations ---
-void resetGame();
-void drawText_2D(float x, float y, const char *text, void *font = GLUT_BITMAP_HELVETICA_18);
-void initGraphics();
-void startAnimation();
-void drawPlayerFigure(float x, float y_base, float z, float r, float g, float b, bool is_goalkeeper);
-void drawScene();
-void drawUI();
-void advanceRound();
-void updateGameLogic(int value);                   // Renamed from animation_loop
-void renderScene();                                // New function for all drawing
-void handleInput(unsigned char key, int x, int y); // New function for input
+/**
+ * @brief True once both sides have kicked in `round` and the shootout has a winner.
+ */
+inline bool isShootoutDecided(int round, int goals_a, int goals_b)
+{
+    return round >= MAX_ROUNDS && goals_a != goals_b;
+}
 
-void initGraphics()
+/**
+ * @brief Small xorshift64* generator. The headless simulator keeps one per worker thread; each
+ * Match draws the AI's choices from its own, so a seed plus the key log replays a match.
+ */
+struct SimRng
 {
-    GLubyte grassPattern[2 * 2][3] = {{34, 139, 34}, {0, 100, 0}, {0, 100, 0}, {34, 139, 34}};
-    glGenTextures(1, &grassTextureID);
-    glBindTexture(GL_TEXTURE_2D, grassTextureID);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 2, 2, 0, GL_RGB, GL_UNSIGNED_BYTE, grassPattern);
-    glEnable(GL_LIGHTING);
-    glEnable(GL_LIGHT0);
-    glEnable(GL_COLOR_MATERIAL);
-    GLfloat light_pos[] = {0.0f, 5.0f, 5.0f, 1.0f};
-    glLightfv(GL_LIGHT0, GL_POSITION, light_pos);
-    glShadeModel(GL_SMOOTH);
+    uint64_t state;
+    explicit SimRng(uint64_t seed = 0) : state(seed ? seed : 0x9E3779B97F4A7C15ULL) {}
+    uint32_t next()
+    {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return (uint32_t)((state * 0x2545F4914F6CDD1DULL) >> 32);
+    }
+    float nextFloat() // Uniform in [0, 1)
+    {
+        return (next() >> 8) * (1.0f / 16777216.0f);
+    }
+};
+
+// --- Target Grid ---
+// The goal mouth is split into columns x rows target zones; the classic game is one row of three.
+// A zone is row * columns + column, top row first. Each supported grid size gets its own tables,
+// built at compile time from the goal geometry, so turning a key into a zone, a zone into aim and
+// keeper positions, and a shot and a dive into a save chance are all single lookups.
+typedef unsigned char Zone;
+const Zone LEFT = 0, MIDDLE = 1, RIGHT = 2; // The classic grid's zones
+const Zone NO_ZONE = 0xFF;
+const int MAX_GRID_COLUMNS = 3, MAX_GRID_ROWS = 3; // Sizes the opponent model in every Match
+constexpr float SHOT_MIN_HEIGHT = 0.2f, SHOT_MAX_HEIGHT = 1.85f; // Split evenly between the rows
+constexpr float GK_ZONE_REACH = 1.6f; // On a grid with several rows, a dive covers this many rows of height
+const char ZONE_KEY_BLOCK[] = "qwertasdfgzxcvb"; // Keyboard rows map to goal rows; one-row grids use L/M/R
+
+struct TargetGrid
+{
+    const char *name; // "3x1"
+    int columns, rows, zones;
+    const char *keys;          // Key for each zone
+    const Zone *key_zone;      // [256]: zone for each key, or NO_ZONE
+    const float *zone_x;       // Where the keeper dives to and shots are aimed along
+    const float *aim_low;      // Bottom of the height band a shot at the zone is struck into
+    float aim_span;            // Height of that band
+    const float *reach_low;    // Bottom of the keeper's reach after diving to the zone
+    float reach_height;        // Height the reach covers
+    const float *save;         // [shot * zones + dive]: chance the dive saves the shot
+    const uint64_t *save_cut;  // The same as a cut-off on a 32-bit draw
+};
+
+constexpr float clampZoneValue(float v, float lo, float hi)
+{
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+constexpr char zoneKey(int columns, int rows, int zone)
+{
+    return rows == 1 && columns == 3 ? "lmr"[zone] : ZONE_KEY_BLOCK[zone / columns * 5 + zone % columns];
+}
+
+constexpr int keyZone(int columns, int rows, int key, int zone)
+{
+    return zone >= columns * rows ? NO_ZONE
+                                  : (zoneKey(columns, rows, zone) == key ? zone : keyZone(columns, rows, key, zone + 1));
+}
+
+constexpr float zoneX(int columns, int zone)
+{
+    return columns == 1 ? GK_CENTER_X : GK_LEFT_X + (GK_RIGHT_X - GK_LEFT_X) * (zone % columns) / (columns - 1);
+}
+
+constexpr float zoneAimSpan(int rows)
+{
+    return (SHOT_MAX_HEIGHT - SHOT_MIN_HEIGHT) / rows;
+}
+
+constexpr float zoneAimLow(int columns, int rows, int zone)
+{
+    return SHOT_MIN_HEIGHT + (SHOT_MAX_HEIGHT - SHOT_MIN_HEIGHT) * (rows - 1 - zone / columns) / rows;
+}
+
+constexpr float zoneReachHeight(int rows)
+{
+    return rows == 1 ? GK_REACH_HEIGHT : GK_REACH_HEIGHT * GK_ZONE_REACH / rows;
+}
+
+constexpr float zoneReachLow(int columns, int rows, int zone)
+{
+    return clampZoneValue(zoneAimLow(columns, rows, zone) + (zoneAimSpan(rows) - zoneReachHeight(rows)) / 2, 0.0f,
+                          GK_REACH_HEIGHT - zoneReachHeight(rows));
+}
+
+constexpr float zoneOverlap(float low_a, float height_a, float low_b, float height_b)
+{
+    return (low_a + height_a < low_b + height_b ? low_a + height_a : low_b + height_b) -
+           (low_a > low_b ? low_a : low_b);
 }
 
 /**
- * @brief Draws the static 3D scene elements. (Implementation unchanged)
+ * @brief Share of the shot's height band inside the keeper's reach after diving to `dive`.
  */
-void drawScene()
+constexpr float zoneReachOverlap(int columns, int rows, int shot, int dive)
 {
-    glEnable(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, grassTextureID);
-    glColor3f(0.8f, 0.8f, 0.8f);
-    glBegin(GL_QUADS);
-    glTexCoord2f(0.0f, 0.0f);
-    glVertex3f(-20.0f, GROUND_Y, 10.0f);
-    glTexCoord2f(40.0f, 0.0f);
-    glVertex3f(20.0f, GROUND_Y, 10.0f);
-    glTexCoord2f(40.0f, 40.0f);
-    glVertex3f(20.0f, GROUND_Y, -20.0f);
-    glTexCoord2f(0.0f, 40.0f);
-    glVertex3f(-20.0f, GROUND_Y, -20.0f);
-    glEnd();
-    glDisable(GL_TEXTURE_2D);
-    glColor3f(1.0f, 1.0f, 1.0f);
-    glPushMatrix();
-    glTranslatef(-GOAL_WIDTH / 2, GROUND_Y + GOAL_HEIGHT / 2, GOAL_LINE_Z);
-    glScalef(POST_THICKNESS, GOAL_HEIGHT, POST_THICKNESS);
-    glutSolidCube(1.0);
-    glPopMatrix();
-    glPushMatrix();
-    glTranslatef(GOAL_WIDTH / 2, GROUND_Y + GOAL_HEIGHT / 2, GOAL_LINE_Z);
-    glScalef(POST_THICKNESS, GOAL_HEIGHT, POST_THICKNESS);
-    glutSolidCube(1.0);
-    glPopMatrix();
-    glPushMatrix();
-    glTranslatef(0.0f, GROUND_Y + GOAL_HEIGHT, GOAL_LINE_Z);
-    glScalef(GOAL_WIDTH + POST_THICKNESS, POST_THICKNESS, POST_THICKNESS);
-    glutSolidCube(1.0);
-    glPopMatrix();
-    glColor3f(0.8f, 0.8f, 0.8f);
-    glLineWidth(1.0);
-    glDisable(GL_LIGHTING);
-    glBegin(GL_LINES);
-    for (float x = -GOAL_WIDTH / 2; x <= GOAL_WIDTH / 2; x += 0.4f)
-    {
-        glVertex3f(x, GROUND_Y, GOAL_LINE_Z);
-        glVertex3f(x, GOAL_HEIGHT, GOAL_LINE_Z);
-        glVertex3f(x, GROUND_Y, GOAL_LINE_Z);
-        glVertex3f(x, GROUND_Y, GOAL_LINE_Z - NET_DEPTH);
-        glVertex3f(x, GOAL_HEIGHT, GOAL_LINE_Z);
-        glVertex3f(x, GOAL_HEIGHT, GOAL_LINE_Z - NET_DEPTH);
-    }
-    for (float y = GROUND_Y; y <= GOAL_HEIGHT; y += 0.4f)
-    {
-        glVertex3f(-GOAL_WIDTH / 2, y, GOAL_LINE_Z);
-        glVertex3f(GOAL_WIDTH / 2, y, GOAL_LINE_Z);
-        glVertex3f(-GOAL_WIDTH / 2, y, GOAL_LINE_Z - NET_DEPTH);
-        glVertex3f(GOAL_WIDTH / 2, y, GOAL_LINE_Z - NET_DEPTH);
-    }
-    glVertex3f(-GOAL_WIDTH / 2, GROUND_Y, GOAL_LINE_Z);
-    glVertex3f(-GOAL_WIDTH / 2, GROUND_Y, GOAL_LINE_Z - NET_DEPTH);
-    glVertex3f(GOAL_WIDTH / 2, GROUND_Y, GOAL_LINE_Z);
-    glVertex3f(GOAL_WIDTH / 2, GROUND_Y, GOAL_LINE_Z - NET_DEPTH);
-    glVertex3f(-GOAL_WIDTH / 2, GOAL_HEIGHT, GOAL_LINE_Z);
-    glVertex3f(-GOAL_WIDTH / 2, GOAL_HEIGHT, GOAL_LINE_Z - NET_DEPTH);
-    glVertex3f(GOAL_WIDTH / 2, GOAL_HEIGHT, GOAL_LINE_Z);
-    glVertex3f(GOAL_WIDTH / 2, GOAL_HEIGHT, GOAL_LINE_Z - NET_DEPTH);
-    glVertex3f(0.0f, GOAL_HEIGHT, GOAL_LINE_Z);
-    glVertex3f(0.0f, GOAL_HEIGHT, GOAL_LINE_Z - NET_DEPTH);
-    glEnd();
-    glEnable(GL_LIGHTING);
-    glColor3f(1.0, 1.0, 1.0);
-    glLineWidth(2.0);
-    glBegin(GL_LINES);
-    glVertex3f(-0.1, GROUND_Y + 0.01, PENALTY_SPOT_Z);
-    glVertex3f(0.1, GROUND_Y + 0.01, PENALTY_SPOT_Z);
-    glEnd();
-    glLineWidth(1.0);
+    return zoneReachLow(columns, rows, dive) <= zoneAimLow(columns, rows, shot) &&
+                   zoneAimLow(columns, rows, shot) + zoneAimSpan(rows) <=
+                       zoneReachLow(columns, rows, dive) + zoneReachHeight(rows)
+               ? 1.0f
+               : clampZoneValue(zoneOverlap(zoneAimLow(columns, rows, shot), zoneAimSpan(rows),
+                                            zoneReachLow(columns, rows, dive), zoneReachHeight(rows)) /
+                                    zoneAimSpan(rows),
+                                0.0f, 1.0f);
+}
+
+/**
+ * @brief Chance a dive to `dive` saves a shot at `shot`: full in the same column, falling to none
+ * a classic column's width away, times how much of the shot's height the dive reaches. The
+ * classic grid's table is the identity, so a guessed side is a save and anything else a goal.
+ */
+constexpr float zoneSaveChance(int columns, int rows, int shot, int dive)
+{
+    return clampZoneValue(1.0f - (zoneX(columns, shot) > zoneX(columns, dive)
+                                      ? zoneX(columns, shot) - zoneX(columns, dive)
+                                      : zoneX(columns, dive) - zoneX(columns, shot)) /
+                                     (GK_RIGHT_X - GK_CENTER_X),
+                          0.0f, 1.0f) *
+           zoneReachOverlap(columns, rows, shot, dive);
+}
+
+template <int... I> struct IndexList
+{
+};
+template <int N, int... I> struct MakeIndexList : MakeIndexList<N - 1, N - 1, I...>
+{
+};
+template <int... I> struct MakeIndexList<0, I...>
+{
+    typedef IndexList<I...> type;
+};
+
+/**
+ * @brief One grid size's lookup tables, each entry a constant expression. Z runs over zones, P
+ * over (shot, dive) pairs and K over key codes.
+ */
+template <int COLUMNS, int ROWS, typename Zones = typename MakeIndexList<COLUMNS * ROWS>::type,
+          typename Pairs = typename MakeIndexList<COLUMNS * ROWS * COLUMNS * ROWS>::type,
+          typename Keys = typename MakeIndexList<256>::type>
+struct GridTables;
+
+template <int COLUMNS, int ROWS, int... Z, int... P, int... K>
+struct GridTables<COLUMNS, ROWS, IndexList<Z...>, IndexList<P...>, IndexList<K...>>
+{
+    static_assert(COLUMNS <= MAX_GRID_COLUMNS && ROWS <= MAX_GRID_ROWS, "Grid is larger than the opponent model");
+    static_assert(ROWS > 1 || COLUMNS == 3, "Grid has no key layout");
+    static const int ZONES = COLUMNS * ROWS;
+    static constexpr char keys[ZONES + 1] = {zoneKey(COLUMNS, ROWS, Z)..., '\0'};
+    static constexpr Zone key_zone[256] = {(Zone)keyZone(COLUMNS, ROWS, K, 0)...};
+    static constexpr float zone_x[ZONES] = {zoneX(COLUMNS, Z)...};
+    static constexpr float aim_low[ZONES] = {zoneAimLow(COLUMNS, ROWS, Z)...};
+    static constexpr float reach_low[ZONES] = {zoneReachLow(COLUMNS, ROWS, Z)...};
+    static constexpr float save[ZONES * ZONES] = {zoneSaveChance(COLUMNS, ROWS, P / ZONES, P % ZONES)...};
+    static constexpr uint64_t save_cut[ZONES * ZONES] = {
+        (uint64_t)(zoneSaveChance(COLUMNS, ROWS, P / ZONES, P % ZONES) * 4294967296.0)...};
+};
+
+template <int C, int R, int... Z, int... P, int... K>
+constexpr char GridTables<C, R, IndexList<Z...>, IndexList<P...>, IndexList<K...>>::keys[];
+template <int C, int R, int... Z, int... P, int... K>
+constexpr Zone GridTables<C, R, IndexList<Z...>, IndexList<P...>, IndexList<K...>>::key_zone[];
+template <int C, int R, int... Z, int... P, int... K>
+constexpr float GridTables<C, R, IndexList<Z...>, IndexList<P...>, IndexList<K...>>::zone_x[];
+template <int C, int R, int... Z, int... P, int... K>
+constexpr float GridTables<C, R, IndexList<Z...>, IndexList<P...>, IndexList<K...>>::aim_low[];
+template <int C, int R, int... Z, int... P, int... K>
+constexpr float GridTables<C, R, IndexList<Z...>, IndexList<P...>, IndexList<K...>>::reach_low[];
+template <int C, int R, int... Z, int... P, int... K>
+constexpr float GridTables<C, R, IndexList<Z...>, IndexList<P...>, IndexList<K...>>::save[];
+template <int C, int R, int... Z, int... P, int... K>
+constexpr uint64_t GridTables<C, R, IndexList<Z...>, IndexList<P...>, IndexList<K...>>::save_cut[];
+
+template <int COLUMNS, int ROWS> constexpr TargetGrid targetGrid(const char *name)
+{
+    typedef GridTables<COLUMNS, ROWS> T;
+    return TargetGrid{name, COLUMNS, ROWS, COLUMNS * ROWS, T::keys, T::key_zone, T::zone_x, T::aim_low,
+                      zoneAimSpan(ROWS), T::reach_low, zoneReachHeight(ROWS), T::save, T::save_cut};
+}
+
+const TargetGrid TARGET_GRIDS[] = {targetGrid<3, 1>("3x1"), targetGrid<3, 2>("3x2"), targetGrid<3, 3>("3x3")};
+const int TARGET_GRID_COUNT = sizeof(TARGET_GRIDS) / sizeof(TARGET_GRIDS[0]);
+const unsigned char CLASSIC_GRID = 0; // Match's default grid; the headless simulator always plays it
+
+bool parseTargetGrid(const char *name, unsigned char &grid)
+{
+    for (int g = 0; g < TARGET_GRID_COUNT; g++)
+    {
+        if (std::strcmp(name, TARGET_GRIDS[g].name) == 0)
+        {
+            grid = (unsigned char)g;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief The direction-only kick model used by the headless simulator: a goal unless the draw
+ * `r` falls under the dive's save chance. Branch-free, one table load.
+ */
+inline bool isGoal(const TargetGrid &grid, Zone shot, Zone dive, uint32_t r)
+{
+    return r >= grid.save_cut[shot * grid.zones + dive];
+}
+
+// --- Opponent Model ---
+// The AI learns the human's habits over a session: decayed counts of each choice, plus what the
+// human picked after their last choice and after their last two, for the target grid's columns
+// and rows separately. A decision reads three rows per axis and an update touches three, whatever
+// the history length, so it stays far inside AI_DECISION_BUDGET_NS (measured by --ai-bench).
+
+enum Difficulty : unsigned char
+{
+    DIFFICULTY_EASY,
+    DIFFICULTY_NORMAL,
+    DIFFICULTY_HARD,
+    DIFFICULTY_COUNT
+};
+
+struct DifficultyTuning
+{
+    const char *name;
+    float decay;       // Weight an old observation keeps per new one; lower forgets and adapts faster
+    float sharpness;   // How hard the AI commits to its best counter (softmax inverse temperature)
+    float exploration; // Share of the mixed strategy kept uniform, so the AI is never a sure read
+};
+const DifficultyTuning DIFFICULTY_TUNING[DIFFICULTY_COUNT] = {
+    {"easy", 0.98f, 2.0f, 0.5f},
+    {"normal", 0.9f, 5.0f, 0.25f},
+    {"hard", 0.75f, 10.0f, 0.1f},
+};
+const long AI_DECISION_BUDGET_NS = 2000; // Choose plus observe; every decision, not just the 99th percentile
+
+/**
+ * @brief Decayed counts over one axis (columns or rows) of one kind of human choice, by context.
+ * N is the most options the axis can have; a grid uses the first `n`.
+ */
+template <int N> struct AxisModel
+{
+    float counts[N];           // Any context
+    float after_one[N][N];     // [previous choice][next choice]
+    float after_two[N * N][N]; // [n * choice before last + last choice][next choice]
+    unsigned char history;     // Last two choices, encoded as the after_two row
+    unsigned char seen;        // Choices observed so far, saturating at 2
+};
+
+/**
+ * @brief A kind of human choice (shots or dives). Columns and rows are learned separately, which
+ * keeps the model small on any grid and lets a habit on one axis show on the other's zones.
+ */
+struct ChoiceModel
+{
+    AxisModel<MAX_GRID_COLUMNS> columns;
+    AxisModel<MAX_GRID_ROWS> rows;
+};
+
+struct OpponentModel
+{
+    ChoiceModel shots, dives;
+    Difficulty difficulty;
+};
+
+bool parseDifficulty(const char *name, Difficulty &difficulty)
+{
+    for (int d = 0; d < DIFFICULTY_COUNT; d++)
+    {
+        if (std::strcmp(name, DIFFICULTY_TUNING[d].name) == 0)
+        {
+            difficulty = (Difficulty)d;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Forgets everything learned; called once per session, not per match.
+ */
+void resetOpponentModel(OpponentModel &model, Difficulty difficulty)
+{
+    std::memset(&model, 0, sizeof(model));
+    model.difficulty = difficulty;
+}
+
+/**
+ * @brief Predicts the next of `n` choices by pooling every context that has evidence. Longer
+ * contexts are weighted up, so a clear pattern soon outvotes overall frequencies.
+ */
+template <int N> static void predictAxis(const AxisModel<N> &am, int n, float p[N])
+{
+    const float *rows[3] = {am.counts, am.seen >= 1 ? am.after_one[am.history % n] : NULL,
+                            am.seen >= 2 ? am.after_two[am.history] : NULL};
+    float total = 0.0f;
+    for (int i = 0; i < n; i++)
+    {
+        p[i] = 1.0f / n; // One pseudo-observation of prior, split evenly
+        for (int order = 0; order < 3; order++)
+            if (rows[order])
+                p[i] += (order + 1) * rows[order][i];
+        total += p[i];
+    }
+    for (int i = 0; i < n; i++)
+        p[i] /= total;
+}
+
+template <int N> static void observeAxis(AxisModel<N> &am, int n, int choice, float decay)
+{
+    float *rows[3] = {am.counts, am.seen >= 1 ? am.after_one[am.history % n] : NULL,
+                      am.seen >= 2 ? am.after_two[am.history] : NULL};
+    for (int order = 0; order < 3; order++)
+    {
+        if (!rows[order])
+            continue;
+        for (int i = 0; i < n; i++)
+            rows[order][i] *= decay;
+        rows[order][choice] += 1.0f;
+    }
+    am.history = (unsigned char)(am.history % n * n + choice);
+    if (am.seen < 2)
+        am.seen++;
+}
+
+/**
+ * @brief Predicted chance of each of the grid's zones, as column times row.
+ */
+static void predictChoice(const ChoiceModel &cm, const TargetGrid &grid, float p[])
+{
+    float columns[MAX_GRID_COLUMNS], rows[MAX_GRID_ROWS] = {1.0f};
+    predictAxis(cm.columns, grid.columns, columns);
+    if (grid.rows > 1) // A single row is certain
+        predictAxis(cm.rows, grid.rows, rows);
+    for (int z = 0; z < grid.zones; z++)
+        p[z] = columns[z % grid.columns] * rows[z / grid.columns];
+}
+
+static void observeChoice(ChoiceModel &cm, const TargetGrid &grid, Zone choice, float decay)
+{
+    observeAxis(cm.columns, grid.columns, choice % grid.columns, decay);
+    if (grid.rows > 1)
+        observeAxis(cm.rows, grid.rows, choice / grid.columns, decay);
+}
+
+/**
+ * @brief Samples a mixed strategy over the AI's options from each one's predicted payoff.
+ * One RNG draw per decision, so a seed still replays a session.
+ */
+static Zone sampleCounter(const float payoff[], int zones, const DifficultyTuning &tuning, SimRng &rng)
+{
+    float weight[MAX_GRID_COLUMNS * MAX_GRID_ROWS], total = 0.0f;
+    for (int i = 0; i < zones; i++)
+        total += weight[i] = std::exp(tuning.sharpness * payoff[i]);
+    float r = rng.nextFloat();
+    for (int i = 0; i < zones - 1; i++)
+    {
+        r -= (1.0f - tuning.exploration) * weight[i] / total + tuning.exploration / zones;
+        if (r < 0.0f)
+            return (Zone)i;
+    }
+    return (Zone)(zones - 1);
+}
+
+/**
+ * @brief Keeper's dive: each zone is worth the chance it saves the shot the human is expected to
+ * play, read from the grid's save table.
+ */
+Zone chooseDive(const OpponentModel &model, const TargetGrid &grid, SimRng &rng)
+{
+    float p[MAX_GRID_COLUMNS * MAX_GRID_ROWS], payoff[MAX_GRID_COLUMNS * MAX_GRID_ROWS];
+    predictChoice(model.shots, grid, p);
+    for (int dive = 0; dive < grid.zones; dive++)
+    {
+        payoff[dive] = 0.0f;
+        for (int shot = 0; shot < grid.zones; shot++)
+            payoff[dive] += p[shot] * grid.save[shot * grid.zones + dive];
+    }
+    return sampleCounter(payoff, grid.zones, DIFFICULTY_TUNING[model.difficulty], rng);
+}
+
+/**
+ * @brief Kicker's zone: each zone is worth the chance it beats the dive the human is expected to
+ * make.
+ */
+Zone chooseShot(const OpponentModel &model, const TargetGrid &grid, SimRng &rng)
+{
+    float p[MAX_GRID_COLUMNS * MAX_GRID_ROWS], payoff[MAX_GRID_COLUMNS * MAX_GRID_ROWS];
+    predictChoice(model.dives, grid, p);
+    for (int shot = 0; shot < grid.zones; shot++)
+    {
+        float saved = 0.0f;
+        for (int dive = 0; dive < grid.zones; dive++)
+            saved += p[dive] * grid.save[shot * grid.zones + dive];
+        payoff[shot] = 1.0f - saved;
+    }
+    return sampleCounter(payoff, grid.zones, DIFFICULTY_TUNING[model.difficulty], rng);
+}
+
+void observeShot(OpponentModel &model, const TargetGrid &grid, Zone shot)
+{
+    observeChoice(model.shots, grid, shot, DIFFICULTY_TUNING[model.difficulty].decay);
+}
+
+void observeDive(OpponentModel &model, const TargetGrid &grid, Zone dive)
+{
+    observeChoice(model.dives, grid, dive, DIFFICULTY_TUNING[model.difficulty].decay);
+}
+
+// --- Match State ---
+/**
+ * @brief One shootout's complete state, so a process can host any number of them side by side.
+ *
+ * Fields read by every fixed step come first and take 64 bytes, the size of one cache line.
+ * The previous step's positions, which a step only stores for the renderer, and the per-kick
+ * fields follow, for 128 bytes in all. The window plays `match`; servers keep contiguous arrays
+ * and drive them through the batch functions startAnimation(), updateGameLogic() and
+ * advanceRound().
+ */
+struct Match
+{
+    // Hot: read by every updateGameLogic() step, 64 bytes
+    GameState state;
+    ShotOutcome shot_outcome; // SHOT_PENDING until the flight decides it
+    bool hit_woodwork;
+    int animation_steps;
+    float ball_x, ball_y, ball_z, gk_x, gk_y; // gk_y: bottom of the keeper's reach, raised for a high dive
+    float ball_vx, ball_vy, ball_vz, spin_x, spin_y; // Spin in rad/s: topspin about x, curve about y
+    float start_gk_x, target_gk_x, start_gk_y, target_gk_y;
+    // Stored by every step, read only by the renderer
+    float prev_ball_x, prev_ball_y, prev_ball_z, prev_gk_x, prev_gk_y; // Previous step, for render interpolation
+    // Cold: once per kick
+    unsigned char grid = CLASSIC_GRID; // Index into TARGET_GRIDS; kept across resetMatch()
+    Zone player_shot_choice, player_dive_choice, ai_shot_choice, ai_dive_choice;
+    bool is_player_turn, last_shot_was_goal;
+    bool versus;                 // The AI side is a second human (netplay); see applyVersusKey()
+    unsigned char versus_ready;  // Bit per side (0 player, 1 AI) that has chosen for this kick
+    int player_goals, ai_goals, current_round;
+    SimRng rng; // AI choices; seeded once per session and written to replay headers
+    unsigned ai_model; // Index into opponentModels; carried across resetMatch() like the RNG
+};
+
+inline const TargetGrid &matchGrid(const Match &m)
+{
+    return TARGET_GRIDS[m.grid];
+}
+
+// The AI's model of each match's human is hundreds of bytes and is only touched once per kick, so
+// it lives out of line. Slot 0 belongs to the window's match.
+std::vector<OpponentModel> opponentModels(1);
+
+inline OpponentModel &aiModel(const Match &m)
+{
+    return opponentModels[m.ai_model];
+}
+
+// --- Shot History ---
+// Every kick the window plays is appended to a memory-mapped log that outlives the session. After
+// a HistoryHeader the file is a run of blocks of HISTORY_BLOCK_SHOTS kicks. Each block starts with
+// a HistorySummary of counts per source, grid and kicker, followed by one byte column per ShotRecord
+// field. Kicks from --simulate are flagged and counted apart, so they never pass for the human's.
+// The summary is padded to HISTORY_ALIGN bytes, so every block and column starts on a cache line.
+// A query over the last N kicks adds up the summaries of whole blocks and scans the columns of at
+// most one partial block, so it never walks the records one by one.
+const char HISTORY_MAGIC[4] = {'P', 'S', 'H', 'L'};
+const uint32_t HISTORY_VERSION = 3; // 2: summaries padded to HISTORY_ALIGN; 3: summaries split by source
+const uint32_t HISTORY_BLOCK_SHOTS = 4096; // A multiple of HISTORY_ALIGN, so the columns stay aligned
+const size_t HISTORY_ALIGN = 64;
+const int HISTORY_ZONES = MAX_GRID_COLUMNS * MAX_GRID_ROWS;
+const int SHOT_OUTCOME_COUNT = SHOT_WIDE + 1;
+const unsigned char HISTORY_AI_KICKED = 1, HISTORY_SUDDEN_DEATH = 2, HISTORY_SIMULATED = 4; // ShotRecord::flags
+const uint64_t HISTORY_SCREEN_SHOTS = 1000000; // The stats screen and "history" policy use the last million kicks
+
+struct ShotRecord
+{
+    unsigned char flags; // HISTORY_AI_KICKED, HISTORY_SUDDEN_DEATH, HISTORY_SIMULATED
+    unsigned char grid;  // Index into TARGET_GRIDS
+    Zone shot, dive;
+    unsigned char outcome; // ShotOutcome
+    unsigned char round;   // Clamped to 255
+};
+enum HistoryColumn
+{
+    COLUMN_FLAGS,
+    COLUMN_GRID,
+    COLUMN_SHOT,
+    COLUMN_DIVE,
+    COLUMN_OUTCOME,
+    COLUMN_ROUND,
+    HISTORY_COLUMNS
+};
+enum HistorySource
+{
+    SOURCE_PLAYED,    // Kicked in the window
+    SOURCE_SIMULATED, // Logged by --simulate
+    HISTORY_SOURCES
+};
+
+/**
+ * @brief Kick counts on one grid, split by who kicked (0 the player, 1 the AI).
+ */
+template <typename T>
+struct ShotCounts
+{
+    T shots[2][HISTORY_ZONES]; // By shot zone
+    T goals[2][HISTORY_ZONES];
+    T dives[2][HISTORY_ZONES]; // By the keeper's dive zone
+    T saves[2][HISTORY_ZONES];
+    T outcomes[2][SHOT_OUTCOME_COUNT];
+    T sudden_death_shots[2], sudden_death_goals[2];
+};
+struct HistorySummary
+{
+    ShotCounts<uint32_t> grids[HISTORY_SOURCES][TARGET_GRID_COUNT];
+};
+struct HistoryHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t block_shots, block_bytes; // The layout the file was written with; it must match to be read
+    uint64_t shots;                    // Committed kicks; raised only once a kick is fully written
+    uint8_t reserved[40];              // Pads the header to HISTORY_ALIGN bytes, where the first block starts
+};
+static_assert(sizeof(HistoryHeader) % HISTORY_ALIGN == 0 && HISTORY_BLOCK_SHOTS % HISTORY_ALIGN == 0,
+              "History blocks and columns would not start on a cache line");
+struct HistoryLog
+{
+    int fd; // -1 while closed
+    bool writable;
+    unsigned char *base; // The whole file, mapped shared
+    size_t mapped;
+};
+HistoryLog shotHistory = {-1, false, NULL, 0};
+
+inline size_t historySummaryBytes()
+{
+    return (sizeof(HistorySummary) + HISTORY_ALIGN - 1) / HISTORY_ALIGN * HISTORY_ALIGN;
+}
+
+inline size_t historyBlockBytes()
+{
+    return historySummaryBytes() + (size_t)HISTORY_COLUMNS * HISTORY_BLOCK_SHOTS;
+}
+
+inline HistoryHeader &historyHeader(const HistoryLog &log)
+{
+    return *(HistoryHeader *)log.base;
+}
+
+inline unsigned char *historyBlock(const HistoryLog &log, uint64_t block)
+{
+    return log.base + sizeof(HistoryHeader) + block * historyBlockBytes();
+}
+
+/**
+ * @brief The kick `m` has just scored, as the history logs it.
+ */
+ShotRecord shotRecord(const Match &m)
+{
+    ShotRecord r;
+    r.flags = (m.is_player_turn ? 0 : HISTORY_AI_KICKED) | (m.current_round > MAX_ROUNDS ? HISTORY_SUDDEN_DEATH : 0);
+    r.grid = m.grid;
+    r.shot = m.is_player_turn ? m.player_shot_choice : m.ai_shot_choice;
+    r.dive = m.is_player_turn ? m.ai_dive_choice : m.player_dive_choice;
+    r.outcome = m.shot_outcome;
+    r.round = (unsigned char)std::min(m.current_round, 255);
+    return r;
+}
+
+inline HistorySource historySource(const ShotRecord &r)
+{
+    return r.flags & HISTORY_SIMULATED ? SOURCE_SIMULATED : SOURCE_PLAYED;
+}
+
+template <typename T>
+inline void countShot(ShotCounts<T> &c, const ShotRecord &r)
+{
+    if (r.shot >= HISTORY_ZONES || r.dive >= HISTORY_ZONES || r.outcome >= SHOT_OUTCOME_COUNT)
+        return; // Torn or foreign data never indexes out of the tables
+    int side = r.flags & HISTORY_AI_KICKED ? 1 : 0;
+    bool goal = r.outcome == SHOT_GOAL;
+    c.shots[side][r.shot]++;
+    c.goals[side][r.shot] += goal;
+    c.dives[side][r.dive]++;
+    c.saves[side][r.dive] += r.outcome == SHOT_SAVED;
+    c.outcomes[side][r.outcome]++;
+    if (r.flags & HISTORY_SUDDEN_DEATH)
+    {
+        c.sudden_death_shots[side]++;
+        c.sudden_death_goals[side] += goal;
+    }
+}
+
+template <typename T, typename U>
+static void addCounts(T *into, const U *from, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        into[i] += from[i];
+}
+
+template <typename T, typename U>
+void addShotCounts(ShotCounts<T> &into, const ShotCounts<U> &from)
+{
+    addCounts(&into.shots[0][0], &from.shots[0][0], 2 * HISTORY_ZONES);
+    addCounts(&into.goals[0][0], &from.goals[0][0], 2 * HISTORY_ZONES);
+    addCounts(&into.dives[0][0], &from.dives[0][0], 2 * HISTORY_ZONES);
+    addCounts(&into.saves[0][0], &from.saves[0][0], 2 * HISTORY_ZONES);
+    addCounts(&into.outcomes[0][0], &from.outcomes[0][0], 2 * SHOT_OUTCOME_COUNT);
+    addCounts(into.sudden_death_shots, from.sudden_death_shots, 2);
+    addCounts(into.sudden_death_goals, from.sudden_death_goals, 2);
+}
+
+static ShotRecord readShot(const unsigned char *columns, size_t slot)
+{
+    ShotRecord r;
+    r.flags = columns[COLUMN_FLAGS * HISTORY_BLOCK_SHOTS + slot];
+    r.grid = columns[COLUMN_GRID * HISTORY_BLOCK_SHOTS + slot];
+    r.shot = columns[COLUMN_SHOT * HISTORY_BLOCK_SHOTS + slot];
+    r.dive = columns[COLUMN_DIVE * HISTORY_BLOCK_SHOTS + slot];
+    r.outcome = columns[COLUMN_OUTCOME * HISTORY_BLOCK_SHOTS + slot];
+    r.round = columns[COLUMN_ROUND * HISTORY_BLOCK_SHOTS + slot];
+    return r;
+}
+
+/**
+ * @brief Where the window keeps its history: $PENALTY_HISTORY, else the per-user data directory.
+ * Returns an empty string when there is nowhere suitable.
+ */
+std::string defaultHistoryPath()
+{
+    const char *path = std::getenv("PENALTY_HISTORY");
+    if (path && *path)
+        return path;
+#ifdef _WIN32
+    const char *base = std::getenv("LOCALAPPDATA");
+    return base ? std::string(base) + "\\penalty-shootout\\history.psh" : std::string();
+#else
+    const char *xdg = std::getenv("XDG_DATA_HOME");
+    if (xdg && *xdg)
+        return std::string(xdg) + "/penalty-shootout/history.psh";
+    const char *home = std::getenv("HOME");
+    return home ? std::string(home) + "/.local/share/penalty-shootout/history.psh" : std::string();
+#endif
+}
+
+/**
+ * @brief True if `a` and `b` name the same file: the same inode where both exist, else the same path.
+ */
+bool sameFile(const std::string &a, const std::string &b)
+{
+    if (a.empty() || b.empty())
+        return false;
+#ifndef _WIN32
+    struct stat info_a, info_b;
+    if (stat(a.c_str(), &info_a) == 0 && stat(b.c_str(), &info_b) == 0)
+        return info_a.st_dev == info_b.st_dev && info_a.st_ino == info_b.st_ino;
+#endif
+    return a == b;
+}
+
+#ifndef _WIN32
+/**
+ * @brief Makes the file (and the mapping) cover `blocks` blocks. Space added by ftruncate() reads
+ * as zeros, which is an empty summary. The file only ever grows, so a reader's mapping stays valid.
+ */
+static bool growHistory(HistoryLog &log, uint64_t blocks)
+{
+    size_t size = sizeof(HistoryHeader) + blocks * historyBlockBytes();
+    if (size <= log.mapped)
+        return true;
+    struct stat info;
+    if (fstat(log.fd, &info) != 0)
+        return false;
+    if ((size_t)info.st_size > size)
+        size = (size_t)info.st_size;
+    else if (size > (size_t)info.st_size && ftruncate(log.fd, (off_t)size) != 0)
+        return false;
+    void *mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, log.fd, 0);
+    if (mapping == MAP_FAILED)
+        return false;
+    munmap(log.base, log.mapped);
+    log.base = (unsigned char *)mapping;
+    log.mapped = size;
+    return true;
+}
+#endif
+
+/**
+ * @brief Recounts the newest block's summary from its committed columns, dropping any kick a crash
+ * left half written.
+ */
+static void rebuildTailSummary(HistoryLog &log)
+{
+    uint64_t shots = historyHeader(log).shots, block = shots / HISTORY_BLOCK_SHOTS;
+    if (sizeof(HistoryHeader) + (block + 1) * historyBlockBytes() > log.mapped)
+        return;
+    unsigned char *b = historyBlock(log, block);
+    HistorySummary &summary = *(HistorySummary *)b;
+    std::memset(&summary, 0, sizeof(summary));
+    for (size_t slot = 0; slot < shots % HISTORY_BLOCK_SHOTS; slot++)
+    {
+        ShotRecord r = readShot(b + historySummaryBytes(), slot);
+        if (r.grid < TARGET_GRID_COUNT)
+            countShot(summary.grids[historySource(r)][r.grid], r);
+    }
+}
+
+static void makeCacheDir(const std::string &dir);
+
+/**
+ * @brief Maps a history log, creating it when `writable`. Refuses a file written with another
+ * layout (a different block size or set of grids) rather than misreading it. Only one process
+ * writes a log at a time: while another holds its lock, a writable open falls back to read-only.
+ */
+bool openHistory(HistoryLog &log, const std::string &path, bool writable)
+{
+#ifdef _WIN32
+    (void)log;
+    (void)path;
+    (void)writable;
+    std::cerr << "Shot history needs mmap, which this platform build does not use\n";
+    return false;
+#else
+    if (writable)
+    {
+        size_t slash = path.find_last_of('/');
+        if (slash != std::string::npos && slash > 0)
+            makeCacheDir(path.substr(0, slash));
+    }
+    int fd = open(path.c_str(), writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+    if (fd < 0)
+    {
+        std::cerr << "Cannot open " << path << "\n";
+        return false;
+    }
+    if (writable && flock(fd, LOCK_EX | LOCK_NB) != 0)
+    {
+        std::cerr << path << " is being written by another process; reading it without logging\n";
+        close(fd);
+        return openHistory(log, path, false);
+    }
+    struct stat info;
+    bool ok = fstat(fd, &info) == 0;
+    if (ok && info.st_size == 0 && writable)
+    {
+        HistoryHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, HISTORY_MAGIC, 4);
+        header.version = HISTORY_VERSION;
+        header.block_shots = HISTORY_BLOCK_SHOTS;
+        header.block_bytes = (uint32_t)historyBlockBytes();
+        ok = pwrite(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header);
+        info.st_size = sizeof(header);
+    }
+    size_t size = ok ? (size_t)info.st_size : 0;
+    void *mapping = MAP_FAILED;
+    if (size >= sizeof(HistoryHeader))
+        mapping = mmap(NULL, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED)
+    {
+        std::cerr << "Cannot map " << path << "\n";
+        close(fd);
+        return false;
+    }
+    HistoryLog opened = {fd, writable, (unsigned char *)mapping, size};
+    const HistoryHeader &header = historyHeader(opened);
+    uint64_t blocks = (header.shots + HISTORY_BLOCK_SHOTS - 1) / HISTORY_BLOCK_SHOTS;
+    if (std::memcmp(header.magic, HISTORY_MAGIC, 4) != 0 || header.version != HISTORY_VERSION ||
+        header.block_shots != HISTORY_BLOCK_SHOTS || header.block_bytes != historyBlockBytes() ||
+        sizeof(HistoryHeader) + blocks * historyBlockBytes() > size)
+    {
+        std::cerr << path << " is not a shot history in this build's layout\n";
+        munmap(mapping, size);
+        close(fd);
+        return false;
+    }
+    log = opened;
+    if (writable)
+        rebuildTailSummary(log);
+    return true;
+#endif
+}
+
+void closeHistory(HistoryLog &log)
+{
+#ifndef _WIN32
+    if (log.fd < 0)
+        return;
+    munmap(log.base, log.mapped);
+    close(log.fd);
+#endif
+    log.fd = -1;
+    log.base = NULL;
+    log.mapped = 0;
+}
+
+/**
+ * @brief Appends one kick: its columns and its block's summary first, then the header's count, so
+ * a reader never sees a kick that is only partly written.
+ */
+bool appendShot(HistoryLog &log, const ShotRecord &r)
+{
+    if (!log.writable || r.grid >= TARGET_GRID_COUNT)
+        return false;
+#ifdef _WIN32
+    return false;
+#else
+    uint64_t shots = historyHeader(log).shots, block = shots / HISTORY_BLOCK_SHOTS;
+    size_t slot = shots % HISTORY_BLOCK_SHOTS;
+    if (!growHistory(log, block + 1))
+        return false;
+    unsigned char *b = historyBlock(log, block), *columns = b + historySummaryBytes();
+    columns[COLUMN_FLAGS * HISTORY_BLOCK_SHOTS + slot] = r.flags;
+    columns[COLUMN_GRID * HISTORY_BLOCK_SHOTS + slot] = r.grid;
+    columns[COLUMN_SHOT * HISTORY_BLOCK_SHOTS + slot] = r.shot;
+    columns[COLUMN_DIVE * HISTORY_BLOCK_SHOTS + slot] = r.dive;
+    columns[COLUMN_OUTCOME * HISTORY_BLOCK_SHOTS + slot] = r.outcome;
+    columns[COLUMN_ROUND * HISTORY_BLOCK_SHOTS + slot] = r.round;
+    countShot(((HistorySummary *)b)->grids[historySource(r)][r.grid], r);
+    std::atomic_thread_fence(std::memory_order_release); // The kick's bytes land before its count
+    historyHeader(log).shots = shots + 1;
+    return true;
+#endif
+}
+
+/**
+ * @brief Counts the kicks from `source` played on `grid` among the log's last `last` kicks. Kicks
+ * another process appended past the end of this mapping are left out.
+ */
+ShotCounts<uint64_t> queryHistory(const HistoryLog &log, uint64_t last, unsigned char grid, HistorySource source)
+{
+    ShotCounts<uint64_t> counts;
+    std::memset(&counts, 0, sizeof(counts));
+    if (!log.base || grid >= TARGET_GRID_COUNT || source >= HISTORY_SOURCES)
+        return counts;
+    uint64_t end = historyHeader(log).shots;
+    std::atomic_thread_fence(std::memory_order_acquire); // Pairs with appendShot(): counted kicks are whole
+    uint64_t mapped_blocks = (log.mapped - sizeof(HistoryHeader)) / historyBlockBytes();
+    if (end > mapped_blocks * HISTORY_BLOCK_SHOTS)
+        end = mapped_blocks * HISTORY_BLOCK_SHOTS;
+    uint64_t begin = end > last ? end - last : 0;
+    for (uint64_t block = begin / HISTORY_BLOCK_SHOTS; block * HISTORY_BLOCK_SHOTS < end; block++)
+    {
+        const unsigned char *b = historyBlock(log, block);
+        uint64_t first = block * HISTORY_BLOCK_SHOTS;
+        if (begin <= first)
+        {
+            addShotCounts(counts, ((const HistorySummary *)b)->grids[source][grid]);
+            continue;
+        }
+        // The one block the range starts inside: scan its grid column, then read the matching kicks
+        const unsigned char *columns = b + historySummaryBytes();
+        const unsigned char *grids = columns + COLUMN_GRID * HISTORY_BLOCK_SHOTS;
+        size_t stop = (size_t)std::min<uint64_t>(HISTORY_BLOCK_SHOTS, end - first);
+        for (size_t slot = (size_t)(begin - first); slot < stop; slot++)
+        {
+            if (grids[slot] != grid)
+                continue;
+            ShotRecord r = readShot(columns, slot);
+            if (historySource(r) == source)
+                countShot(counts, r);
+        }
+    }
+    return counts;
+}
+
+struct HistoryScreen
+{
+    bool shown; // F2
+    bool stale; // A kick was logged, or the screen opened, since the text was built
+    std::vector<std::string> lines;
+};
+HistoryScreen historyScreen;
+
+/**
+ * @brief Logs the window's kick that has just been scored; does nothing without a history.
+ */
+void logWindowShot(const ShotRecord &r)
+{
+    if (appendShot(shotHistory, r))
+        historyScreen.stale = true;
+}
+
+static double percentOf(uint64_t part, uint64_t whole)
+{
+    return whole ? 100.0 * part / whole : 0.0;
+}
+
+/**
+ * @brief Text for the stats screen and --history-stats: each side's conversion per zone, the
+ * keeper's saves and dives, and sudden death, over the kicks from `source` on `grid` among the
+ * last `last`.
+ */
+std::vector<std::string> historyReport(const HistoryLog &log, uint64_t last, unsigned char grid, HistorySource source)
+{
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    ShotCounts<uint64_t> c = queryHistory(log, last, grid, source);
+    double query_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    const TargetGrid &g = TARGET_GRIDS[grid];
+    bool simulated = source == SOURCE_SIMULATED;
+    const char *const played[2] = {"You", "AI"}, *const policies[2] = {"Player policy", "AI policy"};
+    const char *const *kickers = simulated ? policies : played;
+    std::vector<std::string> lines;
+    char line[160];
+    uint64_t kicks[2] = {0, 0}, goals[2] = {0, 0};
+    for (int side = 0; side < 2; side++)
+        for (int z = 0; z < g.zones; z++)
+        {
+            kicks[side] += c.shots[side][z];
+            goals[side] += c.goals[side][z];
+        }
+    std::snprintf(line, sizeof(line), "%llu %s on %s (query %.3f ms)", (unsigned long long)(kicks[0] + kicks[1]),
+                  simulated ? "simulated kicks" : "kicks", g.name, query_ms);
+    lines.push_back(line);
+    for (int side = 0; side < 2; side++)
+    {
+        std::snprintf(line, sizeof(line), "%s kicking: %llu of %llu scored (%.0f%%)", kickers[side],
+                      (unsigned long long)goals[side], (unsigned long long)kicks[side],
+                      percentOf(goals[side], kicks[side]));
+        lines.push_back(line);
+        for (int row = 0; row < g.rows; row++)
+        {
+            int n = 0;
+            for (int column = 0; column < g.columns; column++)
+            {
+                int z = row * g.columns + column;
+                n += std::snprintf(line + n, sizeof(line) - n, "  %c %llu/%llu %.0f%%", toupper(g.keys[z]),
+                                   (unsigned long long)c.goals[side][z], (unsigned long long)c.shots[side][z],
+                                   percentOf(c.goals[side][z], c.shots[side][z]));
+            }
+            lines.push_back(line);
+        }
+        int keeper = 1 - side;
+        std::snprintf(line, sizeof(line), "%s in goal: saved %llu (%.0f%%), dives:", kickers[keeper],
+                      (unsigned long long)c.outcomes[side][SHOT_SAVED], percentOf(c.outcomes[side][SHOT_SAVED], kicks[side]));
+        lines.push_back(line);
+        for (int row = 0; row < g.rows; row++)
+        {
+            int n = 0;
+            for (int column = 0; column < g.columns; column++)
+            {
+                int z = row * g.columns + column;
+                n += std::snprintf(line + n, sizeof(line) - n, "  %c %.0f%%", toupper(g.keys[z]),
+                                   percentOf(c.dives[side][z], kicks[side]));
+            }
+            lines.push_back(line);
+        }
+    }
+    std::snprintf(line, sizeof(line), "Sudden death: %s %llu/%llu, %s %llu/%llu", kickers[0],
+                  (unsigned long long)c.sudden_death_goals[0], (unsigned long long)c.sudden_death_shots[0], kickers[1],
+                  (unsigned long long)c.sudden_death_goals[1], (unsigned long long)c.sudden_death_shots[1]);
+    lines.push_back(line);
+    return lines;
+}
+
+// --- Ball Flight ---
+// Kicks fly under gravity, quadratic drag and Magnus lift from spin, and collide with the
+// ground, posts, crossbar, back of the net and the keeper's body. Trajectories are stepped in
+// structure-of-arrays batches, four lanes per SSE2 instruction, so the same kernel serves the
+// window's single ball, a server's thousands and AI lookahead.
+const float GRAVITY = 9.81f;
+const float BALL_DRAG = 0.005f;    // 0.5 * air density * Cd * area / mass, per metre
+const float BALL_MAGNUS = 0.004f;  // Lift per unit of spin x velocity
+const int BALL_SUBSTEPS = 4;       // Per fixed step; keeps a 26 m/s ball from tunnelling through a post
+const float GROUND_RESTITUTION = 0.5f, GROUND_FRICTION = 0.98f;
+const float WOODWORK_RESTITUTION = 0.6f, KEEPER_RESTITUTION = 0.3f, NET_DAMPING = 0.15f;
+const float NET_GIVE = 0.4f;         // How far the ball can stretch the back of the net before it stops dead
+const float NET_STIFFNESS = 4000.0f; // Spring pulling a stretched net back, per second squared
+const float NET_GRIP = 60.0f;        // Speed the stretched net soaks up, per second
+const float GK_REACH_HALF_WIDTH = 0.6f;  // Outstretched arms either side of the keeper's centre
+const float GK_BODY_HALF_DEPTH = 0.15f;
+const float GOAL_MOUTH_HALF_WIDTH = GOAL_WIDTH / 2 - POST_THICKNESS / 2;
+const float GOAL_MOUTH_HEIGHT = GOAL_HEIGHT - POST_THICKNESS / 2;
+
+// Kick variation: the key picks a zone, the foot adds power, height within the zone's band and curve.
+const float SHOT_AIM_INSET = 0.8f;    // Side shots aim at this fraction of the keeper's full dive
+const float SHOT_AIM_SPREAD = 0.4f;   // +/- metres around the aim point, so the post comes into play
+const float SHOT_MIN_SPEED = 20.0f, SHOT_MAX_SPEED = 26.0f;
+const float SHOT_MAX_CURVE = 40.0f, SHOT_MAX_TOPSPIN = 20.0f;
+
+enum BallEvent
+{
+    BALL_CROSSED_GOAL = 1,  // Wholly over the line, inside the frame
+    BALL_CROSSED_WIDE = 2,  // Over the line outside the frame
+    BALL_HIT_WOODWORK = 4,
+    BALL_HIT_KEEPER = 8
+};
+
+/**
+ * @brief Structure-of-arrays ball states. The keeper's reach (centre `keeper_x`, from `keeper_y`
+ * up to `keeper_top`) is an input per lane; `events` collects BallEvent bits until the caller
+ * clears them.
+ */
+struct BallBatch
+{
+    std::vector<float> px, py, pz, vx, vy, vz, spin_x, spin_y, keeper_x, keeper_y, keeper_top;
+    std::vector<uint32_t> events;
+    void resize(size_t count)
+    {
+        std::vector<float> *lanes[] = {&px, &py, &pz, &vx, &vy, &vz, &spin_x, &spin_y, &keeper_x, &keeper_y, &keeper_top};
+        for (int i = 0; i < 11; i++)
+            lanes[i]->resize(count);
+        events.resize(count);
+    }
+    size_t size() const { return px.size(); }
+};
+
+// Lane types for the kernel: plain float, or four floats in an SSE register. Masks are lanes
+// with all bits set (SSE2) or any non-zero value (scalar).
+inline float vmin(float a, float b) { return std::min(a, b); }
+inline float vmax(float a, float b) { return std::max(a, b); }
+inline float vsqrt(float a) { return std::sqrt(a); }
+inline float vabs(float a) { return std::fabs(a); }
+inline float vless(float a, float b) { return a < b ? 1.0f : 0.0f; }
+inline float vand(float a, float b) { return a != 0.0f && b != 0.0f ? 1.0f : 0.0f; }
+inline float vandnot(float a, float b) { return a == 0.0f && b != 0.0f ? 1.0f : 0.0f; } // !a && b
+inline float vselect(float mask, float a, float b) { return mask != 0.0f ? a : b; }
+inline int vbits(float mask) { return mask != 0.0f; }
+inline void vload(float &out, const float *p) { out = *p; }
+inline void vstore(float *p, float v) { *p = v; }
+
+#ifdef PENALTY_HAS_SSE2
+struct Float4
+{
+    __m128 v;
+    Float4() {}
+    Float4(float f) : v(_mm_set1_ps(f)) {}
+    Float4(__m128 m) : v(m) {}
+};
+inline Float4 operator+(Float4 a, Float4 b) { return _mm_add_ps(a.v, b.v); }
+inline Float4 operator-(Float4 a, Float4 b) { return _mm_sub_ps(a.v, b.v); }
+inline Float4 operator*(Float4 a, Float4 b) { return _mm_mul_ps(a.v, b.v); }
+inline Float4 operator/(Float4 a, Float4 b) { return _mm_div_ps(a.v, b.v); }
+inline Float4 vmin(Float4 a, Float4 b) { return _mm_min_ps(a.v, b.v); }
+inline Float4 vmax(Float4 a, Float4 b) { return _mm_max_ps(a.v, b.v); }
+inline Float4 vsqrt(Float4 a) { return _mm_sqrt_ps(a.v); }
+inline Float4 vabs(Float4 a) { return _mm_and_ps(a.v, _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF))); }
+inline Float4 vless(Float4 a, Float4 b) { return _mm_cmplt_ps(a.v, b.v); }
+inline Float4 vand(Float4 a, Float4 b) { return _mm_and_ps(a.v, b.v); }
+inline Float4 vandnot(Float4 a, Float4 b) { return _mm_andnot_ps(a.v, b.v); }
+inline Float4 vselect(Float4 mask, Float4 a, Float4 b) { return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)); }
+inline int vbits(Float4 mask) { return _mm_movemask_ps(mask.v); }
+inline void vload(Float4 &out, const float *p) { out = _mm_loadu_ps(p); }
+inline void vstore(float *p, Float4 v) { _mm_storeu_ps(p, v.v); }
+#endif
+
+template <typename F>
+static void markBallEvents(uint32_t *events, F mask, uint32_t event)
+{
+    for (int bits = vbits(mask), lane = 0; bits; bits >>= 1, lane++)
+        if (bits & 1)
+            events[lane] |= event;
+}
+
+/**
+ * @brief Pushes balls out of an axis-aligned box and reflects their velocity off its surface.
+ * Returns the mask of lanes that touched it.
+ */
+template <typename F>
+static F collideBallBox(F &px, F &py, F &pz, F &vx, F &vy, F &vz, F min_x, F max_x, F min_y, F max_y,
+                        F min_z, F max_z, float restitution)
+{
+    F dx = px - vmin(vmax(px, min_x), max_x);
+    F dy = py - vmin(vmax(py, min_y), max_y);
+    F dz = pz - vmin(vmax(pz, min_z), max_z);
+    F dist2 = dx * dx + dy * dy + dz * dz;
+    // Touching, and not centred inside the box where no normal exists
+    F hit = vand(vless(dist2, F(BALL_RADIUS * BALL_RADIUS)), vless(F(1e-12f), dist2));
+    F dist = vsqrt(vmax(dist2, F(1e-12f)));
+    F nx = dx / dist, ny = dy / dist, nz = dz / dist;
+    F push = vselect(hit, F(BALL_RADIUS) - dist, F(0.0f));
+    px = px + nx * push;
+    py = py + ny * push;
+    pz = pz + nz * push;
+    F vn = vx * nx + vy * ny + vz * nz;
+    F impulse = vselect(vand(hit, vless(vn, F(0.0f))), vn * F(1.0f + restitution), F(0.0f));
+    vx = vx - nx * impulse;
+    vy = vy - ny * impulse;
+    vz = vz - nz * impulse;
+    return hit;
+}
+
+/**
+ * @brief Advances the lanes starting at `i` by `dt` seconds. F is float or Float4.
+ */
+template <typename F>
+static void stepBallLanes(BallBatch &b, size_t i, float dt, bool collide)
+{
+    F px, py, pz, vx, vy, vz, sx, sy, keeper_x, keeper_y, keeper_top;
+    vload(px, &b.px[i]);
+    vload(py, &b.py[i]);
+    vload(pz, &b.pz[i]);
+    vload(vx, &b.vx[i]);
+    vload(vy, &b.vy[i]);
+    vload(vz, &b.vz[i]);
+    vload(sx, &b.spin_x[i]);
+    vload(sy, &b.spin_y[i]);
+    vload(keeper_x, &b.keeper_x[i]);
+    vload(keeper_y, &b.keeper_y[i]);
+    vload(keeper_top, &b.keeper_top[i]);
+    const F h(dt / BALL_SUBSTEPS), zero(0.0f), radius(BALL_RADIUS);
+    const float post_x = GOAL_WIDTH / 2, half_post = POST_THICKNESS / 2;
+    for (int step = 0; step < BALL_SUBSTEPS; step++)
+    {
+        // Semi-implicit Euler: drag opposes velocity, Magnus lift is spin x velocity
+        F speed = vsqrt(vx * vx + vy * vy + vz * vz);
+        F drag = F(-BALL_DRAG) * speed;
+        F ax = drag * vx + F(BALL_MAGNUS) * (sy * vz);
+        F ay = drag * vy - F(GRAVITY) - F(BALL_MAGNUS) * (sx * vz);
+        F az = drag * vz + F(BALL_MAGNUS) * (sx * vy - sy * vx);
+        vx = vx + ax * h;
+        vy = vy + ay * h;
+        vz = vz + az * h;
+        px = px + vx * h;
+        py = py + vy * h;
+        pz = pz + vz * h;
+
+        F grounded = vless(py, radius);
+        py = vmax(py, radius);
+        vy = vselect(vand(grounded, vless(vy, zero)), vy * F(-GROUND_RESTITUTION), vy);
+        vx = vselect(grounded, vx * F(GROUND_FRICTION), vx);
+        vz = vselect(grounded, vz * F(GROUND_FRICTION), vz);
+        // Broad phase: nothing to hit until some lane nears the goal line
+        if (!collide || !vbits(vless(pz, F(GOAL_LINE_Z + GK_BODY_HALF_DEPTH + BALL_RADIUS + 0.5f))))
+            continue;
+
+        F line_min(GOAL_LINE_Z - half_post), line_max(GOAL_LINE_Z + half_post);
+        F woodwork = collideBallBox(px, py, pz, vx, vy, vz, F(-post_x - half_post), F(-post_x + half_post), zero,
+                                    F(GOAL_HEIGHT), line_min, line_max, WOODWORK_RESTITUTION);
+        woodwork = vmax(woodwork, collideBallBox(px, py, pz, vx, vy, vz, F(post_x - half_post), F(post_x + half_post),
+                                                 zero, F(GOAL_HEIGHT), line_min, line_max, WOODWORK_RESTITUTION));
+        woodwork = vmax(woodwork, collideBallBox(px, py, pz, vx, vy, vz, F(-post_x - half_post), F(post_x + half_post),
+                                                 F(GOAL_HEIGHT - half_post), F(GOAL_HEIGHT + half_post), line_min,
+                                                 line_max, WOODWORK_RESTITUTION));
+        F keeper = collideBallBox(px, py, pz, vx, vy, vz, keeper_x - F(GK_REACH_HALF_WIDTH),
+                                  keeper_x + F(GK_REACH_HALF_WIDTH), keeper_y, keeper_top,
+                                  F(GOAL_LINE_Z - GK_BODY_HALF_DEPTH), F(GOAL_LINE_Z + GK_BODY_HALF_DEPTH),
+                                  KEEPER_RESTITUTION);
+
+        F over_line = vless(pz + radius, F(GOAL_LINE_Z));
+        F in_mouth = vand(vless(vabs(px), F(GOAL_MOUTH_HALF_WIDTH)), vless(py, F(GOAL_MOUTH_HEIGHT)));
+        // The back of the net gives like a damped spring, then stops the ball dead at NET_GIVE
+        F stretch = vmax(F(GOAL_LINE_Z - NET_DEPTH) - (pz - radius), zero);
+        F in_net = vand(in_mouth, vless(zero, stretch));
+        F grip = vselect(in_net, F(1.0f) - F(NET_GRIP) * h, F(1.0f));
+        vz = vz + vselect(in_net, F(NET_STIFFNESS) * stretch * h, zero);
+        vx = vx * grip;
+        vy = vy * grip;
+        vz = vz * grip;
+        F at_stop = vand(in_mouth, vless(F(NET_GIVE), stretch));
+        pz = vselect(at_stop, F(GOAL_LINE_Z - NET_DEPTH - NET_GIVE) + radius, pz);
+        vx = vselect(at_stop, vx * F(NET_DAMPING), vx);
+        vy = vselect(at_stop, vy * F(NET_DAMPING), vy);
+        vz = vselect(at_stop, vz * F(-NET_DAMPING), vz);
+
+        uint32_t *events = &b.events[i];
+        markBallEvents(events, vand(over_line, in_mouth), BALL_CROSSED_GOAL);
+        markBallEvents(events, vandnot(in_mouth, over_line), BALL_CROSSED_WIDE);
+        markBallEvents(events, woodwork, BALL_HIT_WOODWORK);
+        markBallEvents(events, keeper, BALL_HIT_KEEPER);
+    }
+    vstore(&b.px[i], px);
+    vstore(&b.py[i], py);
+    vstore(&b.pz[i], pz);
+    vstore(&b.vx[i], vx);
+    vstore(&b.vy[i], vy);
+    vstore(&b.vz[i], vz);
+}
+
+/**
+ * @brief Advances every ball in the batch by `dt` seconds, four at a time where SSE2 is available.
+ * With `collide` false only the ground is solid (used to aim kicks).
+ */
+void stepBalls(BallBatch &batch, float dt, bool collide)
+{
+    size_t i = 0, count = batch.size();
+#ifdef PENALTY_HAS_SSE2
+    for (; i + 4 <= count; i += 4)
+        stepBallLanes<Float4>(batch, i, dt, collide);
+#endif
+    for (; i < count; i++)
+        stepBallLanes<float>(batch, i, dt, collide);
+}
+
+struct KickAim
+{
+    float x, y; // Where the ball should cross the goal line
+};
+
+/**
+ * @brief Corrects each kick's straight-line velocity guess so that, with its spin, drag and
+ * gravity, the ball crosses the goal line at its aim point. The kicks fly together as one
+ * BallBatch for a few shooting-method passes.
+ */
+void aimKicks(Match *const *kicks, const KickAim *aims, size_t count)
+{
+    static BallBatch probe; // Scratch reused across calls; callers are single-threaded
+    static std::vector<float> cross_x, cross_y, cross_t, last_x, last_y, last_z;
+    probe.resize(count);
+    cross_x.resize(count);
+    cross_y.resize(count);
+    cross_t.resize(count);
+    for (int pass = 0; pass < 3; pass++)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            const Match &m = *kicks[i];
+            probe.px[i] = m.ball_x;
+            probe.py[i] = m.ball_y;
+            probe.pz[i] = m.ball_z;
+            probe.vx[i] = m.ball_vx;
+            probe.vy[i] = m.ball_vy;
+            probe.vz[i] = m.ball_vz;
+            probe.spin_x[i] = m.spin_x;
+            probe.spin_y[i] = m.spin_y;
+            cross_t[i] = 0.0f;
+        }
+        size_t flying = count;
+        for (float elapsed = 0.0f; flying > 0 && elapsed < 2.0f;)
+        {
+            last_x = probe.px;
+            last_y = probe.py;
+            last_z = probe.pz;
+            stepBalls(probe, (float)SIM_STEP_SECONDS, false);
+            elapsed += (float)SIM_STEP_SECONDS;
+            for (size_t i = 0; i < count; i++)
+            {
+                if (cross_t[i] > 0.0f || probe.pz[i] > GOAL_LINE_Z)
+                    continue;
+                float f = (last_z[i] - GOAL_LINE_Z) / std::max(last_z[i] - probe.pz[i], 1e-6f);
+                cross_x[i] = last_x[i] + (probe.px[i] - last_x[i]) * f;
+                cross_y[i] = last_y[i] + (probe.py[i] - last_y[i]) * f;
+                cross_t[i] = elapsed - (float)SIM_STEP_SECONDS * (1.0f - f);
+                flying--;
+            }
+        }
+        for (size_t i = 0; i < count; i++)
+        {
+            if (cross_t[i] <= 0.0f)
+                continue; // Never reached the line; keep the guess
+            kicks[i]->ball_vx += (aims[i].x - cross_x[i]) / cross_t[i];
+            kicks[i]->ball_vy += (aims[i].y - cross_y[i]) / cross_t[i];
+        }
+    }
+}
+
+/**
+ * @brief Draws a kick towards `shot`'s zone with power, height and curve from the match RNG, and
+ * sets a straight-line velocity guess for aimKicks() to refine.
+ */
+KickAim drawKick(Match &m, Zone shot)
+{
+    const TargetGrid &grid = matchGrid(m);
+    KickAim aim;
+    aim.x = grid.zone_x[shot] * SHOT_AIM_INSET + (m.rng.nextFloat() * 2.0f - 1.0f) * SHOT_AIM_SPREAD;
+    aim.y = grid.aim_low[shot] + m.rng.nextFloat() * grid.aim_span;
+    float speed = SHOT_MIN_SPEED + m.rng.nextFloat() * (SHOT_MAX_SPEED - SHOT_MIN_SPEED);
+    m.spin_y = (m.rng.nextFloat() * 2.0f - 1.0f) * SHOT_MAX_CURVE;
+    m.spin_x = (m.rng.nextFloat() * 2.0f - 1.0f) * SHOT_MAX_TOPSPIN;
+    float t = (m.ball_z - GOAL_LINE_Z) / speed;
+    m.ball_vx = (aim.x - m.ball_x) / t;
+    m.ball_vy = (aim.y - m.ball_y) / t + 0.5f * GRAVITY * t;
+    m.ball_vz = -speed;
+    return aim;
+}
+
+void kickBall(Match &m, Zone shot)
+{
+    KickAim aim = drawKick(m, shot);
+    Match *kick = &m;
+    aimKicks(&kick, &aim, 1);
+}
+
+// --- Goal Net Cloth ---
+// The netting behind the goal is a Verlet mass-spring cloth: one sheet wrapped down the left
+// side, across the back and up the right side, plus the roof. Knots are tied to the frame along
+// the posts, crossbar, top edges and ground. Links are rope: they resist stretching but go slack
+// under compression. Knot positions are kept structure-of-arrays and integrated four at a time
+// with SSE2. The ball only pushes the cloth, never the other way, so replays and netplay do not
+// depend on it. A settled net sleeps and costs nothing until the ball comes near again.
+const float NET_MESH = 0.08f;            // Knot spacing at rest
+const float NET_TENSION = 0.98f;         // Rest length per knot spacing; below 1 keeps the netting taut
+const float NET_THICKNESS = 0.02f;       // Cord radius added to the ball's when they collide
+const float NET_CLOTH_DAMPING = 0.03f;   // Share of its velocity a knot loses each substep
+const int NET_SUBSTEPS = 2;              // Per fixed step; keeps the ball moving less than its radius per substep
+const int NET_SOLVER_ITERATIONS = 6;     // Link passes per substep while inside the budget
+const double NET_FRAME_BUDGET_US = 1000.0; // Cloth CPU time allowed per rendered frame
+const double NET_STEP_BUDGET_US = NET_FRAME_BUDGET_US * 60.0 / SIM_STEPS_PER_SECOND; // Steps per 60 Hz frame share it
+const float NET_SLEEP_MOVE = 0.0005f;    // Largest knot movement in a substep that still counts as at rest
+const int NET_SLEEP_STEPS = 30;          // Steps at rest before the cloth sleeps
+const int NET_MAX_AWAKE_STEPS = 10 * SIM_STEPS_PER_SECOND;
+const float NET_WAKE_MARGIN = 0.5f;      // The cloth wakes once the ball is this close to the net
+
+struct NetCloth
+{
+    std::vector<float> x, y, z;    // Current knot positions
+    std::vector<float> px, py, pz; // Positions one substep ago; Verlet velocity is the difference
+    std::vector<float> loose;      // 1 for a free knot, 0 where it is tied to the frame or pegged down
+    std::vector<uint32_t> links;   // Knot index pairs; doubles as the GL_LINES index buffer
+    std::vector<float> link_length;
+    size_t solved_links;           // Links before this have a free end; the rest join two tied knots
+    int iterations;                // Link passes per substep, lowered when a step runs over budget
+    bool awake, rest_ball_near;    // rest_ball_near: where the ball was when the cloth fell asleep
+    int quiet_steps, awake_steps;
+    double last_step_us;
+    GLuint vbo, ibo;
+    bool vbo_dirty;
+    std::vector<float> vertices;   // Interleaved scratch for the in-place VBO update
+};
+NetCloth netCloth;
+
+inline bool ballNearNet(float bx, float by, float bz)
+{
+    return std::fabs(bx) < GOAL_WIDTH / 2 + NET_WAKE_MARGIN && by < GOAL_HEIGHT + NET_WAKE_MARGIN &&
+           bz < GOAL_LINE_Z + NET_WAKE_MARGIN;
+}
+
+/**
+ * @brief True while the cloth has work to do: it is still moving, or the ball has arrived or left
+ * since it went to sleep.
+ */
+bool netClothActive(const NetCloth &c, const Match &m)
+{
+    return !c.x.empty() && (c.awake || ballNearNet(m.ball_x, m.ball_y, m.ball_z) != c.rest_ball_near);
+}
+
+template <typename F>
+static void integrateNetLanes(NetCloth &c, size_t i, float gravity_step)
+{
+    F x, y, z, px, py, pz, loose;
+    vload(x, &c.x[i]);
+    vload(y, &c.y[i]);
+    vload(z, &c.z[i]);
+    vload(px, &c.px[i]);
+    vload(py, &c.py[i]);
+    vload(pz, &c.pz[i]);
+    vload(loose, &c.loose[i]);
+    const F keep(1.0f - NET_CLOTH_DAMPING);
+    vstore(&c.px[i], x);
+    vstore(&c.py[i], y);
+    vstore(&c.pz[i], z);
+    vstore(&c.x[i], x + (x - px) * keep * loose);
+    vstore(&c.y[i], y + ((y - py) * keep - F(gravity_step)) * loose);
+    vstore(&c.z[i], z + (z - pz) * keep * loose);
+}
+
+/**
+ * @brief Pushes knots out of the ball and above the ground. Returns how far each lane moved this
+ * substep (L1 distance), for the sleep test.
+ */
+template <typename F>
+static F collideNetLanes(NetCloth &c, size_t i, F bx, F by, F bz)
+{
+    F x, y, z, px, py, pz, loose;
+    vload(x, &c.x[i]);
+    vload(y, &c.y[i]);
+    vload(z, &c.z[i]);
+    vload(px, &c.px[i]);
+    vload(py, &c.py[i]);
+    vload(pz, &c.pz[i]);
+    vload(loose, &c.loose[i]);
+    const float reach = BALL_RADIUS + NET_THICKNESS;
+    F dx = x - bx, dy = y - by, dz = z - bz;
+    F d2 = dx * dx + dy * dy + dz * dz;
+    F d = vsqrt(vmax(d2, F(1e-8f)));
+    F push = vselect(vless(d2, F(reach * reach)), (F(reach) - d) / d, F(0.0f)) * loose;
+    x = x + dx * push;
+    y = vmax(y + dy * push, F(GROUND_Y));
+    z = z + dz * push;
+    vstore(&c.x[i], x);
+    vstore(&c.y[i], y);
+    vstore(&c.z[i], z);
+    return vabs(x - px) + vabs(y - py) + vabs(z - pz);
+}
+
+/**
+ * @brief One Gauss-Seidel pass over the links that have a free end.
+ */
+static void solveNetLinks(NetCloth &c)
+{
+    float *x = &c.x[0], *y = &c.y[0], *z = &c.z[0];
+    const float *loose = &c.loose[0];
+    for (size_t l = 0; l < c.solved_links; l++)
+    {
+        uint32_t a = c.links[2 * l], b = c.links[2 * l + 1];
+        float dx = x[b] - x[a], dy = y[b] - y[a], dz = z[b] - z[a];
+        float d2 = dx * dx + dy * dy + dz * dz, length = c.link_length[l];
+        if (d2 <= length * length)
+            continue; // Slack
+        float d = std::sqrt(d2);
+        float k = (d - length) / (d * (loose[a] + loose[b]));
+        x[a] += dx * k * loose[a];
+        y[a] += dy * k * loose[a];
+        z[a] += dz * k * loose[a];
+        x[b] -= dx * k * loose[b];
+        y[b] -= dy * k * loose[b];
+        z[b] -= dz * k * loose[b];
+    }
+}
+
+/**
+ * @brief Advances the cloth one fixed step against the ball's position in `m`, which moves from
+ * its previous to its current step position across the substeps. Returns the CPU time taken in
+ * microseconds (0 when there was nothing to do).
+ *
+ * A step that runs over NET_STEP_BUDGET_US drops a solver pass for the next one; a step well
+ * under it wins one back. Fewer passes make the net stretchier, never slower.
+ */
+double stepNetCloth(NetCloth &c, const Match &m)
+{
+    if (!netClothActive(c, m))
+        return 0.0;
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    bool near = ballNearNet(m.ball_x, m.ball_y, m.ball_z);
+    const float h = (float)SIM_STEP_SECONDS / NET_SUBSTEPS;
+    size_t count = c.x.size();
+    float moved = 0.0f;
+    for (int sub = 1; sub <= NET_SUBSTEPS; sub++)
+    {
+        float t = (float)sub / NET_SUBSTEPS;
+        float bx = m.prev_ball_x + (m.ball_x - m.prev_ball_x) * t;
+        float by = m.prev_ball_y + (m.ball_y - m.prev_ball_y) * t;
+        float bz = m.prev_ball_z + (m.ball_z - m.prev_ball_z) * t;
+        size_t i = 0;
+#ifdef PENALTY_HAS_SSE2
+        for (; i + 4 <= count; i += 4)
+            integrateNetLanes<Float4>(c, i, GRAVITY * h * h);
+#endif
+        for (; i < count; i++)
+            integrateNetLanes<float>(c, i, GRAVITY * h * h);
+        for (int pass = 0; pass < c.iterations; pass++)
+            solveNetLinks(c);
+        i = 0;
+#ifdef PENALTY_HAS_SSE2
+        Float4 moved4(0.0f);
+        for (; i + 4 <= count; i += 4)
+            moved4 = vmax(moved4, collideNetLanes<Float4>(c, i, bx, by, bz));
+        float lanes[4];
+        vstore(lanes, moved4);
+        moved = std::max(moved, std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3])));
+#endif
+        for (; i < count; i++)
+            moved = std::max(moved, collideNetLanes<float>(c, i, bx, by, bz));
+    }
+    c.vbo_dirty = true;
+    c.awake_steps = c.awake ? c.awake_steps + 1 : 0;
+    c.awake = true;
+    c.quiet_steps = moved < NET_SLEEP_MOVE ? c.quiet_steps + 1 : 0;
+    if (c.quiet_steps >= NET_SLEEP_STEPS || c.awake_steps >= NET_MAX_AWAKE_STEPS)
+    {
+        c.awake = false;
+        c.rest_ball_near = near;
+        c.quiet_steps = 0;
+    }
+    c.last_step_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count();
+    if (c.last_step_us > NET_STEP_BUDGET_US && c.iterations > 1)
+        c.iterations--;
+    else if (c.last_step_us < 0.5 * NET_STEP_BUDGET_US && c.iterations < NET_SOLVER_ITERATIONS)
+        c.iterations++;
+    return c.last_step_us;
+}
+
+static uint32_t addNetKnot(NetCloth &c, float x, float y, float z, bool tied)
+{
+    c.x.push_back(x);
+    c.y.push_back(y);
+    c.z.push_back(z);
+    c.loose.push_back(tied ? 0.0f : 1.0f);
+    return (uint32_t)(c.x.size() - 1);
+}
+
+static void addNetLink(NetCloth &c, std::vector<uint32_t> &tied_links, uint32_t a, uint32_t b)
+{
+    std::vector<uint32_t> &out = c.loose[a] + c.loose[b] > 0.0f ? c.links : tied_links;
+    out.push_back(a);
+    out.push_back(b);
+}
+
+/**
+ * @brief Knots the net and lets it hang until it settles. CPU only; buildNetClothBuffers() adds
+ * the GL side.
+ */
+void initNetCloth(NetCloth &c)
+{
+    const int side = (int)(NET_DEPTH / NET_MESH + 0.5f), back = (int)(GOAL_WIDTH / NET_MESH + 0.5f);
+    const int rows = (int)(GOAL_HEIGHT / NET_MESH + 0.5f), columns = 2 * side + back + 1;
+    const float half = GOAL_WIDTH / 2, back_z = GOAL_LINE_Z - NET_DEPTH;
+    c = NetCloth();
+    std::vector<uint32_t> sheet((rows + 1) * columns), roof((back + 1) * (side + 1));
+    // Sheet columns run down the left side from the post, across the back and up the right side
+    for (int row = 0; row <= rows; row++)
+        for (int col = 0; col < columns; col++)
+        {
+            float kx = half, kz = back_z + NET_DEPTH * (col - side - back) / side;
+            if (col <= side)
+            {
+                kx = -half;
+                kz = GOAL_LINE_Z - NET_DEPTH * col / side;
+            }
+            else if (col <= side + back)
+            {
+                kx = -half + GOAL_WIDTH * (col - side) / back;
+                kz = back_z;
+            }
+            bool tied = row == 0 || row == rows || col == 0 || col == columns - 1;
+            sheet[row * columns + col] = addNetKnot(c, kx, GOAL_HEIGHT * row / rows, kz, tied);
+        }
+    // The roof shares its side and back edges with the sheet's top row; its front is the crossbar
+    for (int b = 0; b <= side; b++)
+        for (int a = 0; a <= back; a++)
+        {
+            uint32_t &k = roof[b * (back + 1) + a];
+            if (b == side)
+                k = sheet[rows * columns + side + a];
+            else if (a == 0)
+                k = sheet[rows * columns + b];
+            else if (a == back)
+                k = sheet[rows * columns + columns - 1 - b];
+            else
+                k = addNetKnot(c, -half + GOAL_WIDTH * a / back, GOAL_HEIGHT, GOAL_LINE_Z - NET_DEPTH * b / side, b == 0);
+        }
+
+    std::vector<uint32_t> tied_links;
+    for (int row = 0; row <= rows; row++)
+        for (int col = 0; col < columns; col++)
+        {
+            if (col + 1 < columns)
+                addNetLink(c, tied_links, sheet[row * columns + col], sheet[row * columns + col + 1]);
+            if (row < rows)
+                addNetLink(c, tied_links, sheet[row * columns + col], sheet[(row + 1) * columns + col]);
+        }
+    for (int b = 0; b <= side; b++)
+        for (int a = 0; a <= back; a++)
+        {
+            if (a < back && b < side)
+                addNetLink(c, tied_links, roof[b * (back + 1) + a], roof[b * (back + 1) + a + 1]);
+            if (b < side && a > 0 && a < back)
+                addNetLink(c, tied_links, roof[b * (back + 1) + a], roof[(b + 1) * (back + 1) + a]);
+        }
+    c.solved_links = c.links.size() / 2;
+    c.links.insert(c.links.end(), tied_links.begin(), tied_links.end());
+    for (size_t l = 0; l < c.links.size() / 2; l++)
+    {
+        uint32_t a = c.links[2 * l], b = c.links[2 * l + 1];
+        float dx = c.x[b] - c.x[a], dy = c.y[b] - c.y[a], dz = c.z[b] - c.z[a];
+        c.link_length.push_back(std::sqrt(dx * dx + dy * dy + dz * dz) * NET_TENSION);
+    }
+    c.px = c.x;
+    c.py = c.y;
+    c.pz = c.z;
+    c.iterations = NET_SOLVER_ITERATIONS;
+
+    // Hang the net with the ball on the spot, so the first frame shows it settled
+    Match resting = Match();
+    resting.ball_x = resting.prev_ball_x = GK_CENTER_X;
+    resting.ball_y = resting.prev_ball_y = BALL_Y;
+    resting.ball_z = resting.prev_ball_z = PENALTY_SPOT_Z;
+    c.awake = true;
+    for (int step = 0; step < NET_MAX_AWAKE_STEPS && c.awake; step++)
+        stepNetCloth(c, resting);
+    c.iterations = NET_SOLVER_ITERATIONS;
+}
+
+// --- Global State Variables ---
+Match match;
+float render_alpha = 1.0f;
+double sim_accumulator = 0.0;
+std::chrono::steady_clock::time_point loop_last_time, shot_start_time;
+bool replay_playing = false; // Keys come from a replay file, which also owns the idle callback
+bool replay_low_latency = false; // The replay being played ran each shot's first step at its key
+bool sim_timer_armed = false; // A gameLoop() timer is pending; a second one would double the step rate
+GLuint grassTextureID;
+
+// Static pitch/goal geometry, uploaded once by buildStaticScene() into one interleaved VBO.
+struct DrawRange
+{
+    GLint first;
+    GLsizei count;
+};
+const int STATIC_VERTEX_FLOATS = 8; // position(3), normal(3), texcoord(2)
+GLuint staticSceneVBO = 0;
+DrawRange grassRange, goalFrameRange, penaltySpotRange;
+GLuint ballMeshVBO = 0;
+
+// HUD text: glyphs of the two HUD fonts are rasterised once into an atlas texture, and every
+// string queued during a frame is drawn from it as one batch of textured quads.
+const int GLYPH_FIRST = 32, GLYPH_LAST = 126;
+const int GLYPH_CELL = 32;     // Square atlas cell per glyph, in pixels
+const int GLYPH_ORIGIN_X = 4;  // Glyph origin inside its cell, leaving room for negative bearings
+const int GLYPH_BASELINE = 8;  // Baseline inside its cell, leaving room for descenders
+const int GLYPH_COLUMNS = 16;
+const int GLYPH_ROWS_PER_FONT = (GLYPH_LAST - GLYPH_FIRST + GLYPH_COLUMNS) / GLYPH_COLUMNS;
+const int ATLAS_FONT_COUNT = 2;
+const int ATLAS_WIDTH = GLYPH_COLUMNS * GLYPH_CELL;
+const int ATLAS_HEIGHT = 512;
+struct TextVertex
+{
+    float x, y, u, v;
+};
+GLuint glyphAtlasTexture = 0;
+bool glyphAtlasReady = false;
+int glyphAdvance[ATLAS_FONT_COUNT][GLYPH_LAST - GLYPH_FIRST + 1];
+std::vector<TextVertex> textBatch;
+
+// Formatted HUD strings, rebuilt only when the round or score changes.
+struct HudTextCache
+{
+    int round, player_goals, ai_goals;
+    std::string round_text, score_text, final_text;
+};
+HudTextCache hudText = {-1, -1, -1, "", "", ""};
+
+// Frame scheduling: redraws are requested with flags and coalesced into one glutPostRedisplay().
+// Outside SHOT_IN_PROGRESS the scene is static, so the last 3D frame is kept in a texture. Expose
+// repaints and state changes that only alter the HUD (score, round, prompts, overlays) blit it
+// instead of re-rendering the world; see redrawForChange().
+enum RedrawFlag
+{
+    REDRAW_HUD = 1 << 0,
+    REDRAW_SCENE = 1 << 1
+};
+unsigned pending_redraw = 0;
+GLuint sceneCacheTexture = 0;
+int scene_cache_width = 0, scene_cache_height = 0;
+bool scene_cache_valid = false;
+
+// Frame profiler: CPU (steady_clock) and GPU (timer query) cost per render section, plus the
+// jitter of updateGameLogic() ticks. Shown by the F3 overlay and streamed with --profile-csv.
+enum ProfileSection
+{
+    PROFILE_SCENE,
+    PROFILE_BALL,
+    PROFILE_PLAYERS,
+    PROFILE_SUBMIT, // Sorting and issuing the render queue; shader path only
+    PROFILE_UI,
+    PROFILE_SECTION_COUNT
+};
+const char *const PROFILE_SECTION_NAMES[PROFILE_SECTION_COUNT] = {"scene", "ball", "players", "submit", "ui"};
+const int PROFILE_QUERY_LATENCY = 3; // Frames a GPU result may take to arrive before it is dropped rather than waited for
+const int JITTER_WINDOW = 600;       // Steps kept in the rolling lateness histogram
+const int JITTER_BUCKETS = 8;        // 1 ms buckets of step lateness; last is open-ended
+typedef std::chrono::steady_clock ProfileClock;
+struct FrameProfiler
+{
+    bool enabled, overlay, gpu_timers;
+    FILE *csv;
+    uint64_t frame;
+    ProfileClock::time_point frame_start, section_start;
+    double cpu_us[PROFILE_SECTION_COUNT];
+    double frame_cpu_us;
+    // One slot per in-flight frame: its queries and the CPU numbers waiting for them.
+    GLuint queries[PROFILE_QUERY_LATENCY][PROFILE_SECTION_COUNT];
+    bool query_issued[PROFILE_QUERY_LATENCY][PROFILE_SECTION_COUNT];
+    double slot_cpu_us[PROFILE_QUERY_LATENCY][PROFILE_SECTION_COUNT + 1];
+    int slot_ticks[PROFILE_QUERY_LATENCY];
+    double slot_max_jitter_us[PROFILE_QUERY_LATENCY];
+    uint64_t slot_frame[PROFILE_QUERY_LATENCY];
+    bool slot_pending[PROFILE_QUERY_LATENCY];
+    double avg_cpu_us[PROFILE_SECTION_COUNT + 1], avg_gpu_us[PROFILE_SECTION_COUNT];
+    // How late each fixed updateGameLogic() step ran versus its ideal wall-clock time.
+    int frame_ticks;
+    double frame_max_jitter_us;
+    // CPU time of the net cloth's steps, against NET_FRAME_BUDGET_US.
+    double frame_net_us, slot_net_us[PROFILE_QUERY_LATENCY], avg_net_us;
+    // Render queue counters of each in-flight frame (shader path).
+    int slot_draw_calls[PROFILE_QUERY_LATENCY], slot_state_changes[PROFILE_QUERY_LATENCY];
+    float jitter_ring[JITTER_WINDOW];
+    int jitter_count, jitter_next;
+    int jitter_histogram[JITTER_BUCKETS];
+};
+FrameProfiler profiler;
+
+// Input latency: each key is stamped as GLUT delivers it. Once the first frame showing its effect
+// has been presented, the time from arrival to the end of that frame is recorded.
+enum LatencyKind
+{
+    LATENCY_SHOT,
+    LATENCY_DIVE,
+    LATENCY_OTHER,
+    LATENCY_KIND_COUNT
+};
+const char *const LATENCY_KIND_NAMES[LATENCY_KIND_COUNT] = {"shot", "dive", "other"};
+struct PendingInput
+{
+    ProfileClock::time_point arrival;
+    LatencyKind kind;
+};
+struct InputLatency
+{
+    bool measure;     // --input-latency; implied by --low-latency
+    bool low_latency; // Keys run the first step of their shot and present it at once
+    bool late_latch;  // A shot is brought up to the current time just before each frame is drawn
+    std::vector<PendingInput> applied; // Applied keys whose frame has not been presented yet
+    std::vector<double> samples_ms[LATENCY_KIND_COUNT];
+};
+InputLatency inputLatency;
+
+// Simulation thread (--sim-thread): the window's match and net step on a thread of their own and
+// publish a snapshot after every change through a lock-free triple buffer. The display callback
+// draws the newest snapshot without waiting, so a slow frame never holds a step back. Keys reach
+// the thread through a single-producer ring.
+const unsigned SIM_KEY_QUEUE = 64;     // Power of two
+const unsigned SIM_HISTORY = 64;       // Keys and step latenesses a snapshot remembers; power of two
+const unsigned SNAPSHOT_FRESH = 4;     // Set beside the shared slot index until the window takes it
+struct SimSnapshot
+{
+    Match match;
+    std::vector<float> net_x, net_y, net_z;
+    bool net_awake, net_rest_ball_near;
+    ProfileClock::time_point step_time; // When the latest step fell due; frames interpolate from it
+    PendingInput inputs[SIM_HISTORY];   // Applied keys; the newest is at (input_count - 1) % SIM_HISTORY
+    uint64_t input_count;
+    float lateness_us[SIM_HISTORY];     // How late each shot step ran, kept the same way
+    uint64_t lateness_count;
+    ShotRecord shots[SIM_HISTORY];      // Scored kicks, for the shot history
+    uint64_t shot_count;
+};
+struct SimKey
+{
+    unsigned char key;
+    ProfileClock::time_point arrival;
+};
+struct SimThread
+{
+    bool running;
+    std::thread worker;
+    std::atomic<bool> stop;
+    std::mutex wake_mutex;                    // Only guards the thread's sleep, never the snapshots
+    std::condition_variable wake;             // Signalled by postSimKey() and stopSimThread()
+    SimKey keys[SIM_KEY_QUEUE];
+    std::atomic<unsigned> key_head, key_tail; // Advanced by the window and the thread respectively
+    SimSnapshot slots[3];
+    std::atomic<unsigned> middle;             // The slot in hand-over, | SNAPSHOT_FRESH while unread
+    unsigned back, front;                     // Owned by the thread and the window
+    uint64_t inputs_seen, lateness_seen, shots_seen; // Window side: history already passed on
+    SimSnapshot state;                        // Thread side: the live match and its histories
+    NetCloth net;
+};
+SimThread simThread;
+
+// Step lateness collected on the main thread, for the --sim-stress comparison
+struct StepTiming
+{
+    bool record;
+    std::vector<double> lateness_us;
+};
+StepTiming stepTiming;
+double render_delay_ms = 0.0; // --render-delay: sleep in every frame to stand in for a slow GPU
+DrawRange ballSolidRanges[BALL_LOD_COUNT], ballSeamRanges[BALL_LOD_COUNT];
+
+// Player figures: one shared mesh (texcoord.x holds the colour slot) drawn once per frame for
+// every queued instance. Instances carry a row-major 3x4 affine transform plus the kit colour.
+enum PlayerColourSlot
+{
+    SLOT_KIT,
+    SLOT_SKIN,
+    SLOT_SHORTS
+};
+struct PlayerInstance
+{
+    float transform[12];
+    float color[3];
+};
+GLuint playerMeshVBO = 0, playerInstanceVBO = 0, playerProgram = 0;
+DrawRange playerSlotRanges[3];
+GLsizei playerMeshCount = 0;
+bool playerInstancingSupported = false;
+std::vector<PlayerInstance> playerInstances;
+
+// Shader path: with a GL 3.3 context every draw becomes a RenderCommand instead of a GL call. The
+// queue is sorted by pipeline, texture and depth when submitted, so each piece of state is set once
+// per run of commands that share it. Only GLSL 330 and vertex array objects are used, so the same
+// path runs in a core-profile context (--gl-core).
+enum RenderPipeline
+{
+    PIPELINE_LIT,     // Lit, textured triangles: pitch, goal frame and ball (white texture)
+    PIPELINE_FIGURES, // Lit, instanced player figures
+    PIPELINE_LINES,   // Unlit lines: penalty spot, ball seams and net
+    PIPELINE_BLIT,    // The cached scene as one full-screen triangle
+    PIPELINE_TEXT,    // HUD glyphs in pixel coordinates, alpha blended
+    PIPELINE_COUNT
+};
+enum RenderProgram
+{
+    PROGRAM_LIT,
+    PROGRAM_FIGURES,
+    PROGRAM_FLAT,
+    PROGRAM_OVERLAY,
+    PROGRAM_COUNT
+};
+enum RenderSpace
+{
+    SPACE_WORLD,  // Camera projection and view
+    SPACE_CLIP,   // Positions are already in clip space
+    SPACE_SCREEN  // Pixels, origin bottom left
+};
+enum RenderUniform
+{
+    UNIFORM_PROJECTION,
+    UNIFORM_VIEW,
+    UNIFORM_OFFSET,
+    UNIFORM_COLOR,
+    UNIFORM_TEXTURE,
+    UNIFORM_COUNT
+};
+enum RenderMesh
+{
+    MESH_SCENE,
+    MESH_BALL,
+    MESH_FIGURES,
+    MESH_NET,
+    MESH_TEXT,
+    MESH_BLIT,
+    MESH_COUNT
+};
+struct PipelineState
+{
+    RenderProgram program;
+    RenderSpace space;
+    bool depth_test, blend;
+};
+const PipelineState PIPELINES[PIPELINE_COUNT] = {{PROGRAM_LIT, SPACE_WORLD, true, false},
+                                                 {PROGRAM_FIGURES, SPACE_WORLD, true, false},
+                                                 {PROGRAM_FLAT, SPACE_WORLD, true, false},
+                                                 {PROGRAM_OVERLAY, SPACE_CLIP, false, false},
+                                                 {PROGRAM_OVERLAY, SPACE_SCREEN, false, true}};
+struct RenderCommand
+{
+    uint64_t key; // Pipeline, texture, quantised camera distance, then queue order
+    RenderPipeline pipeline;
+    RenderMesh mesh;
+    GLuint texture;
+    GLenum primitive;
+    DrawRange range;
+    GLsizei instances; // 0 for a plain draw
+    bool indexed;      // range indexes the mesh's element buffer
+    float line_width;
+    float offset[3], color[3];
+};
+struct RenderStats
+{
+    int commands, draw_calls, state_changes;
+};
+struct RenderQueue
+{
+    bool active;
+    GLuint programs[PROGRAM_COUNT];
+    GLint uniforms[PROGRAM_COUNT][UNIFORM_COUNT];
+    GLuint vaos[MESH_COUNT];
+    GLuint text_vbo, blit_vbo, white_texture;
+    float projection[16], view[16], screen[16]; // Column-major, as glUniformMatrix4fv takes them
+    std::vector<RenderCommand> commands;
+    RenderStats frame, last_frame; // Counted since renderScene() began; the previous whole frame
+};
+RenderQueue renderQueue;
+bool gl_core_profile = false;      // --gl-core: ask for a 3.3 core-profile context
+bool force_fixed_function = false; // --fixed-function: keep the legacy path even on GL 3.3
+std::vector<unsigned char> glyphAtlasPixels; // RGBA; kept so a core context can upload it
+int window_width = 800, window_height = 600;
+// Offscreen runs have no GLUT window; fonts still work if glutInit() could reach a display.
+bool offscreen_mode = false;
+bool glut_initialised = false;
+int netplay_side = -1; // Online: the window's side of `match` (0 player, 1 AI); -1 offline
+
+// --- Forward Declarations ---
+void resetMatch(Match &m);
+void drawText_2D(float x, float y, const char *text, void *font = GLUT_BITMAP_HELVETICA_18);
+void initGraphics();
+void buildStaticScene();
+void buildNetClothBuffers();
+void drawNetCloth();
+void refreshNetClothBuffer();
+void buildPitchTexture();
+void startAnimation(Match *matches, size_t count);
+void startShot();
+static void startSimulationClock();
+void queuePlayerFigure(float x, float y_base, float z, float r, float g, float b);
+void drawPlayerFigures();
+void buildPlayerMesh();
+void buildBallMeshes();
+void drawBall(float x, float y, float z);
+void drawScene();
+void drawUI();
+void buildGlyphAtlas();
+bool rasterizeGlyphAtlas(std::vector<unsigned char> &pixels);
+void initFixedFunction();
+bool initShaderPath();
+RenderCommand &queueDraw(RenderPipeline pipeline, RenderMesh mesh, GLuint texture, GLenum primitive, DrawRange range,
+                         float distance, float r, float g, float b);
+void translateCommand(RenderCommand &command, float x, float y, float z);
+void submitRenderQueue();
+float cameraDistance(float x, float y, float z);
+void perspectiveMatrix(float out[16], float fov_y, float aspect, float near_z, float far_z);
+void orthoMatrix(float out[16], float left, float right, float bottom, float top);
+void queueText(float x, float y, const char *text, void *font);
+void flushText();
+void requestRedraw(unsigned flags);
+void setSwapInterval(int interval);
+void initProfiler(bool overlay, const char *csv_path);
+void profileBegin(ProfileSection section);
+void profileEnd(ProfileSection section);
+void profileTick(double lateness_us);
+void profileNetSim(double us);
+void drawProfilerOverlay();
+void advanceRound(Match *matches, size_t count);
+void updateGameLogic(Match *matches, size_t count); // One fixed simulation step
+bool applyMatchKey(Match &m, unsigned char key);
+void gameLoop(int value);                          // Timer callback that runs due steps
+void advanceSimulation(double elapsed_seconds);
+void renderScene();                                // New function for all drawing
+void handleInput(unsigned char key, int x, int y); // New function for input
+void recordReplayKey(unsigned char key);
+void recordReplayResult(const Match &m);
+void postSimKey(unsigned char key, ProfileClock::time_point arrival);
+void latchSimSnapshot();
+void simThreadIdle();
+void logWindowShot(const ShotRecord &r);
+
+/**
+ * @brief Builds every mesh and texture, then picks the shader path when the context offers GL 3.3
+ * (unless --fixed-function) and the fixed-function path otherwise.
+ */
+void initGraphics()
+{
+    buildPitchTexture();
+    buildStaticScene();
+    buildNetClothBuffers();
+    buildPlayerMesh();
+    buildBallMeshes();
+    if (glut_initialised)
+        buildGlyphAtlas();
+    renderQueue.active = !force_fixed_function && initShaderPath();
+    if (!renderQueue.active)
+    {
+        if (gl_core_profile)
+            std::cerr << "The shader path failed in a core-profile context; nothing will be drawn\n";
+        initFixedFunction();
+    }
+}
+
+static void appendVertex(std::vector<float> &out, float x, float y, float z, float nx, float ny, float nz,
+                         float u = 0.0f, float v = 0.0f)
+{
+    float vertex[STATIC_VERTEX_FLOATS] = {x, y, z, nx, ny, nz, u, v};
+    out.insert(out.end(), vertex, vertex + STATIC_VERTEX_FLOATS);
+}
+
+/**
+ * @brief Appends an axis-aligned box as 12 lit triangles; matches a scaled glutSolidCube(1.0).
+ */
+static void appendBox(std::vector<float> &out, float cx, float cy, float cz, float sx, float sy, float sz)
+{
+    // Per face: normal n and in-plane axes u, v with u x v == n so faces wind counter-clockwise.
+    static const float faces[6][3][3] = {
+        {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}},
+        {{-1, 0, 0}, {0, 0, 1}, {0, 1, 0}},
+        {{0, 1, 0}, {0, 0, 1}, {1, 0, 0}},
+        {{0, -1, 0}, {1, 0, 0}, {0, 0, 1}},
+        {{0, 0, 1}, {1, 0, 0}, {0, 1, 0}},
+        {{0, 0, -1}, {0, 1, 0}, {1, 0, 0}}};
+    for (int f = 0; f < 6; f++)
+    {
+        const float *n = faces[f][0], *u = faces[f][1], *v = faces[f][2];
+        const float corners[6][2] = {{-1, -1}, {1, -1}, {1, 1}, {-1, -1}, {1, 1}, {-1, 1}};
+        for (int c = 0; c < 6; c++)
+        {
+            float px = n[0] + corners[c][0] * u[0] + corners[c][1] * v[0];
+            float py = n[1] + corners[c][0] * u[1] + corners[c][1] * v[1];
+            float pz = n[2] + corners[c][0] * u[2] + corners[c][1] * v[2];
+            appendVertex(out, cx + px * sx * 0.5f, cy + py * sy * 0.5f, cz + pz * sz * 0.5f, n[0], n[1], n[2]);
+        }
+    }
+}
+
+/**
+ * @brief Appends a UV sphere as triangles, tessellated like glutSolidSphere(radius, slices, stacks).
+ */
+static void appendSphere(std::vector<float> &out, float cx, float cy, float cz, float radius, int slices, int stacks,
+                         float u = 0.0f)
+{
+    for (int i = 0; i < stacks; i++)
+    {
+        float phi0 = (float)PI * i / stacks, phi1 = (float)PI * (i + 1) / stacks;
+        for (int j = 0; j < slices; j++)
+        {
+            float theta0 = 2.0f * (float)PI * j / slices, theta1 = 2.0f * (float)PI * (j + 1) / slices;
+            float quad[4][3] = {
+                {std::sin(phi0) * std::cos(theta0), std::cos(phi0), std::sin(phi0) * std::sin(theta0)},
+                {std::sin(phi1) * std::cos(theta0), std::cos(phi1), std::sin(phi1) * std::sin(theta0)},
+                {std::sin(phi1) * std::cos(theta1), std::cos(phi1), std::sin(phi1) * std::sin(theta1)},
+                {std::sin(phi0) * std::cos(theta1), std::cos(phi0), std::sin(phi0) * std::sin(theta1)}};
+            const int order[6] = {0, 2, 1, 0, 3, 2};
+            for (int k = 0; k < 6; k++)
+            {
+                const float *n = quad[order[k]];
+                appendVertex(out, cx + n[0] * radius, cy + n[1] * radius, cz + n[2] * radius, n[0], n[1], n[2], u);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Appends latitude and longitude lines as GL_LINES, like glutWireSphere(radius, slices, stacks).
+ */
+static void appendWireSphere(std::vector<float> &out, float radius, int slices, int stacks)
+{
+    const int segments = 2 * std::max(slices, stacks);
+    for (int i = 1; i < stacks; i++)
+    {
+        float phi = (float)PI * i / stacks;
+        for (int j = 0; j < segments; j++)
+        {
+            float theta0 = 2.0f * (float)PI * j / segments, theta1 = 2.0f * (float)PI * (j + 1) / segments;
+            float a[3] = {std::sin(phi) * std::cos(theta0), std::cos(phi), std::sin(phi) * std::sin(theta0)};
+            float b[3] = {std::sin(phi) * std::cos(theta1), std::cos(phi), std::sin(phi) * std::sin(theta1)};
+            appendVertex(out, a[0] * radius, a[1] * radius, a[2] * radius, a[0], a[1], a[2]);
+            appendVertex(out, b[0] * radius, b[1] * radius, b[2] * radius, b[0], b[1], b[2]);
+        }
+    }
+    for (int j = 0; j < slices; j++)
+    {
+        float theta = 2.0f * (float)PI * j / slices;
+        for (int i = 0; i < segments / 2; i++)
+        {
+            float phi0 = (float)PI * i / (segments / 2), phi1 = (float)PI * (i + 1) / (segments / 2);
+            float a[3] = {std::sin(phi0) * std::cos(theta), std::cos(phi0), std::sin(phi0) * std::sin(theta)};
+            float b[3] = {std::sin(phi1) * std::cos(theta), std::cos(phi1), std::sin(phi1) * std::sin(theta)};
+            appendVertex(out, a[0] * radius, a[1] * radius, a[2] * radius, a[0], a[1], a[2]);
+            appendVertex(out, b[0] * radius, b[1] * radius, b[2] * radius, b[0], b[1], b[2]);
+        }
+    }
+}
+
+static DrawRange closeRange(const std::vector<float> &out, GLint first)
+{
+    DrawRange range = {first, (GLsizei)(out.size() / STATIC_VERTEX_FLOATS) - first};
+    return range;
+}
+
+/**
+ * @brief Bakes the grass, goal frame and penalty spot into one VBO. None of it moves; the net is
+ * a cloth with its own buffers (see buildNetClothBuffers()).
+ */
+void buildStaticScene()
+{
+    std::vector<float> v;
+    GLint first = 0;
+
+    // One untiled pitch texture spans the whole quad; see buildPitchTexture()
+    appendVertex(v, PITCH_MIN_X, GROUND_Y, PITCH_NEAR_Z, 0, 1, 0, 0.0f, 0.0f);
+    appendVertex(v, PITCH_MAX_X, GROUND_Y, PITCH_NEAR_Z, 0, 1, 0, 1.0f, 0.0f);
+    appendVertex(v, PITCH_MAX_X, GROUND_Y, PITCH_FAR_Z, 0, 1, 0, 1.0f, 1.0f);
+    appendVertex(v, PITCH_MIN_X, GROUND_Y, PITCH_NEAR_Z, 0, 1, 0, 0.0f, 0.0f);
+    appendVertex(v, PITCH_MAX_X, GROUND_Y, PITCH_FAR_Z, 0, 1, 0, 1.0f, 1.0f);
+    appendVertex(v, PITCH_MIN_X, GROUND_Y, PITCH_FAR_Z, 0, 1, 0, 0.0f, 1.0f);
+    grassRange = closeRange(v, first);
+
+    first = grassRange.first + grassRange.count;
+    appendBox(v, -GOAL_WIDTH / 2, GROUND_Y + GOAL_HEIGHT / 2, GOAL_LINE_Z, POST_THICKNESS, GOAL_HEIGHT, POST_THICKNESS);
+    appendBox(v, GOAL_WIDTH / 2, GROUND_Y + GOAL_HEIGHT / 2, GOAL_LINE_Z, POST_THICKNESS, GOAL_HEIGHT, POST_THICKNESS);
+    appendBox(v, 0.0f, GROUND_Y + GOAL_HEIGHT, GOAL_LINE_Z, GOAL_WIDTH + POST_THICKNESS, POST_THICKNESS, POST_THICKNESS);
+    goalFrameRange = closeRange(v, first);
+
+    first = goalFrameRange.first + goalFrameRange.count;
+    appendVertex(v, -0.1f, GROUND_Y + 0.01f, PENALTY_SPOT_Z, 0, 1, 0);
+    appendVertex(v, 0.1f, GROUND_Y + 0.01f, PENALTY_SPOT_Z, 0, 1, 0);
+    penaltySpotRange = closeRange(v, first);
+
+    glGenBuffers(1, &staticSceneVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, staticSceneVBO);
+    glBufferData(GL_ARRAY_BUFFER, v.size() * sizeof(float), &v[0], GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+static bool hasExtensionIn(const char *extensions, const char *name)
+{
+    if (!extensions)
+        return false;
+    size_t len = std::strlen(name);
+    for (const char *p = std::strstr(extensions, name); p; p = std::strstr(p + len, name))
+        if ((p == extensions || p[-1] == ' ') && (p[len] == ' ' || p[len] == '\0'))
+            return true;
+    return false;
+}
+
+static bool glVersionAtLeast(int major, int minor)
+{
+    const char *version = (const char *)glGetString(GL_VERSION);
+    int have_major = 0, have_minor = 0;
+    if (!version || std::sscanf(version, "%d.%d", &have_major, &have_minor) != 2)
+        return false;
+    return have_major > major || (have_major == major && have_minor >= minor);
+}
+
+static bool hasGLExtension(const char *name)
+{
+#ifndef __APPLE__
+    if (glVersionAtLeast(3, 0)) // Core profiles drop the single GL_EXTENSIONS string
+    {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++)
+            if (std::strcmp((const char *)glGetStringi(GL_EXTENSIONS, i), name) == 0)
+                return true;
+        return false;
+    }
+#endif
+    return hasExtensionIn((const char *)glGetString(GL_EXTENSIONS), name);
+}
+
+#if !defined(__APPLE__) && !defined(_WIN32)
+static bool hasGLXExtension(const char *name)
+{
+    Display *display = glXGetCurrentDisplay();
+    return display && hasExtensionIn(glXQueryExtensionsString(display, DefaultScreen(display)), name);
+}
+#endif
+
+/**
+ * @brief Compiles and links a GLSL program, binding `attribs` to locations 0..n-1. Returns 0 on failure.
+ */
+GLuint compileProgram(const char *vertex_src, const char *fragment_src, const char *const *attribs, int attrib_count)
+{
+    const char *sources[2] = {vertex_src, fragment_src};
+    const GLenum types[2] = {GL_VERTEX_SHADER, GL_FRAGMENT_SHADER};
+    GLuint program = glCreateProgram();
+    for (int i = 0; i < 2; i++)
+    {
+        GLuint shader = glCreateShader(types[i]);
+        glShaderSource(shader, 1, &sources[i], NULL);
+        glCompileShader(shader);
+        GLint ok = GL_FALSE;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+        if (!ok)
+        {
+            char log[1024];
+            glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+            std::cerr << "Shader compile failed: " << log << "\n";
+            glDeleteShader(shader);
+            glDeleteProgram(program);
+            return 0;
+        }
+        glAttachShader(program, shader);
+        glDeleteShader(shader); // Flagged for deletion; freed with the program
+    }
+    for (int i = 0; i < attrib_count; i++)
+        glBindAttribLocation(program, i, attribs[i]);
+    glLinkProgram(program);
+    GLint ok = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &ok);
+    if (!ok)
+    {
+        char log[1024];
+        glGetProgramInfoLog(program, sizeof(log), NULL, log);
+        std::cerr << "Program link failed: " << log << "\n";
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+// Replicates the fixed-function GL_LIGHT0 + GL_COLOR_MATERIAL lighting for instanced figures.
+static const char *PLAYER_VERTEX_SHADER =
+    "#version 120\n"
+    "attribute vec3 a_position;\n"
+    "attribute vec3 a_normal;\n"
+    "attribute float a_slot;\n"
+    "attribute vec4 a_row0;\n"
+    "attribute vec4 a_row1;\n"
+    "attribute vec4 a_row2;\n"
+    "attribute vec3 a_color;\n"
+    "varying vec3 v_color;\n"
+    "void main()\n"
+    "{\n"
+    "    vec4 p = vec4(a_position, 1.0);\n"
+    "    vec4 eye = gl_ModelViewMatrix * vec4(dot(a_row0, p), dot(a_row1, p), dot(a_row2, p), 1.0);\n"
+    "    vec3 n = vec3(dot(a_row0.xyz, a_normal), dot(a_row1.xyz, a_normal), dot(a_row2.xyz, a_normal));\n"
+    "    vec3 N = normalize(gl_NormalMatrix * n);\n"
+    "    vec4 light = gl_LightSource[0].position;\n"
+    "    vec3 L = normalize(light.xyz - eye.xyz * light.w);\n"
+    "    vec3 base = a_slot < 0.5 ? a_color : (a_slot < 1.5 ? vec3(0.9, 0.7, 0.6) : a_color * 0.5);\n"
+    "    vec3 lit = gl_LightModel.ambient.rgb + gl_LightSource[0].ambient.rgb +\n"
+    "               gl_LightSource[0].diffuse.rgb * max(dot(N, L), 0.0);\n"
+    "    v_color = base * lit;\n"
+    "    gl_Position = gl_ProjectionMatrix * eye;\n"
+    "}\n";
+static const char *PLAYER_FRAGMENT_SHADER =
+    "#version 120\n"
+    "varying vec3 v_color;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_FragColor = vec4(min(v_color, vec3(1.0)), 1.0);\n"
+    "}\n";
+enum PlayerAttrib
+{
+    PLAYER_ATTRIB_POSITION,
+    PLAYER_ATTRIB_NORMAL,
+    PLAYER_ATTRIB_SLOT,
+    PLAYER_ATTRIB_ROW0,
+    PLAYER_ATTRIB_ROW1,
+    PLAYER_ATTRIB_ROW2,
+    PLAYER_ATTRIB_COLOR,
+    PLAYER_ATTRIB_COUNT
+};
+
+/**
+ * @brief Sets up GL_LIGHT0 and the GLSL 1.20 instancing program used by the fixed-function path.
+ */
+void initFixedFunction()
+{
+    glEnable(GL_LIGHTING);
+    glEnable(GL_LIGHT0);
+    glEnable(GL_COLOR_MATERIAL);
+    GLfloat light_pos[] = {0.0f, 5.0f, 5.0f, 1.0f}; // Eye space: the modelview is still identity
+    glLightfv(GL_LIGHT0, GL_POSITION, light_pos);
+    glShadeModel(GL_SMOOTH);
+
+    playerInstancingSupported = hasGLExtension("GL_ARB_instanced_arrays") && hasGLExtension("GL_ARB_draw_instanced");
+    if (playerInstancingSupported)
+    {
+        const char *attribs[PLAYER_ATTRIB_COUNT] = {"a_position", "a_normal", "a_slot", "a_row0",
+                                                    "a_row1", "a_row2", "a_color"};
+        playerProgram = compileProgram(PLAYER_VERTEX_SHADER, PLAYER_FRAGMENT_SHADER, attribs, PLAYER_ATTRIB_COUNT);
+        playerInstancingSupported = playerProgram != 0;
+    }
+}
+
+/**
+ * @brief Builds the torso, head and limb mesh once, in figure space with the feet at the origin.
+ *
+ * Vertices are grouped by colour slot so the fallback path can draw each slot with one glColor.
+ */
+void buildPlayerMesh()
+{
+    float head_radius = 0.15f;
+    float torso_height = PLAYER_HEIGHT * 0.4f;
+    float limb_length = PLAYER_HEIGHT * 0.3f;
+    float torso_width = PLAYER_BODY_WIDTH;
+    float torso_depth = PLAYER_BODY_DEPTH;
+    std::vector<float> v;
+
+    appendBox(v, 0.0f, torso_height / 2.0f, 0.0f, torso_width, torso_height, torso_depth);
+    appendBox(v, torso_width / 2.0f + limb_length / 2.0f, torso_height * 0.7f, 0.0f, limb_length,
+              PLAYER_LIMB_THICKNESS, PLAYER_LIMB_THICKNESS);
+    appendBox(v, -torso_width / 2.0f - limb_length / 2.0f, torso_height * 0.7f, 0.0f, limb_length,
+              PLAYER_LIMB_THICKNESS, PLAYER_LIMB_THICKNESS);
+    playerSlotRanges[SLOT_KIT] = closeRange(v, 0);
+
+    appendSphere(v, 0.0f, torso_height + head_radius * 0.8f, 0.0f, head_radius, 16, 16, (float)SLOT_SKIN);
+    playerSlotRanges[SLOT_SKIN] = closeRange(v, playerSlotRanges[SLOT_KIT].count);
+
+    GLint first = playerSlotRanges[SLOT_SKIN].first + playerSlotRanges[SLOT_SKIN].count;
+    appendBox(v, torso_width * 0.2f, limb_length / 2.0f, 0.0f, PLAYER_LIMB_THICKNESS, limb_length, PLAYER_LIMB_THICKNESS);
+    appendBox(v, -torso_width * 0.2f, limb_length / 2.0f, 0.0f, PLAYER_LIMB_THICKNESS, limb_length, PLAYER_LIMB_THICKNESS);
+    playerSlotRanges[SLOT_SHORTS] = closeRange(v, first);
+    for (GLint i = first; i < first + playerSlotRanges[SLOT_SHORTS].count; i++)
+        v[i * STATIC_VERTEX_FLOATS + 6] = (float)SLOT_SHORTS;
+    playerMeshCount = (GLsizei)(v.size() / STATIC_VERTEX_FLOATS);
+
+    glGenBuffers(1, &playerMeshVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, playerMeshVBO);
+    glBufferData(GL_ARRAY_BUFFER, v.size() * sizeof(float), &v[0], GL_STATIC_DRAW);
+    glGenBuffers(1, &playerInstanceVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/**
+ * @brief Tessellates every ball LOD (solid shell plus seam lines) once into a shared VBO.
+ */
+void buildBallMeshes()
+{
+    std::vector<float> v;
+    for (int i = 0; i < BALL_LOD_COUNT; i++)
+    {
+        const BallLodSpec &lod = BALL_LODS[i];
+        GLint first = (GLint)(v.size() / STATIC_VERTEX_FLOATS);
+        appendSphere(v, 0.0f, 0.0f, 0.0f, BALL_RADIUS, lod.slices, lod.stacks);
+        ballSolidRanges[i] = closeRange(v, first);
+        first = ballSolidRanges[i].first + ballSolidRanges[i].count;
+        appendWireSphere(v, BALL_RADIUS * 1.01f, lod.seam_slices, lod.seam_stacks);
+        ballSeamRanges[i] = closeRange(v, first);
+    }
+    glGenBuffers(1, &ballMeshVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, ballMeshVBO);
+    glBufferData(GL_ARRAY_BUFFER, v.size() * sizeof(float), &v[0], GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/**
+ * @brief Picks the coarsest LOD whose threshold the ball's projected radius (in pixels) still meets.
+ */
+int selectBallLod(float x, float y, float z)
+{
+    float distance = std::max(cameraDistance(x, y, z), BALL_RADIUS);
+    float focal = (window_height * 0.5f) / std::tan(CAMERA_FOV_Y * 0.5f * (float)PI / 180.0f);
+    float pixel_radius = BALL_RADIUS * focal / distance;
+    for (int i = 0; i < BALL_LOD_COUNT; i++)
+        if (pixel_radius >= BALL_LODS[i].min_pixel_radius)
+            return i;
+    return BALL_LOD_COUNT - 1;
+}
+
+void drawBall(float x, float y, float z)
+{
+    int lod = selectBallLod(x, y, z);
+    if (renderQueue.active)
+    {
+        float distance = cameraDistance(x, y, z);
+        translateCommand(queueDraw(PIPELINE_LIT, MESH_BALL, renderQueue.white_texture, GL_TRIANGLES,
+                                   ballSolidRanges[lod], distance, 1.0f, 1.0f, 1.0f),
+                         x, y, z);
+        translateCommand(queueDraw(PIPELINE_LINES, MESH_BALL, 0, GL_LINES, ballSeamRanges[lod], distance, 0.0f,
+                                   0.0f, 0.0f),
+                         x, y, z);
+        return;
+    }
+    const GLsizei stride = STATIC_VERTEX_FLOATS * sizeof(float);
+    glPushMatrix();
+    glTranslatef(x, y, z);
+    glBindBuffer(GL_ARRAY_BUFFER, ballMeshVBO);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glVertexPointer(3, GL_FLOAT, stride, (const GLvoid *)0);
+    glNormalPointer(GL_FLOAT, stride, (const GLvoid *)(3 * sizeof(float)));
+    glColor3f(1.0f, 1.0f, 1.0f);
+    glDrawArrays(GL_TRIANGLES, ballSolidRanges[lod].first, ballSolidRanges[lod].count);
+    glColor3f(0.0f, 0.0f, 0.0f);
+    glDisable(GL_LIGHTING);
+    glDrawArrays(GL_LINES, ballSeamRanges[lod].first, ballSeamRanges[lod].count);
+    glEnable(GL_LIGHTING);
+    glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glPopMatrix();
+}
+
+/**
+ * @brief Draws the static 3D scene elements from the VBO built in buildStaticScene().
+ */
+void drawScene()
+{
+    if (renderQueue.active)
+    {
+        float pitch_z = (PITCH_NEAR_Z + PITCH_FAR_Z) / 2.0f;
+        float goal_distance = cameraDistance(0.0f, GROUND_Y + GOAL_HEIGHT / 2.0f, GOAL_LINE_Z);
+        queueDraw(PIPELINE_LIT, MESH_SCENE, grassTextureID, GL_TRIANGLES, grassRange,
+                  cameraDistance(0.0f, GROUND_Y, pitch_z), 0.8f, 0.8f, 0.8f);
+        queueDraw(PIPELINE_LIT, MESH_SCENE, renderQueue.white_texture, GL_TRIANGLES, goalFrameRange, goal_distance,
+                  1.0f, 1.0f, 1.0f);
+        queueDraw(PIPELINE_LINES, MESH_SCENE, 0, GL_LINES, penaltySpotRange,
+                  cameraDistance(0.0f, GROUND_Y, PENALTY_SPOT_Z), 1.0f, 1.0f, 1.0f)
+            .line_width = 2.0f;
+        if (netCloth.vbo)
+        {
+            refreshNetClothBuffer();
+            DrawRange links = {0, (GLsizei)netCloth.links.size()};
+            queueDraw(PIPELINE_LINES, MESH_NET, 0, GL_LINES, links, goal_distance, 0.8f, 0.8f, 0.8f).indexed = true;
+        }
+        return;
+    }
+    const GLsizei stride = STATIC_VERTEX_FLOATS * sizeof(float);
+    glBindBuffer(GL_ARRAY_BUFFER, staticSceneVBO);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glVertexPointer(3, GL_FLOAT, stride, (const GLvoid *)0);
+    glNormalPointer(GL_FLOAT, stride, (const GLvoid *)(3 * sizeof(float)));
+    glTexCoordPointer(2, GL_FLOAT, stride, (const GLvoid *)(6 * sizeof(float)));
+
+    glEnable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, grassTextureID);
+    glColor3f(0.8f, 0.8f, 0.8f);
+    glDrawArrays(GL_TRIANGLES, grassRange.first, grassRange.count);
+    glDisable(GL_TEXTURE_2D);
+
+    glColor3f(1.0f, 1.0f, 1.0f);
+    glDrawArrays(GL_TRIANGLES, goalFrameRange.first, goalFrameRange.count);
+
+    glColor3f(1.0, 1.0, 1.0);
+    glLineWidth(2.0);
+    glDrawArrays(GL_LINES, penaltySpotRange.first, penaltySpotRange.count);
+    glLineWidth(1.0);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_NORMAL_ARRAY);
+
+    glColor3f(0.8f, 0.8f, 0.8f);
+    glDisable(GL_LIGHTING);
+    drawNetCloth();
+    glEnable(GL_LIGHTING);
+
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/**
+ * @brief Creates the net's vertex buffer and its static GL_LINES index buffer from the links.
+ */
+void buildNetClothBuffers()
+{
+    initNetCloth(netCloth);
+    glGenBuffers(1, &netCloth.vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, netCloth.vbo);
+    glBufferData(GL_ARRAY_BUFFER, netCloth.x.size() * 3 * sizeof(float), NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glGenBuffers(1, &netCloth.ibo);
+    // Filled through GL_ARRAY_BUFFER: in a core profile the element binding belongs to a VAO
+    glBindBuffer(GL_ARRAY_BUFFER, netCloth.ibo);
+    glBufferData(GL_ARRAY_BUFFER, netCloth.links.size() * sizeof(uint32_t), &netCloth.links[0], GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    netCloth.vbo_dirty = true;
+}
+
+/**
+ * @brief Draws the net as lines, first rewriting the vertex buffer in place if the cloth moved.
+ * Expects GL_VERTEX_ARRAY enabled and leaves GL_ARRAY_BUFFER bound to the net.
+ */
+void drawNetCloth()
+{
+    if (!netCloth.vbo)
+        return;
+    refreshNetClothBuffer();
+    glVertexPointer(3, GL_FLOAT, 0, (const GLvoid *)0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, netCloth.ibo);
+    glDrawElements(GL_LINES, (GLsizei)netCloth.links.size(), GL_UNSIGNED_INT, (const GLvoid *)0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+/**
+ * @brief Binds the net's vertex buffer, rewriting it in place first if the cloth moved.
+ */
+void refreshNetClothBuffer()
+{
+    glBindBuffer(GL_ARRAY_BUFFER, netCloth.vbo);
+    if (netCloth.vbo_dirty)
+    {
+        size_t count = netCloth.x.size();
+        netCloth.vertices.resize(count * 3);
+        for (size_t i = 0; i < count; i++)
+        {
+            netCloth.vertices[3 * i] = netCloth.x[i];
+            netCloth.vertices[3 * i + 1] = netCloth.y[i];
+            netCloth.vertices[3 * i + 2] = netCloth.z[i];
+        }
+        glBufferSubData(GL_ARRAY_BUFFER, 0, netCloth.vertices.size() * sizeof(float), &netCloth.vertices[0]);
+        netCloth.vbo_dirty = false;
+    }
+}
+
+/**
+ * @brief Reshape callback (Implementation unchanged)
+ */
+void reshape(int w, int h)
+{
+    if (h == 0)
+        h = 1;
+    float aspect = (float)w / (float)h;
+    window_width = w;
+    window_height = h;
+    glViewport(0, 0, w, h);
+    scene_cache_valid = false;
+    if (renderQueue.active)
+    {
+        perspectiveMatrix(renderQueue.projection, CAMERA_FOV_Y, aspect, CAMERA_NEAR, CAMERA_FAR);
+        orthoMatrix(renderQueue.screen, 0.0f, (float)w, 0.0f, (float)h);
+        return;
+    }
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    gluPerspective(CAMERA_FOV_Y, aspect, CAMERA_NEAR, CAMERA_FAR);
+    glMatrixMode(GL_MODELVIEW);
+}
+
+/**
+ * @brief Utility function to draw 2D text overlay. (Implementation unchanged)
+ */
+void drawText_2D(float x, float y, const char *string, void *font)
+{
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    gluOrtho2D(0, window_width, 0, window_height);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_LIGHTING);
+    glColor3f(1.0f, 1.0f, 1.0f);
+    glRasterPos2f(x, y);
+    while (*string)
+    {
+        glutBitmapCharacter(font, *string++);
+    }
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_LIGHTING);
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPopMatrix();
+}
+
+static void *atlasFont(int index)
+{
+    return index == 0 ? GLUT_BITMAP_HELVETICA_18 : GLUT_BITMAP_TIMES_ROMAN_24;
+}
+
+static int atlasFontIndex(void *font)
+{
+    for (int i = 0; i < ATLAS_FONT_COUNT; i++)
+        if (atlasFont(i) == font)
+            return i;
+    return -1;
+}
+
+/**
+ * @brief Rasterises the HUD fonts with glutBitmapCharacter into RGBA `pixels` through an FBO, and
+ * fills glyphAdvance. Needs a compatibility context; returns false if FBOs are missing.
+ */
+bool rasterizeGlyphAtlas(std::vector<unsigned char> &pixels)
+{
+    if (!hasGLExtension("GL_EXT_framebuffer_object"))
+        return false;
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, ATLAS_WIDTH, ATLAS_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    GLuint fbo;
+    glGenFramebuffersEXT(1, &fbo);
+    glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, fbo);
+    glFramebufferTexture2DEXT(GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT0_EXT, GL_TEXTURE_2D, texture, 0);
+    bool complete = glCheckFramebufferStatusEXT(GL_FRAMEBUFFER_EXT) == GL_FRAMEBUFFER_COMPLETE_EXT;
+    if (complete)
+    {
+        glPushAttrib(GL_ALL_ATTRIB_BITS);
+        glViewport(0, 0, ATLAS_WIDTH, ATLAS_HEIGHT);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_LIGHTING);
+        glDisable(GL_TEXTURE_2D);
+        glMatrixMode(GL_PROJECTION);
+        glPushMatrix();
+        glLoadIdentity();
+        gluOrtho2D(0, ATLAS_WIDTH, 0, ATLAS_HEIGHT);
+        glMatrixMode(GL_MODELVIEW);
+        glPushMatrix();
+        glLoadIdentity();
+        glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+        for (int f = 0; f < ATLAS_FONT_COUNT; f++)
+        {
+            for (int c = GLYPH_FIRST; c <= GLYPH_LAST; c++)
+            {
+                int i = c - GLYPH_FIRST;
+                int col = i % GLYPH_COLUMNS, row = f * GLYPH_ROWS_PER_FONT + i / GLYPH_COLUMNS;
+                glRasterPos2i(col * GLYPH_CELL + GLYPH_ORIGIN_X, row * GLYPH_CELL + GLYPH_BASELINE);
+                glutBitmapCharacter(atlasFont(f), c);
+                glyphAdvance[f][i] = glutBitmapWidth(atlasFont(f), c);
+            }
+        }
+        glMatrixMode(GL_PROJECTION);
+        glPopMatrix();
+        glMatrixMode(GL_MODELVIEW);
+        glPopMatrix();
+        glPopAttrib();
+        pixels.resize((size_t)ATLAS_WIDTH * ATLAS_HEIGHT * 4);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, ATLAS_WIDTH, ATLAS_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    }
+    glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+    glDeleteFramebuffersEXT(1, &fbo);
+    glDeleteTextures(1, &texture);
+    return complete;
+}
+
+/**
+ * @brief Uploads the HUD font atlas, rasterising it first unless an earlier context already did.
+ *
+ * Leaves glyphAtlasReady false (and queueText() on the drawText_2D() path) if that is impossible.
+ */
+void buildGlyphAtlas()
+{
+    if (glyphAtlasPixels.empty() && (gl_core_profile || !rasterizeGlyphAtlas(glyphAtlasPixels)))
+        return;
+    glGenTextures(1, &glyphAtlasTexture);
+    glBindTexture(GL_TEXTURE_2D, glyphAtlasTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, ATLAS_WIDTH, ATLAS_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                 &glyphAtlasPixels[0]);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glyphAtlasReady = true;
+}
+
+/**
+ * @brief Appends `text` to this frame's text batch; same placement as drawText_2D().
+ */
+void queueText(float x, float y, const char *text, void *font)
+{
+    int f = atlasFontIndex(font);
+    if (!glyphAtlasReady || f < 0)
+    {
+        if (glut_initialised && !gl_core_profile)
+            drawText_2D(x, y, text, font);
+        return;
+    }
+    float pen = std::floor(x), baseline = std::floor(y);
+    for (; *text; text++)
+    {
+        int c = (unsigned char)*text;
+        if (c < GLYPH_FIRST || c > GLYPH_LAST)
+            continue;
+        int i = c - GLYPH_FIRST;
+        float u0 = (float)((i % GLYPH_COLUMNS) * GLYPH_CELL) / ATLAS_WIDTH;
+        float v0 = (float)((f * GLYPH_ROWS_PER_FONT + i / GLYPH_COLUMNS) * GLYPH_CELL) / ATLAS_HEIGHT;
+        float u1 = u0 + (float)GLYPH_CELL / ATLAS_WIDTH, v1 = v0 + (float)GLYPH_CELL / ATLAS_HEIGHT;
+        float x0 = pen - GLYPH_ORIGIN_X, y0 = baseline - GLYPH_BASELINE;
+        float x1 = x0 + GLYPH_CELL, y1 = y0 + GLYPH_CELL;
+        TextVertex quad[6] = {{x0, y0, u0, v0}, {x1, y0, u1, v0}, {x1, y1, u1, v1},
+                              {x0, y0, u0, v0}, {x1, y1, u1, v1}, {x0, y1, u0, v1}};
+        textBatch.insert(textBatch.end(), quad, quad + 6);
+        pen += glyphAdvance[f][i];
+    }
+}
+
+/**
+ * @brief Draws every string queued this frame with a single glDrawArrays call.
+ */
+void flushText()
+{
+    if (textBatch.empty())
+        return;
+    if (renderQueue.active)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, renderQueue.text_vbo);
+        glBufferData(GL_ARRAY_BUFFER, textBatch.size() * sizeof(TextVertex), &textBatch[0], GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        DrawRange glyphs = {0, (GLsizei)textBatch.size()};
+        queueDraw(PIPELINE_TEXT, MESH_TEXT, glyphAtlasTexture, GL_TRIANGLES, glyphs, 0.0f, 1.0f, 1.0f, 1.0f);
+        submitRenderQueue();
+        textBatch.clear();
+        return;
+    }
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    gluOrtho2D(0, window_width, 0, window_height);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_LIGHTING);
+    glEnable(GL_TEXTURE_2D);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glBindTexture(GL_TEXTURE_2D, glyphAtlasTexture);
+    glColor3f(1.0f, 1.0f, 1.0f);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glVertexPointer(2, GL_FLOAT, sizeof(TextVertex), &textBatch[0].x);
+    glTexCoordPointer(2, GL_FLOAT, sizeof(TextVertex), &textBatch[0].u);
+    glDrawArrays(GL_TRIANGLES, 0, (GLsizei)textBatch.size());
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glDisable(GL_BLEND);
+    glDisable(GL_TEXTURE_2D);
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_LIGHTING);
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPopMatrix();
+    textBatch.clear();
+}
+
+/**
+ * @brief Rebuilds the cached round/score strings when match.current_round or the score changed.
+ */
+static void refreshHudText()
+{
+    if (hudText.round == match.current_round && hudText.player_goals == match.player_goals && hudText.ai_goals == match.ai_goals)
+        return;
+    hudText.round = match.current_round;
+    hudText.player_goals = match.player_goals;
+    hudText.ai_goals = match.ai_goals;
+    std::stringstream ss_round;
+    ss_round << "Round: " << match.current_round;
+    if (match.current_round > MAX_ROUNDS)
+        ss_round << " (SUDDEN DEATH)";
+    else
+        ss_round << " of " << MAX_ROUNDS;
+    hudText.round_text = ss_round.str();
+    const char *home = match.versus ? "Host" : "Player", *away = match.versus ? "Guest" : "AI";
+    std::stringstream ss_score;
+    ss_score << home << ": " << match.player_goals << "  |  " << away << ": " << match.ai_goals;
+    hudText.score_text = ss_score.str();
+    std::stringstream ss_final;
+    ss_final << "Final Score: " << home << " " << match.player_goals << " - " << match.ai_goals << " " << away;
+    hudText.final_text = ss_final.str();
+}
+
+// --- Shader Render Path ---
+// Four GLSL 330 programs cover every draw: lit meshes, instanced figures, flat-coloured lines and
+// screen-space textured quads. Lighting matches the fixed-function GL_LIGHT0 set up by
+// initFixedFunction(), so both paths draw the same picture.
+#ifdef __APPLE__
+// The legacy macOS context stops at GL 2.1, so this path never runs there; these only let it build.
+#define glGenVertexArrays glGenVertexArraysAPPLE
+#define glBindVertexArray glBindVertexArrayAPPLE
+#define glVertexAttribDivisor glVertexAttribDivisorARB
+#define glDrawArraysInstanced glDrawArraysInstancedARB
+#endif
+
+static const char *LIT_VERTEX_SHADER =
+    "#version 330 core\n"
+    "in vec3 a_position;\n"
+    "in vec3 a_normal;\n"
+    "in vec2 a_texcoord;\n"
+    "uniform mat4 u_projection;\n"
+    "uniform mat4 u_view;\n"
+    "uniform vec3 u_offset;\n"
+    "uniform vec3 u_color;\n"
+    "out vec3 v_color;\n"
+    "out vec2 v_texcoord;\n"
+    "const vec3 LIGHT_EYE = vec3(0.0, 5.0, 5.0);\n"
+    "void main()\n"
+    "{\n"
+    "    vec4 eye = u_view * vec4(a_position + u_offset, 1.0);\n"
+    "    vec3 N = normalize(mat3(u_view) * a_normal);\n"
+    "    vec3 L = normalize(LIGHT_EYE - eye.xyz);\n"
+    "    v_color = min(u_color * (0.2 + max(dot(N, L), 0.0)), vec3(1.0));\n"
+    "    v_texcoord = a_texcoord;\n"
+    "    gl_Position = u_projection * eye;\n"
+    "}\n";
+static const char *LIT_FRAGMENT_SHADER =
+    "#version 330 core\n"
+    "in vec3 v_color;\n"
+    "in vec2 v_texcoord;\n"
+    "uniform sampler2D u_texture;\n"
+    "out vec4 o_color;\n"
+    "void main()\n"
+    "{\n"
+    "    o_color = vec4(v_color, 1.0) * texture(u_texture, v_texcoord);\n"
+    "}\n";
+// PLAYER_VERTEX_SHADER without the built-in matrix and light state.
+static const char *FIGURES_VERTEX_SHADER =
+    "#version 330 core\n"
+    "in vec3 a_position;\n"
+    "in vec3 a_normal;\n"
+    "in float a_slot;\n"
+    "in vec4 a_row0;\n"
+    "in vec4 a_row1;\n"
+    "in vec4 a_row2;\n"
+    "in vec3 a_color;\n"
+    "uniform mat4 u_projection;\n"
+    "uniform mat4 u_view;\n"
+    "out vec3 v_color;\n"
+    "const vec3 LIGHT_EYE = vec3(0.0, 5.0, 5.0);\n"
+    "void main()\n"
+    "{\n"
+    "    vec4 p = vec4(a_position, 1.0);\n"
+    "    vec4 eye = u_view * vec4(dot(a_row0, p), dot(a_row1, p), dot(a_row2, p), 1.0);\n"
+    "    vec3 n = vec3(dot(a_row0.xyz, a_normal), dot(a_row1.xyz, a_normal), dot(a_row2.xyz, a_normal));\n"
+    "    vec3 N = normalize(mat3(u_view) * n);\n"
+    "    vec3 L = normalize(LIGHT_EYE - eye.xyz);\n"
+    "    vec3 base = a_slot < 0.5 ? a_color : (a_slot < 1.5 ? vec3(0.9, 0.7, 0.6) : a_color * 0.5);\n"
+    "    v_color = min(base * (0.2 + max(dot(N, L), 0.0)), vec3(1.0));\n"
+    "    gl_Position = u_projection * eye;\n"
+    "}\n";
+static const char *FLAT_VERTEX_SHADER =
+    "#version 330 core\n"
+    "in vec3 a_position;\n"
+    "uniform mat4 u_projection;\n"
+    "uniform mat4 u_view;\n"
+    "uniform vec3 u_offset;\n"
+    "uniform vec3 u_color;\n"
+    "out vec3 v_color;\n"
+    "void main()\n"
+    "{\n"
+    "    v_color = u_color;\n"
+    "    gl_Position = u_projection * u_view * vec4(a_position + u_offset, 1.0);\n"
+    "}\n";
+static const char *COLOR_FRAGMENT_SHADER =
+    "#version 330 core\n"
+    "in vec3 v_color;\n"
+    "out vec4 o_color;\n"
+    "void main()\n"
+    "{\n"
+    "    o_color = vec4(v_color, 1.0);\n"
+    "}\n";
+static const char *OVERLAY_VERTEX_SHADER =
+    "#version 330 core\n"
+    "in vec2 a_position;\n"
+    "in vec2 a_texcoord;\n"
+    "uniform mat4 u_projection;\n"
+    "out vec2 v_texcoord;\n"
+    "void main()\n"
+    "{\n"
+    "    v_texcoord = a_texcoord;\n"
+    "    gl_Position = u_projection * vec4(a_position, 0.0, 1.0);\n"
+    "}\n";
+static const char *OVERLAY_FRAGMENT_SHADER =
+    "#version 330 core\n"
+    "in vec2 v_texcoord;\n"
+    "uniform vec3 u_color;\n"
+    "uniform sampler2D u_texture;\n"
+    "out vec4 o_color;\n"
+    "void main()\n"
+    "{\n"
+    "    o_color = vec4(u_color, 1.0) * texture(u_texture, v_texcoord);\n"
+    "}\n";
+const char *const UNIFORM_NAMES[UNIFORM_COUNT] = {"u_projection", "u_view", "u_offset", "u_color", "u_texture"};
+const float IDENTITY_MATRIX[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+const int DEPTH_KEY_BITS = 24;      // Camera distance, quantised over [0, CAMERA_FAR]
+const int SEQUENCE_KEY_BITS = 20;   // Queue order, which breaks ties so sorting is stable
+
+/**
+ * @brief The gluPerspective() matrix, column-major.
+ */
+void perspectiveMatrix(float out[16], float fov_y, float aspect, float near_z, float far_z)
+{
+    float f = 1.0f / std::tan(fov_y * 0.5f * (float)PI / 180.0f);
+    std::fill(out, out + 16, 0.0f);
+    out[0] = f / aspect;
+    out[5] = f;
+    out[10] = (far_z + near_z) / (near_z - far_z);
+    out[11] = -1.0f;
+    out[14] = 2.0f * far_z * near_z / (near_z - far_z);
+}
+
+/**
+ * @brief The gluOrtho2D() matrix, column-major.
+ */
+void orthoMatrix(float out[16], float left, float right, float bottom, float top)
+{
+    std::fill(out, out + 16, 0.0f);
+    out[0] = 2.0f / (right - left);
+    out[5] = 2.0f / (top - bottom);
+    out[10] = -1.0f;
+    out[12] = -(right + left) / (right - left);
+    out[13] = -(top + bottom) / (top - bottom);
+    out[15] = 1.0f;
+}
+
+/**
+ * @brief The gluLookAt() matrix for `eye` looking at `center` with +Y up, column-major.
+ */
+static void lookAtMatrix(float out[16], const float eye[3], const float center[3])
+{
+    float f[3] = {center[0] - eye[0], center[1] - eye[1], center[2] - eye[2]};
+    float f_length = std::sqrt(f[0] * f[0] + f[1] * f[1] + f[2] * f[2]);
+    for (int i = 0; i < 3; i++)
+        f[i] /= f_length;
+    float s[3] = {-f[2], 0.0f, f[0]}; // f x up, with up = +Y
+    float s_length = std::sqrt(s[0] * s[0] + s[2] * s[2]);
+    s[0] /= s_length;
+    s[2] /= s_length;
+    float u[3] = {s[1] * f[2] - s[2] * f[1], s[2] * f[0] - s[0] * f[2], s[0] * f[1] - s[1] * f[0]};
+    std::fill(out, out + 16, 0.0f);
+    for (int i = 0; i < 3; i++)
+    {
+        out[4 * i] = s[i];
+        out[4 * i + 1] = u[i];
+        out[4 * i + 2] = -f[i];
+    }
+    out[12] = -(s[0] * eye[0] + s[1] * eye[1] + s[2] * eye[2]);
+    out[13] = -(u[0] * eye[0] + u[1] * eye[1] + u[2] * eye[2]);
+    out[14] = f[0] * eye[0] + f[1] * eye[1] + f[2] * eye[2];
+    out[15] = 1.0f;
+}
+
+/**
+ * @brief Distance from the camera to a world-space point.
+ */
+float cameraDistance(float x, float y, float z)
+{
+    float dx = x, dy = y - CAMERA_EYE_Y, dz = z - CAMERA_EYE_Z;
+    return std::sqrt(dx * dx + dy * dy + dz * dz);
+}
+
+static void vertexAttrib(GLuint index, GLint size, GLsizei stride, size_t offset, GLuint divisor)
+{
+    glEnableVertexAttribArray(index);
+    glVertexAttribPointer(index, size, GL_FLOAT, GL_FALSE, stride, (const GLvoid *)offset);
+    glVertexAttribDivisor(index, divisor);
+}
+
+/**
+ * @brief Compiles the shader set and records every mesh's vertex layout in a VAO. Needs the meshes
+ * built and a GL 3.3 context; returns false (leaving the fixed-function path in charge) otherwise.
+ */
+bool initShaderPath()
+{
+    if (!glVersionAtLeast(3, 3))
+        return false;
+    RenderQueue &q = renderQueue;
+    const char *lit_attribs[3] = {"a_position", "a_normal", "a_texcoord"};
+    const char *figure_attribs[PLAYER_ATTRIB_COUNT] = {"a_position", "a_normal", "a_slot", "a_row0",
+                                                       "a_row1", "a_row2", "a_color"};
+    const char *flat_attribs[1] = {"a_position"};
+    const char *overlay_attribs[2] = {"a_position", "a_texcoord"};
+    q.programs[PROGRAM_LIT] = compileProgram(LIT_VERTEX_SHADER, LIT_FRAGMENT_SHADER, lit_attribs, 3);
+    q.programs[PROGRAM_FIGURES] =
+        compileProgram(FIGURES_VERTEX_SHADER, COLOR_FRAGMENT_SHADER, figure_attribs, PLAYER_ATTRIB_COUNT);
+    q.programs[PROGRAM_FLAT] = compileProgram(FLAT_VERTEX_SHADER, COLOR_FRAGMENT_SHADER, flat_attribs, 1);
+    q.programs[PROGRAM_OVERLAY] = compileProgram(OVERLAY_VERTEX_SHADER, OVERLAY_FRAGMENT_SHADER, overlay_attribs, 2);
+    for (int p = 0; p < PROGRAM_COUNT; p++)
+    {
+        if (!q.programs[p])
+            return false;
+        glUseProgram(q.programs[p]);
+        for (int u = 0; u < UNIFORM_COUNT; u++)
+            q.uniforms[p][u] = glGetUniformLocation(q.programs[p], UNIFORM_NAMES[u]); // -1 if unused
+        glUniform1i(q.uniforms[p][UNIFORM_TEXTURE], 0);
+    }
+    glUseProgram(0);
+
+    // Untextured lit meshes sample this, so one program serves them and the pitch.
+    const unsigned char white[4] = {255, 255, 255, 255};
+    glGenTextures(1, &q.white_texture);
+    glBindTexture(GL_TEXTURE_2D, q.white_texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenVertexArrays(MESH_COUNT, q.vaos);
+    const GLsizei stride = STATIC_VERTEX_FLOATS * sizeof(float);
+    const GLuint mesh_buffers[3] = {staticSceneVBO, ballMeshVBO, playerMeshVBO}; // MESH_SCENE..MESH_FIGURES
+    for (int m = MESH_SCENE; m <= MESH_FIGURES; m++)
+    {
+        glBindVertexArray(q.vaos[m]);
+        glBindBuffer(GL_ARRAY_BUFFER, mesh_buffers[m]);
+        vertexAttrib(0, 3, stride, 0, 0);
+        vertexAttrib(1, 3, stride, 3 * sizeof(float), 0);
+        vertexAttrib(2, 2, stride, 6 * sizeof(float), 0); // Figures read only .x, their colour slot
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, playerInstanceVBO); // MESH_FIGURES is still bound
+    for (int i = PLAYER_ATTRIB_ROW0; i <= PLAYER_ATTRIB_COLOR; i++)
+        vertexAttrib(i, i == PLAYER_ATTRIB_COLOR ? 3 : 4, sizeof(PlayerInstance),
+                     (size_t)(i - PLAYER_ATTRIB_ROW0) * 4 * sizeof(float), 1);
+
+    glBindVertexArray(q.vaos[MESH_NET]);
+    glBindBuffer(GL_ARRAY_BUFFER, netCloth.vbo);
+    vertexAttrib(0, 3, 0, 0, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, netCloth.ibo);
+
+    const TextVertex blit[3] = {{-1.0f, -1.0f, 0.0f, 0.0f}, {3.0f, -1.0f, 2.0f, 0.0f}, {-1.0f, 3.0f, 0.0f, 2.0f}};
+    glGenBuffers(1, &q.text_vbo);
+    glGenBuffers(1, &q.blit_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, q.blit_vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(blit), blit, GL_STATIC_DRAW);
+    const GLuint overlay_buffers[2] = {q.text_vbo, q.blit_vbo}; // MESH_TEXT, MESH_BLIT
+    for (int m = MESH_TEXT; m <= MESH_BLIT; m++)
+    {
+        glBindVertexArray(q.vaos[m]);
+        glBindBuffer(GL_ARRAY_BUFFER, overlay_buffers[m - MESH_TEXT]);
+        vertexAttrib(0, 2, sizeof(TextVertex), 0, 0);
+        vertexAttrib(1, 2, sizeof(TextVertex), 2 * sizeof(float), 0);
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    const float eye[3] = {0.0f, CAMERA_EYE_Y, CAMERA_EYE_Z};
+    const float center[3] = {0.0f, CAMERA_TARGET_Y, CAMERA_TARGET_Z};
+    lookAtMatrix(q.view, eye, center);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    return true;
+}
+
+/**
+ * @brief Adds one draw to the queue, untranslated and with its sort key built from `pipeline`,
+ * `texture` and `distance` (the camera distance of the drawn object). Opaque pipelines sort front to
+ * back, blended ones back to front. The reference is valid until the next queueDraw().
+ */
+RenderCommand &queueDraw(RenderPipeline pipeline, RenderMesh mesh, GLuint texture, GLenum primitive, DrawRange range,
+                         float distance, float r, float g, float b)
+{
+    std::vector<RenderCommand> &commands = renderQueue.commands;
+    const uint64_t depth_steps = (1ULL << DEPTH_KEY_BITS) - 1;
+    uint64_t depth = (uint64_t)(std::min(std::max(distance / CAMERA_FAR, 0.0f), 1.0f) * depth_steps);
+    if (PIPELINES[pipeline].blend)
+        depth = depth_steps - depth;
+    RenderCommand command;
+    command.key = (uint64_t)pipeline << 60 | (uint64_t)(texture & 0xFFFF) << (DEPTH_KEY_BITS + SEQUENCE_KEY_BITS) |
+                  depth << SEQUENCE_KEY_BITS | (commands.size() & ((1u << SEQUENCE_KEY_BITS) - 1));
+    command.pipeline = pipeline;
+    command.mesh = mesh;
+    command.texture = texture;
+    command.primitive = primitive;
+    command.range = range;
+    command.instances = 0;
+    command.indexed = false;
+    command.line_width = 1.0f;
+    command.offset[0] = command.offset[1] = command.offset[2] = 0.0f;
+    command.color[0] = r;
+    command.color[1] = g;
+    command.color[2] = b;
+    commands.push_back(command);
+    return commands.back();
+}
+
+/**
+ * @brief Moves a queued draw by (x, y, z) in world space.
+ */
+void translateCommand(RenderCommand &command, float x, float y, float z)
+{
+    command.offset[0] = x;
+    command.offset[1] = y;
+    command.offset[2] = z;
+}
+
+static bool commandBefore(const RenderCommand &a, const RenderCommand &b)
+{
+    return a.key < b.key;
+}
+
+static void setCapability(GLenum capability, bool enabled)
+{
+    if (enabled)
+        glEnable(capability);
+    else
+        glDisable(capability);
+}
+
+/**
+ * @brief Sorts the queue and draws it, changing program, matrices, depth test, blending, texture,
+ * VAO and line width only where they differ from the previous command. Adds to renderQueue.frame and
+ * leaves GL as it found it: depth test on, blending off, nothing bound.
+ */
+void submitRenderQueue()
+{
+    RenderQueue &q = renderQueue;
+    if (q.commands.empty())
+        return;
+    std::sort(q.commands.begin(), q.commands.end(), commandBefore);
+    RenderStats &stats = q.frame;
+    int pipeline = -1, program = -1, space = -1, mesh = -1;
+    GLuint texture = 0; // Commands with texture 0 sample nothing and keep whatever is bound
+    bool depth_test = true, blend = false;
+    float line_width = 1.0f;
+    for (size_t i = 0; i < q.commands.size(); i++)
+    {
+        const RenderCommand &c = q.commands[i];
+        const PipelineState &p = PIPELINES[c.pipeline];
+        const GLint *uniforms = q.uniforms[p.program];
+        if (c.pipeline != pipeline)
+        {
+            pipeline = c.pipeline;
+            if (p.program != program)
+            {
+                glUseProgram(q.programs[p.program]);
+                program = p.program;
+                space = -1;
+                stats.state_changes++;
+            }
+            if (p.space != space)
+            {
+                const float *projection = p.space == SPACE_WORLD ? q.projection
+                                          : p.space == SPACE_SCREEN ? q.screen
+                                                                    : IDENTITY_MATRIX;
+                glUniformMatrix4fv(uniforms[UNIFORM_PROJECTION], 1, GL_FALSE, projection);
+                glUniformMatrix4fv(uniforms[UNIFORM_VIEW], 1, GL_FALSE, p.space == SPACE_WORLD ? q.view : IDENTITY_MATRIX);
+                space = p.space;
+                stats.state_changes++;
+            }
+            if (p.depth_test != depth_test)
+            {
+                setCapability(GL_DEPTH_TEST, p.depth_test);
+                depth_test = p.depth_test;
+                stats.state_changes++;
+            }
+            if (p.blend != blend)
+            {
+                setCapability(GL_BLEND, p.blend);
+                blend = p.blend;
+                stats.state_changes++;
+            }
+        }
+        if (c.texture && c.texture != texture)
+        {
+            glBindTexture(GL_TEXTURE_2D, c.texture);
+            texture = c.texture;
+            stats.state_changes++;
+        }
+        if (c.mesh != mesh)
+        {
+            glBindVertexArray(q.vaos[c.mesh]);
+            mesh = c.mesh;
+            stats.state_changes++;
+        }
+        if (c.primitive == GL_LINES && c.line_width != line_width)
+        {
+            glLineWidth(c.line_width);
+            line_width = c.line_width;
+            stats.state_changes++;
+        }
+        glUniform3fv(uniforms[UNIFORM_OFFSET], 1, c.offset);
+        glUniform3fv(uniforms[UNIFORM_COLOR], 1, c.color);
+        if (c.instances)
+            glDrawArraysInstanced(c.primitive, c.range.first, c.range.count, c.instances);
+        else if (c.indexed)
+            glDrawElements(c.primitive, c.range.count, GL_UNSIGNED_INT,
+                           (const GLvoid *)((size_t)c.range.first * sizeof(uint32_t)));
+        else
+            glDrawArrays(c.primitive, c.range.first, c.range.count);
+        stats.draw_calls++;
+    }
+    stats.commands += (int)q.commands.size();
+    q.commands.clear();
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    if (!depth_test)
+        glEnable(GL_DEPTH_TEST);
+    if (blend)
+        glDisable(GL_BLEND);
+    if (line_width != 1.0f)
+        glLineWidth(1.0f);
+}
+
+// --- Pitch Texture ---
+// The grass quad samples one procedural texture: mown stripes, grain and the penalty-area
+// markings, with a full mip chain. Generation is vectorised, and the result is cached on disk
+// keyed by every parameter below, so later launches just map the file and upload it.
+const int PITCH_TEXTURE_SIZE = 1024;                    // Square, power of two; RGBA8
+const uint32_t PITCH_TEXTURE_VERSION = 1;               // Bump when the kernel changes
+const float PITCH_STRIPE_WIDTH = 2.5f;                  // Metres per mown stripe
+const float PITCH_STRIPE_COLOURS[2][3] = {{48.0f, 140.0f, 48.0f}, {34.0f, 118.0f, 34.0f}};
+const float PITCH_LINE_COLOUR[3] = {236.0f, 240.0f, 236.0f};
+const float PITCH_GRAIN = 0.09f;                        // +/- fraction of per-texel brightness noise
+const float PITCH_MARKING_SCALE = (PENALTY_SPOT_Z - GOAL_LINE_Z) / 11.0f; // Scene metres per real metre
+const float PITCH_LINE_HALF_WIDTH = 0.06f * PITCH_MARKING_SCALE;
+
+// Lines are axis-aligned rectangles; the arc and spot are circles. Distances are in metres.
+struct PitchRect
+{
+    float cx, cz, hx, hz;
+};
+struct PitchMarkings
+{
+    PitchRect rects[8];
+    int rect_count;
+    float arc_x, arc_z, arc_radius, arc_min_z; // Only drawn beyond the penalty area
+    float spot_radius;
+};
+
+static PitchMarkings pitchMarkings()
+{
+    const float s = PITCH_MARKING_SCALE, w = PITCH_LINE_HALF_WIDTH;
+    const float post_x = GOAL_WIDTH / 2;
+    const float box_x = post_x + 16.5f * s, box_z = GOAL_LINE_Z + 16.5f * s;
+    const float six_x = post_x + 5.5f * s, six_z = GOAL_LINE_Z + 5.5f * s;
+    PitchMarkings m;
+    PitchRect rects[] = {
+        {0.0f, GOAL_LINE_Z, PITCH_MAX_X, w},                                 // Goal line
+        {0.0f, box_z, box_x + w, w},                                         // Penalty area front
+        {-box_x, (GOAL_LINE_Z + box_z) / 2, w, (box_z - GOAL_LINE_Z) / 2 + w}, // Penalty area sides
+        {box_x, (GOAL_LINE_Z + box_z) / 2, w, (box_z - GOAL_LINE_Z) / 2 + w},
+        {0.0f, six_z, six_x + w, w},                                         // Goal area front
+        {-six_x, (GOAL_LINE_Z + six_z) / 2, w, (six_z - GOAL_LINE_Z) / 2 + w}, // Goal area sides
+        {six_x, (GOAL_LINE_Z + six_z) / 2, w, (six_z - GOAL_LINE_Z) / 2 + w},
+    };
+    m.rect_count = sizeof(rects) / sizeof(rects[0]);
+    std::copy(rects, rects + m.rect_count, m.rects);
+    m.arc_x = 0.0f;
+    m.arc_z = PENALTY_SPOT_Z;
+    m.arc_radius = 9.15f * s;
+    m.arc_min_z = box_z + w;
+    m.spot_radius = 0.11f * s;
+    return m;
+}
+
+/**
+ * @brief FNV-1a over every input of the generator, so any change makes a new cache file.
+ */
+static uint64_t pitchTextureKey()
+{
+    PitchMarkings markings = pitchMarkings();
+    float params[] = {PITCH_MIN_X, PITCH_MAX_X, PITCH_NEAR_Z, PITCH_FAR_Z, PITCH_STRIPE_WIDTH,
+                      PITCH_STRIPE_COLOURS[0][0], PITCH_STRIPE_COLOURS[0][1], PITCH_STRIPE_COLOURS[0][2],
+                      PITCH_STRIPE_COLOURS[1][0], PITCH_STRIPE_COLOURS[1][1], PITCH_STRIPE_COLOURS[1][2],
+                      PITCH_LINE_COLOUR[0], PITCH_LINE_COLOUR[1], PITCH_LINE_COLOUR[2], PITCH_GRAIN,
+                      markings.arc_x, markings.arc_z, markings.arc_radius, markings.arc_min_z, markings.spot_radius};
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    const unsigned char *bytes[] = {(const unsigned char *)params, (const unsigned char *)markings.rects};
+    size_t sizes[] = {sizeof(params), sizeof(PitchRect) * markings.rect_count};
+    for (int part = 0; part < 2; part++)
+        for (size_t i = 0; i < sizes[part]; i++)
+            hash = (hash ^ bytes[part][i]) * 0x100000001B3ULL;
+    uint32_t ints[] = {(uint32_t)PITCH_TEXTURE_SIZE, PITCH_TEXTURE_VERSION};
+    for (size_t i = 0; i < sizeof(ints); i++)
+        hash = (hash ^ ((const unsigned char *)ints)[i]) * 0x100000001B3ULL;
+    return hash;
+}
+
+// Per-row terms shared by the scalar and SSE2 kernels.
+struct PitchRow
+{
+    float z;
+    float stripe[3];
+    float rect_dz[8]; // |z - cz| - hz for each rect
+    bool rect_live[8]; // False when the rect cannot cover any texel of this row
+    float arc_dz2, spot_dz2;
+    bool arc_live;
+};
+
+static void preparePitchRow(const PitchMarkings &markings, int row, float texel, PitchRow &r)
+{
+    r.z = PITCH_NEAR_Z + (PITCH_FAR_Z - PITCH_NEAR_Z) * (row + 0.5f) / PITCH_TEXTURE_SIZE;
+    int stripe = (int)std::floor((r.z - GOAL_LINE_Z) / PITCH_STRIPE_WIDTH) & 1;
+    for (int c = 0; c < 3; c++)
+        r.stripe[c] = PITCH_STRIPE_COLOURS[stripe][c];
+    for (int i = 0; i < markings.rect_count; i++)
+    {
+        r.rect_dz[i] = std::fabs(r.z - markings.rects[i].cz) - markings.rects[i].hz;
+        r.rect_live[i] = r.rect_dz[i] < texel;
+    }
+    r.arc_dz2 = (r.z - markings.arc_z) * (r.z - markings.arc_z);
+    r.spot_dz2 = r.arc_dz2;
+    r.arc_live = r.z > markings.arc_min_z - texel;
+}
+
+inline uint32_t pitchGrainHash(uint32_t h)
+{
+    h ^= h << 13;
+    h ^= h >> 17;
+    h ^= h << 5;
+    return h;
+}
+
+/**
+ * @brief Reference kernel for one texel; the SSE2 path computes the same expression four texels wide.
+ */
+static uint32_t pitchTexel(const PitchMarkings &markings, const PitchRow &r, int row, int col, float texel)
+{
+    float x = PITCH_MIN_X + (PITCH_MAX_X - PITCH_MIN_X) * (col + 0.5f) / PITCH_TEXTURE_SIZE;
+    float d = 1e9f;
+    for (int i = 0; i < markings.rect_count; i++)
+        if (r.rect_live[i])
+            d = std::min(d, std::max(std::fabs(x - markings.rects[i].cx) - markings.rects[i].hx, r.rect_dz[i]));
+    float dx2 = (x - markings.arc_x) * (x - markings.arc_x);
+    if (r.arc_live)
+        d = std::min(d, std::fabs(std::sqrt(dx2 + r.arc_dz2) - markings.arc_radius) - PITCH_LINE_HALF_WIDTH);
+    d = std::min(d, std::sqrt(dx2 + r.spot_dz2) - markings.spot_radius);
+    float line = std::min(std::max(0.5f - d / texel, 0.0f), 1.0f);
+    uint32_t hash = pitchGrainHash((uint32_t)(row * PITCH_TEXTURE_SIZE + col) + 0x9E3779B9u);
+    float grain = 1.0f + PITCH_GRAIN * ((float)(hash & 0xFF) * (2.0f / 255.0f) - 1.0f);
+    uint32_t texel_rgba = 0xFF000000u;
+    for (int c = 0; c < 3; c++)
+    {
+        float grass = r.stripe[c] * grain;
+        float value = grass + (PITCH_LINE_COLOUR[c] - grass) * line;
+        texel_rgba |= (uint32_t)lrintf(std::min(std::max(value, 0.0f), 255.0f)) << (8 * c);
+    }
+    return texel_rgba;
+}
+
+#ifdef PENALTY_HAS_SSE2
+static int pitchRowSSE2(const PitchMarkings &markings, const PitchRow &r, int row, float texel, uint32_t *out)
+{
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), half = _mm_set1_ps(0.5f);
+    const __m128 sign_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    const __m128 inv_texel = _mm_set1_ps(1.0f / texel), max_value = _mm_set1_ps(255.0f);
+    const float x_step = (PITCH_MAX_X - PITCH_MIN_X) / PITCH_TEXTURE_SIZE;
+    const __m128i lanes = _mm_set_epi32(3, 2, 1, 0);
+    int col = 0;
+    for (; col + 4 <= PITCH_TEXTURE_SIZE; col += 4)
+    {
+        __m128 x = _mm_add_ps(_mm_set1_ps(PITCH_MIN_X),
+                              _mm_mul_ps(_mm_set1_ps(x_step), _mm_add_ps(_mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(col), lanes)), half)));
+        __m128 d = _mm_set1_ps(1e9f);
+        for (int i = 0; i < markings.rect_count; i++)
+        {
+            if (!r.rect_live[i])
+                continue;
+            __m128 dx = _mm_sub_ps(_mm_and_ps(_mm_sub_ps(x, _mm_set1_ps(markings.rects[i].cx)), sign_mask),
+                                   _mm_set1_ps(markings.rects[i].hx));
+            d = _mm_min_ps(d, _mm_max_ps(dx, _mm_set1_ps(r.rect_dz[i])));
+        }
+        __m128 ax = _mm_sub_ps(x, _mm_set1_ps(markings.arc_x));
+        __m128 dx2 = _mm_mul_ps(ax, ax);
+        if (r.arc_live)
+        {
+            __m128 ring = _mm_sub_ps(_mm_sqrt_ps(_mm_add_ps(dx2, _mm_set1_ps(r.arc_dz2))), _mm_set1_ps(markings.arc_radius));
+            d = _mm_min_ps(d, _mm_sub_ps(_mm_and_ps(ring, sign_mask), _mm_set1_ps(PITCH_LINE_HALF_WIDTH)));
+        }
+        d = _mm_min_ps(d, _mm_sub_ps(_mm_sqrt_ps(_mm_add_ps(dx2, _mm_set1_ps(r.spot_dz2))), _mm_set1_ps(markings.spot_radius)));
+        __m128 line = _mm_min_ps(_mm_max_ps(_mm_sub_ps(half, _mm_mul_ps(d, inv_texel)), zero), one);
+
+        __m128i hash = _mm_add_epi32(_mm_set1_epi32(row * PITCH_TEXTURE_SIZE + col + (int)0x9E3779B9u), lanes);
+        hash = _mm_xor_si128(hash, _mm_slli_epi32(hash, 13));
+        hash = _mm_xor_si128(hash, _mm_srli_epi32(hash, 17));
+        hash = _mm_xor_si128(hash, _mm_slli_epi32(hash, 5));
+        __m128 noise = _mm_cvtepi32_ps(_mm_and_si128(hash, _mm_set1_epi32(0xFF)));
+        __m128 grain = _mm_add_ps(one, _mm_mul_ps(_mm_set1_ps(PITCH_GRAIN), _mm_sub_ps(_mm_mul_ps(noise, _mm_set1_ps(2.0f / 255.0f)), one)));
+
+        __m128i rgba = _mm_set1_epi32((int)0xFF000000u);
+        for (int c = 0; c < 3; c++)
+        {
+            __m128 grass = _mm_mul_ps(_mm_set1_ps(r.stripe[c]), grain);
+            __m128 value = _mm_add_ps(grass, _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(PITCH_LINE_COLOUR[c]), grass), line));
+            value = _mm_min_ps(_mm_max_ps(value, zero), max_value);
+            rgba = _mm_or_si128(rgba, _mm_slli_epi32(_mm_cvtps_epi32(value), 8 * c));
+        }
+        _mm_storeu_si128((__m128i *)(out + col), rgba);
+    }
+    return col;
+}
+#endif
+
+/**
+ * @brief Box-filters one mip level into the next, rounding to nearest. `width` is the source width.
+ */
+static void downsamplePitchLevel(const uint32_t *src, int width, int height, uint32_t *dst)
+{
+    int dst_width = std::max(width / 2, 1), dst_height = std::max(height / 2, 1);
+    for (int y = 0; y < dst_height; y++)
+    {
+        const unsigned char *row0 = (const unsigned char *)(src + (size_t)std::min(2 * y, height - 1) * width);
+        const unsigned char *row1 = (const unsigned char *)(src + (size_t)std::min(2 * y + 1, height - 1) * width);
+        unsigned char *out = (unsigned char *)(dst + (size_t)y * dst_width);
+        int x = 0;
+#ifdef PENALTY_HAS_SSE2
+        const __m128i zero = _mm_setzero_si128(), round = _mm_set1_epi16(2);
+        for (; x + 2 <= dst_width && width >= 4; x += 2)
+        {
+            // Four source texels from each row make two output texels
+            __m128i a = _mm_loadu_si128((const __m128i *)(row0 + 8 * x));
+            __m128i b = _mm_loadu_si128((const __m128i *)(row1 + 8 * x));
+            __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+            __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+            lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+            hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+            __m128i sum = _mm_unpacklo_epi64(lo, hi);
+            sum = _mm_srli_epi16(_mm_add_epi16(sum, round), 2);
+            _mm_storel_epi64((__m128i *)(out + 4 * x), _mm_packus_epi16(sum, zero));
+        }
+#endif
+        for (; x < dst_width; x++)
+        {
+            int x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+            for (int c = 0; c < 4; c++)
+                out[4 * x + c] = (unsigned char)((row0[4 * x0 + c] + row0[4 * x1 + c] + row1[4 * x0 + c] +
+                                                  row1[4 * x1 + c] + 2) >> 2);
+        }
+    }
+}
+
+static int pitchMipLevels()
+{
+    int levels = 1;
+    for (int size = PITCH_TEXTURE_SIZE; size > 1; size /= 2)
+        levels++;
+    return levels;
+}
+
+static size_t pitchMipTexels()
+{
+    size_t texels = 0;
+    for (int size = PITCH_TEXTURE_SIZE; size >= 1; size /= 2)
+        texels += (size_t)size * size;
+    return texels;
+}
+
+/**
+ * @brief Synthesises level 0 and the whole mip chain into `texels`, levels stored back to back.
+ */
+static void generatePitchTexture(uint32_t *texels)
+{
+    PitchMarkings markings = pitchMarkings();
+    float texel = (PITCH_MAX_X - PITCH_MIN_X) / PITCH_TEXTURE_SIZE;
+    PitchRow r;
+    for (int row = 0; row < PITCH_TEXTURE_SIZE; row++)
+    {
+        preparePitchRow(markings, row, texel, r);
+        uint32_t *out = texels + (size_t)row * PITCH_TEXTURE_SIZE;
+        int col = 0;
+#ifdef PENALTY_HAS_SSE2
+        col = pitchRowSSE2(markings, r, row, texel, out);
+#endif
+        for (; col < PITCH_TEXTURE_SIZE; col++)
+            out[col] = pitchTexel(markings, r, row, col, texel);
+    }
+    uint32_t *level = texels;
+    for (int size = PITCH_TEXTURE_SIZE; size > 1; size /= 2)
+    {
+        uint32_t *next = level + (size_t)size * size;
+        downsamplePitchLevel(level, size, size, next);
+        level = next;
+    }
+}
+
+// Cache file layout: this header, then every mip level's RGBA8 texels, largest first.
+struct PitchCacheHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t key;
+    uint32_t size, levels;
+    uint64_t generate_us; // What a cache hit saves
+};
+const char PITCH_CACHE_MAGIC[4] = {'P', 'S', 'T', 'X'};
+
+/**
+ * @brief Directory for cached textures: $PENALTY_CACHE_DIR, else the per-user cache directory.
+ * Returns an empty string when there is nowhere suitable (the cache is then skipped).
+ */
+static std::string pitchCacheDir()
+{
+    const char *dir = std::getenv("PENALTY_CACHE_DIR");
+    if (dir && *dir)
+        return dir;
+#ifdef _WIN32
+    const char *base = std::getenv("LOCALAPPDATA");
+    return base ? std::string(base) + "\\penalty-shootout" : std::string();
+#else
+    const char *xdg = std::getenv("XDG_CACHE_HOME");
+    if (xdg && *xdg)
+        return std::string(xdg) + "/penalty-shootout";
+    const char *home = std::getenv("HOME");
+    return home ? std::string(home) + "/.cache/penalty-shootout" : std::string();
+#endif
+}
+
+static void makeCacheDir(const std::string &dir)
+{
+    // Creates each missing component; failures surface when the file itself is opened
+    for (size_t i = 1; i <= dir.size(); i++)
+    {
+        if (i < dir.size() && dir[i] != '/' && dir[i] != '\\')
+            continue;
+        std::string part = dir.substr(0, i);
+#ifdef _WIN32
+        _mkdir(part.c_str());
+#else
+        mkdir(part.c_str(), 0755);
+#endif
+    }
+}
+
+/**
+ * @brief Maps a cache file and uploads its levels straight from the mapping. False on any
+ * mismatch, so a stale or truncated file is simply regenerated.
+ */
+static bool uploadCachedPitchTexture(const std::string &path, uint64_t key, uint64_t &generate_us)
+{
+    size_t expected = sizeof(PitchCacheHeader) + pitchMipTexels() * 4;
+#ifdef _WIN32
+    // No mmap here: read the file into memory instead
+    FILE *in = std::fopen(path.c_str(), "rb");
+    if (!in)
+        return false;
+    std::vector<unsigned char> data(expected);
+    bool complete = std::fread(&data[0], 1, expected, in) == expected && std::fgetc(in) == EOF;
+    std::fclose(in);
+    if (!complete)
+        return false;
+    const unsigned char *bytes = &data[0];
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size != expected)
+    {
+        close(fd);
+        return false;
+    }
+    void *mapping = mmap(NULL, expected, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+        return false;
+    const unsigned char *bytes = (const unsigned char *)mapping;
+#endif
+    PitchCacheHeader header;
+    std::memcpy(&header, bytes, sizeof(header));
+    bool valid = std::memcmp(header.magic, PITCH_CACHE_MAGIC, 4) == 0 && header.version == PITCH_TEXTURE_VERSION &&
+                 header.key == key && header.size == (uint32_t)PITCH_TEXTURE_SIZE &&
+                 header.levels == (uint32_t)pitchMipLevels();
+    if (valid)
+    {
+        const unsigned char *level = bytes + sizeof(header);
+        for (int i = 0, size = PITCH_TEXTURE_SIZE; size >= 1; i++, size /= 2)
+        {
+            glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, level);
+            level += (size_t)size * size * 4;
+        }
+        generate_us = header.generate_us;
+    }
+#ifndef _WIN32
+    munmap(mapping, expected);
+#endif
+    return valid;
+}
+
+static void writePitchCache(const std::string &path, uint64_t key, uint64_t generate_us,
+                            const std::vector<uint32_t> &texels)
+{
+    PitchCacheHeader header;
+    std::memcpy(header.magic, PITCH_CACHE_MAGIC, 4);
+    header.version = PITCH_TEXTURE_VERSION;
+    header.key = key;
+    header.size = PITCH_TEXTURE_SIZE;
+    header.levels = pitchMipLevels();
+    header.generate_us = generate_us;
+    // Written under a temporary name and renamed, so a concurrent launch never maps half a file
+    std::string temp = path + ".tmp";
+    FILE *out = std::fopen(temp.c_str(), "wb");
+    if (!out)
+        return;
+    bool ok = std::fwrite(&header, sizeof(header), 1, out) == 1 &&
+              std::fwrite(&texels[0], 4, texels.size(), out) == texels.size();
+    ok = std::fclose(out) == 0 && ok;
+#ifdef _WIN32
+    // rename() will not replace an existing file here; MoveFileEx() does so in one step
+    bool moved = ok && MoveFileExA(temp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    bool moved = ok && std::rename(temp.c_str(), path.c_str()) == 0; // Atomically replaces an old cache
+#endif
+    if (!moved)
+        std::remove(temp.c_str());
+}
+
+/**
+ * @brief Records this launch in the cache's running totals and prints the hit rate and time saved.
+ */
+static void reportPitchCache(const std::string &dir, bool hit, double load_ms, uint64_t generate_us)
+{
+    uint64_t lookups = 0, hits = 0, saved_us = 0;
+    std::string stats_path = dir + "/pitch-texture.stats";
+    if (!dir.empty())
+    {
+        FILE *in = std::fopen(stats_path.c_str(), "r");
+        if (in)
+        {
+            unsigned long long a = 0, b = 0, c = 0;
+            if (std::fscanf(in, "%llu %llu %llu", &a, &b, &c) == 3)
+                lookups = a, hits = b, saved_us = c;
+            std::fclose(in);
+        }
+    }
+    double generate_ms = generate_us / 1000.0;
+    lookups++;
+    if (hit)
+    {
+        hits++;
+        saved_us += (uint64_t)(std::max(0.0, generate_ms - load_ms) * 1000.0);
+    }
+    if (!dir.empty())
+    {
+        FILE *out = std::fopen(stats_path.c_str(), "w");
+        if (out)
+        {
+            std::fprintf(out, "%llu %llu %llu\n", (unsigned long long)lookups, (unsigned long long)hits,
+                         (unsigned long long)saved_us);
+            std::fclose(out);
+        }
+    }
+    std::cerr << "Pitch texture: " << (hit ? "cache hit" : "generated") << " in " << load_ms << " ms";
+    if (hit)
+        std::cerr << " (generating takes " << generate_ms << " ms)";
+    std::cerr << "; cache hit rate " << hits << "/" << lookups << ", " << saved_us / 1000 << " ms saved in total\n";
+}
+
+/**
+ * @brief Creates grassTextureID: mapped from the disk cache when the parameters match, otherwise
+ * generated (SSE2 where available), uploaded and written back for next time.
+ */
+void buildPitchTexture()
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    glGenTextures(1, &grassTextureID);
+    glBindTexture(GL_TEXTURE_2D, grassTextureID);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    if (hasGLExtension("GL_EXT_texture_filter_anisotropic"))
+    {
+        GLfloat max_anisotropy = 1.0f;
+        glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &max_anisotropy);
+        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, std::min(max_anisotropy, 8.0f));
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    uint64_t key = pitchTextureKey();
+    std::string dir = pitchCacheDir();
+    std::string path;
+    if (!dir.empty())
+    {
+        char name[64];
+        std::snprintf(name, sizeof(name), "/pitch-%016llx.tex", (unsigned long long)key);
+        path = dir + name;
+    }
+    uint64_t generate_us = 0;
+    bool hit = !path.empty() && uploadCachedPitchTexture(path, key, generate_us);
+    if (!hit)
+    {
+        std::vector<uint32_t> texels(pitchMipTexels());
+        generatePitchTexture(&texels[0]);
+        generate_us = (uint64_t)(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1e6);
+        const uint32_t *level = &texels[0];
+        for (int i = 0, size = PITCH_TEXTURE_SIZE; size >= 1; i++, size /= 2)
+        {
+            glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, level);
+            level += (size_t)size * size;
+        }
+        if (!path.empty())
+        {
+            makeCacheDir(dir);
+            writePitchCache(path, key, generate_us, texels);
+        }
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    double load_ms = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1000.0;
+    reportPitchCache(dir, hit, load_ms, generate_us);
+}
+
+// --- Frame Profiler ---
+
+#ifdef __APPLE__
+#define GL_TIME_ELAPSED GL_TIME_ELAPSED_EXT
+#define glGetQueryObjectui64v glGetQueryObjectui64vEXT
+#endif
+
+static double elapsedUs(ProfileClock::time_point since)
+{
+    return std::chrono::duration<double, std::micro>(ProfileClock::now() - since).count();
+}
+
+/**
+ * @brief Turns the profiler on. GPU timing is used only where timer queries are available.
+ */
+void initProfiler(bool overlay, const char *csv_path)
+{
+    if (!profiler.enabled)
+    {
+        profiler.enabled = true;
+        profiler.gpu_timers = hasGLExtension("GL_ARB_timer_query") || hasGLExtension("GL_EXT_timer_query");
+        if (profiler.gpu_timers)
+            glGenQueries(PROFILE_QUERY_LATENCY * PROFILE_SECTION_COUNT, &profiler.queries[0][0]);
+    }
+    profiler.overlay = profiler.overlay || overlay;
+    if (csv_path && !profiler.csv)
+    {
+        profiler.csv = std::fopen(csv_path, "w");
+        if (!profiler.csv)
+        {
+            std::cerr << "Cannot open " << csv_path << " for writing\n";
+            return;
+        }
+        std::fprintf(profiler.csv, "frame");
+        for (int i = 0; i < PROFILE_SECTION_COUNT; i++)
+            std::fprintf(profiler.csv, ",cpu_%s_us", PROFILE_SECTION_NAMES[i]);
+        std::fprintf(profiler.csv, ",cpu_frame_us");
+        for (int i = 0; i < PROFILE_SECTION_COUNT; i++)
+            std::fprintf(profiler.csv, ",gpu_%s_us", PROFILE_SECTION_NAMES[i]);
+        std::fprintf(profiler.csv, ",sim_steps,max_step_lateness_us,net_sim_us,draw_calls,state_changes\n");
+    }
+}
+
+static void profileFrameBegin()
+{
+    if (!profiler.enabled)
+        return;
+    profiler.frame_start = ProfileClock::now();
+    for (int i = 0; i < PROFILE_SECTION_COUNT; i++)
+        profiler.cpu_us[i] = 0.0;
+}
+
+void profileBegin(ProfileSection section)
+{
+    if (!profiler.enabled)
+        return;
+    int slot = (int)(profiler.frame % PROFILE_QUERY_LATENCY);
+    if (profiler.gpu_timers)
+    {
+        glBeginQuery(GL_TIME_ELAPSED, profiler.queries[slot][section]);
+        profiler.query_issued[slot][section] = true;
+    }
+    profiler.section_start = ProfileClock::now();
+}
+
+void profileEnd(ProfileSection section)
+{
+    if (!profiler.enabled)
+        return;
+    profiler.cpu_us[section] += elapsedUs(profiler.section_start);
+    if (profiler.gpu_timers)
+        glEndQuery(GL_TIME_ELAPSED);
+}
+
+/**
+ * @brief Records how late a fixed simulation step ran relative to its ideal wall-clock time.
+ */
+void profileTick(double lateness_us)
+{
+    if (!profiler.enabled)
+        return;
+    int bucket = std::min((int)(lateness_us / 1000.0), JITTER_BUCKETS - 1);
+    if (profiler.jitter_count == JITTER_WINDOW)
+    {
+        float evicted = profiler.jitter_ring[profiler.jitter_next];
+        profiler.jitter_histogram[std::min((int)(evicted / 1000.0f), JITTER_BUCKETS - 1)]--;
+    }
+    else
+        profiler.jitter_count++;
+    profiler.jitter_ring[profiler.jitter_next] = (float)lateness_us;
+    profiler.jitter_next = (profiler.jitter_next + 1) % JITTER_WINDOW;
+    profiler.jitter_histogram[bucket]++;
+    profiler.frame_ticks++;
+    profiler.frame_max_jitter_us = std::max(profiler.frame_max_jitter_us, lateness_us);
+}
+
+/**
+ * @brief Passes one step's lateness to the profiler and, during --sim-stress, to its collector.
+ */
+void noteStepLateness(double lateness_us)
+{
+    profileTick(lateness_us);
+    if (stepTiming.record)
+        stepTiming.lateness_us.push_back(lateness_us);
+}
+
+/**
+ * @brief Adds the net cloth's CPU time for one advanceSimulation() call to the current frame.
+ */
+void profileNetSim(double us)
+{
+    if (profiler.enabled)
+        profiler.frame_net_us += us;
+}
+
+static double percentile(std::vector<double> values, double p)
+{
+    if (values.empty())
+        return 0.0;
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, (size_t)(p * values.size()))];
+}
+
+/**
+ * @brief What a key about to reach `m` does for `side` (0 player, 1 AI), for the latency report.
+ */
+LatencyKind latencyKind(const Match &m, int side)
+{
+    if (m.state == WAITING_FOR_SHOT)
+        return side == 0 ? LATENCY_SHOT : LATENCY_DIVE;
+    if (m.state == WAITING_FOR_DIVE)
+        return side == 0 ? LATENCY_DIVE : LATENCY_SHOT;
+    return LATENCY_OTHER;
+}
+
+/**
+ * @brief Notes a key that has changed the match; its latency is taken when that frame is presented.
+ */
+void noteInputApplied(ProfileClock::time_point arrival, LatencyKind kind)
+{
+    if (!inputLatency.measure)
+        return;
+    PendingInput input = {arrival, kind};
+    inputLatency.applied.push_back(input);
+}
+
+/**
+ * @brief Called after a swap. Waits for the frame to finish, but only when it carries a key's
+ * effect, and records each such key's arrival-to-present time.
+ */
+static void recordInputPresented()
+{
+    if (inputLatency.applied.empty() || offscreen_mode)
+        return;
+    glFinish();
+    ProfileClock::time_point now = ProfileClock::now();
+    for (size_t i = 0; i < inputLatency.applied.size(); i++)
+    {
+        const PendingInput &input = inputLatency.applied[i];
+        inputLatency.samples_ms[input.kind].push_back(
+            std::chrono::duration<double, std::milli>(now - input.arrival).count());
+    }
+    inputLatency.applied.clear();
+}
+
+/**
+ * @brief Prints the key-to-present latency distribution per kind of key; registered with atexit().
+ */
+void printInputLatency()
+{
+    std::cerr << "Input latency, key arrival to frame presented:\n";
+    for (int k = 0; k < LATENCY_KIND_COUNT; k++)
+    {
+        const std::vector<double> &ms = inputLatency.samples_ms[k];
+        if (ms.empty())
+            continue;
+        std::cerr << "  " << LATENCY_KIND_NAMES[k] << "\t" << ms.size() << " keys, p50 " << percentile(ms, 0.5)
+                  << " ms, p99 " << percentile(ms, 0.99) << " ms, max " << *std::max_element(ms.begin(), ms.end())
+                  << " ms\n";
+    }
+}
+
+/**
+ * @brief Emits a finished frame's record once its GPU queries have completed. Returns false, leaving
+ * the slot pending, while any is still in flight; with `force` (the slot is about to be reused) it
+ * writes the record anyway, with blank GPU times for the queries that are not ready.
+ */
+static bool resolveProfileSlot(int slot, bool force)
+{
+    if (!profiler.slot_pending[slot])
+        return true;
+    GLuint available[PROFILE_SECTION_COUNT];
+    for (int i = 0; i < PROFILE_SECTION_COUNT; i++)
+    {
+        available[i] = GL_FALSE;
+        if (profiler.query_issued[slot][i])
+            glGetQueryObjectuiv(profiler.queries[slot][i], GL_QUERY_RESULT_AVAILABLE, &available[i]);
+        if (profiler.query_issued[slot][i] && !available[i] && !force)
+            return false;
+    }
+    double gpu_us[PROFILE_SECTION_COUNT];
+    for (int i = 0; i < PROFILE_SECTION_COUNT; i++)
+    {
+        gpu_us[i] = -1.0;
+        if (!profiler.query_issued[slot][i])
+            continue;
+        profiler.query_issued[slot][i] = false;
+        if (!available[i])
+            continue; // Dropped rather than waited for; the query object is simply reissued
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(profiler.queries[slot][i], GL_QUERY_RESULT, &ns);
+        gpu_us[i] = ns / 1000.0;
+        profiler.avg_gpu_us[i] += 0.05 * (gpu_us[i] - profiler.avg_gpu_us[i]);
+    }
+    if (profiler.csv)
+    {
+        std::fprintf(profiler.csv, "%llu", (unsigned long long)profiler.slot_frame[slot]);
+        for (int i = 0; i <= PROFILE_SECTION_COUNT; i++)
+            std::fprintf(profiler.csv, ",%.1f", profiler.slot_cpu_us[slot][i]);
+        for (int i = 0; i < PROFILE_SECTION_COUNT; i++)
+        {
+            if (gpu_us[i] >= 0.0)
+                std::fprintf(profiler.csv, ",%.1f", gpu_us[i]);
+            else
+                std::fprintf(profiler.csv, ",");
+        }
+        std::fprintf(profiler.csv, ",%d,%.1f,%.1f", profiler.slot_ticks[slot], profiler.slot_max_jitter_us[slot],
+                     profiler.slot_net_us[slot]);
+        if (renderQueue.active)
+            std::fprintf(profiler.csv, ",%d,%d\n", profiler.slot_draw_calls[slot], profiler.slot_state_changes[slot]);
+        else
+            std::fprintf(profiler.csv, ",,\n"); // The fixed-function path draws without counting
+        std::fflush(profiler.csv);
+    }
+    profiler.slot_pending[slot] = false;
+    return true;
+}
+
+/**
+ * @brief Closes the current frame's record and writes out, oldest first, every earlier frame whose
+ * GPU times have arrived.
+ */
+static void profileFrameEnd()
+{
+    if (!profiler.enabled)
+        return;
+    int slot = (int)(profiler.frame % PROFILE_QUERY_LATENCY);
+    profiler.frame_cpu_us = elapsedUs(profiler.frame_start);
+    for (int i = 0; i < PROFILE_SECTION_COUNT; i++)
+    {
+        profiler.slot_cpu_us[slot][i] = profiler.cpu_us[i];
+        profiler.avg_cpu_us[i] += 0.05 * (profiler.cpu_us[i] - profiler.avg_cpu_us[i]);
+    }
+    profiler.slot_cpu_us[slot][PROFILE_SECTION_COUNT] = profiler.frame_cpu_us;
+    profiler.avg_cpu_us[PROFILE_SECTION_COUNT] += 0.05 * (profiler.frame_cpu_us - profiler.avg_cpu_us[PROFILE_SECTION_COUNT]);
+    profiler.slot_ticks[slot] = profiler.frame_ticks;
+    profiler.slot_max_jitter_us[slot] = profiler.frame_max_jitter_us;
+    profiler.slot_net_us[slot] = profiler.frame_net_us;
+    profiler.slot_draw_calls[slot] = renderQueue.frame.draw_calls;
+    profiler.slot_state_changes[slot] = renderQueue.frame.state_changes;
+    profiler.avg_net_us += 0.05 * (profiler.frame_net_us - profiler.avg_net_us);
+    profiler.frame_net_us = 0.0;
+    profiler.slot_frame[slot] = profiler.frame;
+    profiler.slot_pending[slot] = true;
+    profiler.frame_ticks = 0;
+    profiler.frame_max_jitter_us = 0.0;
+    profiler.frame++;
+    // The next frame reuses the oldest slot, so that one is written now even if the GPU is behind
+    for (uint64_t f = profiler.frame - std::min<uint64_t>(profiler.frame, PROFILE_QUERY_LATENCY); f < profiler.frame; f++)
+        if (!resolveProfileSlot((int)(f % PROFILE_QUERY_LATENCY), f + PROFILE_QUERY_LATENCY == profiler.frame))
+            break;
+}
+
+/**
+ * @brief Queues the profiler overlay (running averages and tick-jitter histogram) as HUD text.
+ */
+void drawProfilerOverlay()
+{
+    if (!profiler.enabled || !profiler.overlay)
+        return;
+    char line[128];
+    float y = window_height - 90.0f;
+    for (int i = 0; i < PROFILE_SECTION_COUNT; i++, y -= 20.0f)
+    {
+        if (profiler.gpu_timers)
+            std::snprintf(line, sizeof(line), "%-8s cpu %6.3f ms  gpu %6.3f ms", PROFILE_SECTION_NAMES[i],
+                          profiler.avg_cpu_us[i] / 1000.0, profiler.avg_gpu_us[i] / 1000.0);
+        else
+            std::snprintf(line, sizeof(line), "%-8s cpu %6.3f ms", PROFILE_SECTION_NAMES[i],
+                          profiler.avg_cpu_us[i] / 1000.0);
+        queueText(20, y, line, GLUT_BITMAP_HELVETICA_18);
+    }
+    std::snprintf(line, sizeof(line), "frame cpu %6.3f ms", profiler.avg_cpu_us[PROFILE_SECTION_COUNT] / 1000.0);
+    queueText(20, y, line, GLUT_BITMAP_HELVETICA_18);
+    y -= 20.0f;
+    std::snprintf(line, sizeof(line), "net sim   %6.3f ms of %.1f (%d passes)", profiler.avg_net_us / 1000.0,
+                  NET_FRAME_BUDGET_US / 1000.0, netCloth.iterations);
+    queueText(20, y, line, GLUT_BITMAP_HELVETICA_18);
+    y -= 20.0f;
+    const RenderStats &stats = renderQueue.last_frame;
+    if (renderQueue.active)
+        std::snprintf(line, sizeof(line), "queue %d commands, %d draws, %d state changes", stats.commands,
+                      stats.draw_calls, stats.state_changes);
+    else
+        std::snprintf(line, sizeof(line), "fixed-function path");
+    queueText(20, y, line, GLUT_BITMAP_HELVETICA_18);
+    y -= 20.0f;
+    if (inputLatency.measure)
+    {
+        const std::vector<double> &dives = inputLatency.samples_ms[LATENCY_DIVE];
+        std::snprintf(line, sizeof(line), "dive key to present p50 %5.1f ms  p99 %5.1f ms (%d)", percentile(dives, 0.5),
+                      percentile(dives, 0.99), (int)dives.size());
+        queueText(20, y, line, GLUT_BITMAP_HELVETICA_18);
+        y -= 20.0f;
+    }
+    std::snprintf(line, sizeof(line), "step lateness (%d steps, 1 ms buckets):", profiler.jitter_count);
+    queueText(20, y, line, GLUT_BITMAP_HELVETICA_18);
+    for (int b = 0; b < JITTER_BUCKETS; b++)
+    {
+        y -= 20.0f;
+        int bar = profiler.jitter_count ? (20 * profiler.jitter_histogram[b] + profiler.jitter_count - 1) / profiler.jitter_count : 0;
+        std::snprintf(line, sizeof(line), "%s%d ms %5d %s", b == JITTER_BUCKETS - 1 ? ">=" : "  ", b,
+                      profiler.jitter_histogram[b], std::string(bar, '|').c_str());
+        queueText(20, y, line, GLUT_BITMAP_HELVETICA_18);
+    }
+}
+
+/**
+ * @brief Queues the shot history screen (F2) down the right of the window. Its text is rebuilt
+ * only after a kick has been logged.
+ */
+static void drawHistoryScreen()
+{
+    if (!historyScreen.shown)
+        return;
+    if (historyScreen.stale)
+    {
+        if (shotHistory.base)
+            historyScreen.lines = historyReport(shotHistory, HISTORY_SCREEN_SHOTS, match.grid, SOURCE_PLAYED);
+        else
+            historyScreen.lines.assign(1, "No shot history is being kept");
+        historyScreen.stale = false;
+    }
+    float y = window_height - 90.0f;
+    for (size_t i = 0; i < historyScreen.lines.size(); i++, y -= 20.0f)
+        queueText(window_width - 400.0f, y, historyScreen.lines[i].c_str(), GLUT_BITMAP_HELVETICA_18);
+}
+
+/**
+ * @brief Special-key callback: F2 toggles the shot history screen and F3 the profiler overlay.
+ */
+void handleSpecialInput(int key, int x, int y)
+{
+    (void)x;
+    (void)y;
+    if (key == GLUT_KEY_F2)
+    {
+        historyScreen.shown = !historyScreen.shown;
+        historyScreen.stale = true;
+        requestRedraw(REDRAW_HUD);
+        return;
+    }
+    if (key != GLUT_KEY_F3)
+        return;
+    initProfiler(false, NULL);
+    profiler.overlay = !profiler.overlay;
+    requestRedraw(REDRAW_HUD);
+}
+
+/**
+ * @brief Schedules a repaint; several requests before the next frame collapse into one.
+ */
+void requestRedraw(unsigned flags)
+{
+    if (flags == 0)
+        return;
+    if (pending_redraw == 0 && !offscreen_mode)
+        glutPostRedisplay();
+    pending_redraw |= flags;
+}
+
+inline bool isStaticState(GameState state)
+{
+    return state != SHOT_IN_PROGRESS;
+}
+
+/**
+ * @brief The repaint a change from `before` to `after` needs. The world is redrawn only when
+ * something it shows moved, swapped kits or appeared; a new score, round or prompt in a static
+ * state is drawn over the cached scene.
+ */
+unsigned redrawForChange(const Match &before, const Match &after)
+{
+    if (!isStaticState(after.state) || !isStaticState(before.state) ||
+        (before.state == INTRO) != (after.state == INTRO) || before.is_player_turn != after.is_player_turn ||
+        before.ball_x != after.ball_x || before.ball_y != after.ball_y || before.ball_z != after.ball_z ||
+        before.gk_x != after.gk_x || before.gk_y != after.gk_y)
+        return REDRAW_SCENE;
+    return REDRAW_HUD;
+}
+
+/**
+ * @brief Sets the swap interval: 1 paces animation frames by the display, 0 presents as soon as a
+ * frame is ready (lower input latency, may tear).
+ */
+void setSwapInterval(int interval)
+{
+#ifdef __APPLE__
+    GLint cgl_interval = interval;
+    CGLSetParameter(CGLGetCurrentContext(), kCGLCPSwapInterval, &cgl_interval);
+#elif defined(_WIN32)
+    PFNWGLSWAPINTERVALEXTPROC swap_interval = (PFNWGLSWAPINTERVALEXTPROC)wglGetProcAddress("wglSwapIntervalEXT");
+    if (swap_interval)
+        swap_interval(interval);
+#else
+    typedef void (*SwapIntervalEXT)(Display *, GLXDrawable, int);
+    typedef int (*SwapIntervalMESA)(unsigned int);
+    SwapIntervalEXT swap_ext = (SwapIntervalEXT)glXGetProcAddress((const GLubyte *)"glXSwapIntervalEXT");
+    SwapIntervalMESA swap_mesa = (SwapIntervalMESA)glXGetProcAddress((const GLubyte *)"glXSwapIntervalMESA");
+    if (swap_ext && hasGLXExtension("GLX_EXT_swap_control"))
+        swap_ext(glXGetCurrentDisplay(), glXGetCurrentDrawable(), interval);
+    else if (swap_mesa)
+        swap_mesa((unsigned int)interval);
+#endif
+}
+
+/**
+ * @brief Copies the freshly drawn 3D frame (before the HUD) into sceneCacheTexture.
+ */
+static void captureSceneCache()
+{
+    if (!sceneCacheTexture)
+        glGenTextures(1, &sceneCacheTexture);
+    glBindTexture(GL_TEXTURE_2D, sceneCacheTexture);
+    if (scene_cache_width != window_width || scene_cache_height != window_height)
+    {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, window_width, window_height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+        scene_cache_width = window_width;
+        scene_cache_height = window_height;
+    }
+    glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, window_width, window_height);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    scene_cache_valid = true;
+}
+
+/**
+ * @brief Repaints the cached 3D frame as one screen-sized textured quad.
+ */
+static void drawSceneCache()
+{
+    if (renderQueue.active)
+    {
+        DrawRange triangle = {0, 3};
+        queueDraw(PIPELINE_BLIT, MESH_BLIT, sceneCacheTexture, GL_TRIANGLES, triangle, 0.0f, 1.0f, 1.0f, 1.0f);
+        submitRenderQueue();
+        return;
+    }
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_LIGHTING);
+    glEnable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, sceneCacheTexture);
+    glColor3f(1.0f, 1.0f, 1.0f);
+    glBegin(GL_QUADS);
+    glTexCoord2f(0.0f, 0.0f);
+    glVertex2f(-1.0f, -1.0f);
+    glTexCoord2f(1.0f, 0.0f);
+    glVertex2f(1.0f, -1.0f);
+    glTexCoord2f(1.0f, 1.0f);
+    glVertex2f(1.0f, 1.0f);
+    glTexCoord2f(0.0f, 1.0f);
+    glVertex2f(-1.0f, 1.0f);
+    glEnd();
+    glDisable(GL_TEXTURE_2D);
+    glEnable(GL_LIGHTING);
+    glEnable(GL_DEPTH_TEST);
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPopMatrix();
+}
+
+/**
+ * @brief Draws the 3D world: pitch, goal, ball and players. On the shader path the sections only
+ * queue commands, and the whole world is sorted and drawn at once under the "submit" section.
+ */
+void drawWorld()
+{
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    if (!renderQueue.active)
+    {
+        glLoadIdentity();
+        gluLookAt(
+            0.0f, CAMERA_EYE_Y, CAMERA_EYE_Z,
+            0.0f, CAMERA_TARGET_Y, CAMERA_TARGET_Z,
+            0.0f, 1.0f, 0.0f);
+    }
+
+    profileBegin(PROFILE_SCENE);
+    drawScene();
+    profileEnd(PROFILE_SCENE);
+
+    float a = render_alpha;
+    float draw_ball_x = match.prev_ball_x + (match.ball_x - match.prev_ball_x) * a;
+    float draw_ball_y = match.prev_ball_y + (match.ball_y - match.prev_ball_y) * a;
+    float draw_ball_z = match.prev_ball_z + (match.ball_z - match.prev_ball_z) * a;
+    float draw_gk_x = match.prev_gk_x + (match.gk_x - match.prev_gk_x) * a;
+    float draw_gk_y = GROUND_Y + match.prev_gk_y + (match.gk_y - match.prev_gk_y) * a; // Jumps for a high zone
+
+    profileBegin(PROFILE_BALL);
+    drawBall(draw_ball_x, draw_ball_y, draw_ball_z);
+    profileEnd(PROFILE_BALL);
+
+    if (match.state != INTRO)
+    {
+        if (match.is_player_turn)
+        {
+            queuePlayerFigure(GK_CENTER_X, GROUND_Y, KICKER_POS_Z, 0.0f, 0.0f, 1.0f); // Player Kicker
+            queuePlayerFigure(draw_gk_x, draw_gk_y, GOAL_LINE_Z, 1.0f, 0.0f, 0.0f);   // AI GK
+        }
+        else
+        {
+            queuePlayerFigure(GK_CENTER_X, GROUND_Y, KICKER_POS_Z, 1.0f, 0.0f, 0.0f); // AI Kicker
+            queuePlayerFigure(draw_gk_x, draw_gk_y, GOAL_LINE_Z, 0.0f, 0.0f, 1.0f);   // Player GK
+        }
+        profileBegin(PROFILE_PLAYERS);
+        drawPlayerFigures();
+        profileEnd(PROFILE_PLAYERS);
+    }
+
+    if (renderQueue.active)
+    {
+        profileBegin(PROFILE_SUBMIT);
+        submitRenderQueue();
+        profileEnd(PROFILE_SUBMIT);
+    }
+}
+
+/**
+ * @brief Late latching: runs the fixed steps that fell due since the shot timer last ran, so the
+ * frame shows the shot as of now rather than as of the timer's last pass. Window play only; replays
+ * and netplay keep their own clocks.
+ */
+static void latchSimulation()
+{
+    if (!inputLatency.late_latch || offscreen_mode || replay_playing || netplay_side >= 0 || simThread.running)
+        return;
+    if (match.state != SHOT_IN_PROGRESS && !netClothActive(netCloth, match))
+        return;
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(now - loop_last_time).count();
+    loop_last_time = now;
+    advanceSimulation(std::min(elapsed, MAX_FRAME_SECONDS));
+}
+
+/**
+ * @brief Display callback. Re-renders the world only when it changed or the cache is stale.
+ */
+void renderScene()
+{
+    latchSimulation();
+    latchSimSnapshot();
+    profileFrameBegin();
+    renderQueue.frame = RenderStats();
+    bool full_redraw = (pending_redraw & REDRAW_SCENE) || !scene_cache_valid;
+    pending_redraw = 0;
+    if (full_redraw)
+    {
+        drawWorld();
+        if (isStaticState(match.state) && !netCloth.awake)
+            captureSceneCache();
+        else
+            scene_cache_valid = false;
+    }
+    else
+    {
+        glClear(GL_DEPTH_BUFFER_BIT);
+        drawSceneCache();
+    }
+
+    profileBegin(PROFILE_UI);
+    drawUI();
+    profileEnd(PROFILE_UI);
+    if (render_delay_ms > 0.0)
+        std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(render_delay_ms));
+    profileFrameEnd();
+    renderQueue.last_frame = renderQueue.frame;
+
+    if (!offscreen_mode)
+        glutSwapBuffers();
+    recordInputPresented();
+}
+
+/**
+ * @brief Applies one key to `m`'s state machine. A zone key leaves the kick pending
+ * (SHOT_IN_PROGRESS with animation_steps 0) for the next startAnimation() batch.
+ * Returns true if the key changed the state.
+ */
+bool applyMatchKey(Match &m, unsigned char key)
+{
+    GameState previous_state = m.state;
+    switch (m.state)
+    {
+    case INTRO:
+        if (key == ' ')
+            m.state = WAITING_FOR_SHOT;
+        break;
+    case WAITING_FOR_SHOT:
+    case WAITING_FOR_DIVE:
+    {
+        Zone zone = matchGrid(m).key_zone[key];
+        if (zone == NO_ZONE)
+            break;
+        (m.state == WAITING_FOR_SHOT ? m.player_shot_choice : m.player_dive_choice) = zone;
+        m.state = SHOT_IN_PROGRESS;
+        break;
+    }
+    case SHOT_IN_PROGRESS:
+        break; // Input ignored during animation
+    case DISPLAY_RESULT:
+        if (key == ' ')
+            advanceRound(&m, 1);
+        break; // advanceRound changes state
+    case GAME_OVER:
+        if (key == ' ' || key == 13)
+        {
+            resetMatch(m);
+            m.state = WAITING_FOR_SHOT;
+        }
+        break;
+    }
+    return m.state != previous_state;
+}
+
+/**
+ * @brief applyMatchKey() for a match between two humans. While a kick is being chosen, `side`
+ * (0 player, 1 AI) picks its own shot or dive and the kick starts once both have; a choice is
+ * final once made. Otherwise either side's key drives the match as usual.
+ */
+bool applyVersusKey(Match &m, int side, unsigned char key)
+{
+    if (m.state != WAITING_FOR_SHOT && m.state != WAITING_FOR_DIVE)
+        return applyMatchKey(m, key);
+    Zone choice = matchGrid(m).key_zone[key];
+    unsigned char bit = (unsigned char)(1 << side);
+    if (choice == NO_ZONE || (m.versus_ready & bit))
+        return false;
+    bool player_kicks = m.state == WAITING_FOR_SHOT;
+    if (side == 0)
+        (player_kicks ? m.player_shot_choice : m.player_dive_choice) = choice;
+    else
+        (player_kicks ? m.ai_dive_choice : m.ai_shot_choice) = choice;
+    m.versus_ready |= bit;
+    if (m.versus_ready == 3)
+    {
+        m.versus_ready = 0;
+        m.state = SHOT_IN_PROGRESS;
+    }
+    return true;
+}
+
+/**
+ * @brief Handles keyboard input for the window's match and related game state changes.
+ */
+void handleInput(unsigned char key, int x, int y)
+{
+    (void)x;
+    (void)y;
+    ProfileClock::time_point arrival = ProfileClock::now();
+    key = tolower(key);
+    if (simThread.running)
+    {
+        postSimKey(key, arrival); // The simulation thread owns the match
+        if (!offscreen_mode)
+            glutIdleFunc(simThreadIdle); // Until the snapshots this key leads to have been drawn
+        return;
+    }
+    LatencyKind kind = latencyKind(match, 0);
+    Match before = match;
+    if (!applyMatchKey(match, key))
+        return; // Ignored keys cost nothing
+    noteInputApplied(arrival, kind);
+    if (match.state == SHOT_IN_PROGRESS)
+        startShot();
+    else if (netClothActive(netCloth, match) && !netCloth.awake)
+        startSimulationClock(); // The ball left the net it was resting in; let the net spring back
+    recordReplayKey(key);
+    if (match.state == GAME_OVER)
+        recordReplayResult(match);
+    unsigned redraw = redrawForChange(before, match);
+    if (inputLatency.low_latency && !offscreen_mode && !replay_playing)
+    {
+        pending_redraw |= redraw;
+        renderScene(); // Present now instead of on the GLUT loop's next pass
+    }
+    else
+        requestRedraw(redraw);
+}
+
+/**
+ * @brief Queues one player figure for drawPlayerFigures(); no GL calls are made here.
+ */
+void queuePlayerFigure(float x, float y_base, float z, float r, float g, float b)
+{
+    PlayerInstance instance = {{1.0f, 0.0f, 0.0f, x, 0.0f, 1.0f, 0.0f, y_base, 0.0f, 0.0f, 1.0f, z}, {r, g, b}};
+    playerInstances.push_back(instance);
+}
+
+/**
+ * @brief Draws every queued figure with one instanced call (a single render command on the shader
+ * path), or per-instance draws of the cached mesh when the context lacks instancing. Clears the queue.
+ */
+void drawPlayerFigures()
+{
+    if (playerInstances.empty())
+        return;
+    if (renderQueue.active)
+    {
+        float distance = CAMERA_FAR;
+        for (size_t i = 0; i < playerInstances.size(); i++)
+        {
+            const float *m = playerInstances[i].transform;
+            distance = std::min(distance, cameraDistance(m[3], m[7], m[11]));
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, playerInstanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, playerInstances.size() * sizeof(PlayerInstance), &playerInstances[0],
+                     GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        DrawRange mesh = {0, playerMeshCount};
+        queueDraw(PIPELINE_FIGURES, MESH_FIGURES, 0, GL_TRIANGLES, mesh, distance, 1.0f, 1.0f, 1.0f).instances =
+            (GLsizei)playerInstances.size();
+        playerInstances.clear();
+        return;
+    }
+    const GLsizei stride = STATIC_VERTEX_FLOATS * sizeof(float);
+    glBindBuffer(GL_ARRAY_BUFFER, playerMeshVBO);
+    if (playerInstancingSupported)
+    {
+        glUseProgram(playerProgram);
+        glEnableVertexAttribArray(PLAYER_ATTRIB_POSITION);
+        glEnableVertexAttribArray(PLAYER_ATTRIB_NORMAL);
+        glEnableVertexAttribArray(PLAYER_ATTRIB_SLOT);
+        glVertexAttribPointer(PLAYER_ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, stride, (const GLvoid *)0);
+        glVertexAttribPointer(PLAYER_ATTRIB_NORMAL, 3, GL_FLOAT, GL_FALSE, stride, (const GLvoid *)(3 * sizeof(float)));
+        glVertexAttribPointer(PLAYER_ATTRIB_SLOT, 1, GL_FLOAT, GL_FALSE, stride, (const GLvoid *)(6 * sizeof(float)));
+
+        // Orphan and refill the instance buffer each frame.
+        glBindBuffer(GL_ARRAY_BUFFER, playerInstanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, playerInstances.size() * sizeof(PlayerInstance), &playerInstances[0],
+                     GL_STREAM_DRAW);
+        const GLsizei instance_stride = sizeof(PlayerInstance);
+        for (int i = PLAYER_ATTRIB_ROW0; i <= PLAYER_ATTRIB_COLOR; i++)
+        {
+            int size = i == PLAYER_ATTRIB_COLOR ? 3 : 4;
+            size_t offset = (size_t)(i - PLAYER_ATTRIB_ROW0) * 4 * sizeof(float);
+            glEnableVertexAttribArray(i);
+            glVertexAttribPointer(i, size, GL_FLOAT, GL_FALSE, instance_stride, (const GLvoid *)offset);
+            glVertexAttribDivisorARB(i, 1);
+        }
+        glDrawArraysInstancedARB(GL_TRIANGLES, 0, playerMeshCount, (GLsizei)playerInstances.size());
+        for (int i = 0; i < PLAYER_ATTRIB_COUNT; i++)
+        {
+            if (i >= PLAYER_ATTRIB_ROW0)
+                glVertexAttribDivisorARB(i, 0);
+            glDisableVertexAttribArray(i);
+        }
+        glUseProgram(0);
+    }
+    else
+    {
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_NORMAL_ARRAY);
+        glVertexPointer(3, GL_FLOAT, stride, (const GLvoid *)0);
+        glNormalPointer(GL_FLOAT, stride, (const GLvoid *)(3 * sizeof(float)));
+        for (size_t i = 0; i < playerInstances.size(); i++)
+        {
+            const PlayerInstance &p = playerInstances[i];
+            const float *m = p.transform;
+            GLfloat matrix[16] = {m[0], m[4], m[8], 0.0f, m[1], m[5], m[9], 0.0f,
+                                  m[2], m[6], m[10], 0.0f, m[3], m[7], m[11], 1.0f};
+            glPushMatrix();
+            glMultMatrixf(matrix);
+            glColor3f(p.color[0], p.color[1], p.color[2]);
+            glDrawArrays(GL_TRIANGLES, playerSlotRanges[SLOT_KIT].first, playerSlotRanges[SLOT_KIT].count);
+            glColor3f(0.9f, 0.7f, 0.6f);
+            glDrawArrays(GL_TRIANGLES, playerSlotRanges[SLOT_SKIN].first, playerSlotRanges[SLOT_SKIN].count);
+            glColor3f(p.color[0] * 0.5f, p.color[1] * 0.5f, p.color[2] * 0.5f);
+            glDrawArrays(GL_TRIANGLES, playerSlotRanges[SLOT_SHORTS].first, playerSlotRanges[SLOT_SHORTS].count);
+            glPopMatrix();
+        }
+        glDisableClientState(GL_NORMAL_ARRAY);
+        glDisableClientState(GL_VERTEX_ARRAY);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    playerInstances.clear();
+}
+/**
+ * @brief Starts every pending kick in the batch: the AI picks its zone from the opponent model
+ * (before it learns the human's choice for this kick), sends the keeper towards the dive and
+ * strikes the ball.
+ */
+void startAnimation(Match *matches, size_t count)
+{
+    static std::vector<Match *> kicks; // Scratch reused across calls; callers are single-threaded
+    static std::vector<KickAim> aims;
+    kicks.clear();
+    aims.clear();
+    for (size_t i = 0; i < count; i++)
+    {
+        Match &m = matches[i];
+        if (m.state != SHOT_IN_PROGRESS || m.animation_steps != 0)
+            continue;
+        m.animation_steps = 1;
+        const TargetGrid &grid = matchGrid(m);
+        Zone shot, dive;
+        if (m.is_player_turn)
+        {
+            if (!m.versus)
+            {
+                m.ai_dive_choice = chooseDive(aiModel(m), grid, m.rng);
+                observeShot(aiModel(m), grid, m.player_shot_choice);
+            }
+            shot = m.player_shot_choice;
+            dive = m.ai_dive_choice;
+        }
+        else
+        {
+            if (!m.versus)
+            {
+                m.ai_shot_choice = chooseShot(aiModel(m), grid, m.rng);
+                observeDive(aiModel(m), grid, m.player_dive_choice);
+            }
+            shot = m.ai_shot_choice;
+            dive = m.player_dive_choice;
+        }
+        m.target_gk_x = grid.zone_x[dive];
+        m.target_gk_y = grid.reach_low[dive];
+        m.prev_ball_x = m.ball_x;
+        m.prev_ball_y = m.ball_y;
+        m.prev_ball_z = m.ball_z;
+        m.start_gk_x = m.prev_gk_x = m.gk_x;
+        m.start_gk_y = m.prev_gk_y = m.gk_y;
+        m.shot_outcome = SHOT_PENDING;
+        m.hit_woodwork = false;
+        kicks.push_back(&m);
+        aims.push_back(drawKick(m, shot));
+    }
+    if (!kicks.empty())
+        aimKicks(&kicks[0], &aims[0], kicks.size());
+}
+
+/**
+ * @brief Milliseconds until the next fixed step falls due, so the shot timer sleeps between steps
+ * instead of spinning a core; vsync still paces the frames the steps request.
+ */
+static unsigned nextStepDelayMs()
+{
+    return (unsigned)std::max(1.0, std::ceil((SIM_STEP_SECONDS - sim_accumulator) * 1000.0));
+}
+
+/**
+ * @brief Starts the real clock that runs fixed steps while a shot flies or the net settles.
+ */
+static void startSimulationClock()
+{
+    sim_accumulator = 0.0;
+    loop_last_time = shot_start_time = std::chrono::steady_clock::now();
+    if (!offscreen_mode && !replay_playing && !sim_timer_armed)
+    {
+        sim_timer_armed = true; // Re-armed by gameLoop() until the shot is resolved and the net is still
+        glutTimerFunc(nextStepDelayMs(), gameLoop, 0);
+    }
+}
+
+/**
+ * @brief Starts the window's pending kick and the real clock that animates it.
+ */
+void startShot()
+{
+    startAnimation(&match, 1);
+    render_alpha = 0.0f;
+    startSimulationClock();
+    if (replay_playing ? replay_low_latency : inputLatency.low_latency)
+        advanceSimulation(SIM_STEP_SECONDS); // The key's first frame already shows the dive and the strike
+}
+
+/**
+ * @brief Prompt for a shot or dive. The classic grid names its three sides; a bigger grid is shown
+ * as its keys laid out like the goal, one line per row, top row highest.
+ */
+static void queueZonePrompt(const char *verb, float center_x, float bottom_y)
+{
+    const TargetGrid &grid = matchGrid(match);
+    char line[96];
+    if (grid.rows == 1)
+    {
+        std::snprintf(line, sizeof(line), "%s Directly: [L] Left, [M] Middle, [R] Right", verb);
+        queueText(center_x - 180, bottom_y, line, GLUT_BITMAP_HELVETICA_18);
+        return;
+    }
+    float y = bottom_y + 22.0f * grid.rows;
+    std::snprintf(line, sizeof(line), "%s at a zone:", verb);
+    queueText(center_x - 60, y, line, GLUT_BITMAP_HELVETICA_18);
+    for (int row = 0; row < grid.rows; row++)
+    {
+        int n = 0;
+        for (int column = 0; column < grid.columns; column++)
+            n += std::snprintf(line + n, sizeof(line) - n, "%s[%c]", column ? "  " : "",
+                               toupper(grid.keys[row * grid.columns + column]));
+        queueText(center_x - 18.0f * grid.columns, y - 22.0f * (row + 1), line, GLUT_BITMAP_HELVETICA_18);
+    }
+}
+
+/**
+ * @brief Online prompt for a kick: who is kicking, and whether this side still has to choose.
+ */
+static void queueVersusPrompt(float center_x, float bottom_y)
+{
+    bool host_kicks = match.state == WAITING_FOR_SHOT;
+    queueText(center_x - 50, window_height - 60, host_kicks ? "HOST KICKS" : "GUEST KICKS", GLUT_BITMAP_HELVETICA_18);
+    if (match.versus_ready & (1 << netplay_side))
+        queueText(center_x - 110, bottom_y, "Waiting for your opponent...", GLUT_BITMAP_HELVETICA_18);
+    else
+        queueZonePrompt(host_kicks == (netplay_side == 0) ? "Shoot" : "Dive", center_x, bottom_y);
+}
+
+/**
+ * @brief Queues the scoreboard and UI text, then draws it as one batch.
+ */
+void drawUI()
+{
+    if (match.state != INTRO)
+    {
+        refreshHudText();
+        queueText(20, window_height - 30, hudText.round_text.c_str(), GLUT_BITMAP_HELVETICA_18);
+        queueText(window_width - 180, window_height - 30, hudText.score_text.c_str(), GLUT_BITMAP_HELVETICA_18);
+    }
+    float center_x = window_width / 2.0f;
+    float bottom_y = 50;
+    switch (match.state)
+    {
+    case INTRO:
+        queueText(center_x - 100, center_x - 50, "PENALTY SHOOTOUT 3D", GLUT_BITMAP_TIMES_ROMAN_24);
+        queueText(center_x - 110, center_x - 80, "Press SPACE to Start", GLUT_BITMAP_HELVETICA_18);
+        break;
+    case WAITING_FOR_SHOT:
+        if (match.versus)
+        {
+            queueVersusPrompt(center_x, bottom_y);
+            break;
+        }
+        queueText(center_x - 50, window_height - 60, "PLAYER KICKS", GLUT_BITMAP_HELVETICA_18);
+        queueZonePrompt("Shoot", center_x, bottom_y);
+        break;
+    case WAITING_FOR_DIVE:
+        if (match.versus)
+        {
+            queueVersusPrompt(center_x, bottom_y);
+            break;
+        }
+        queueText(center_x - 30, window_height - 60, "AI KICKS", GLUT_BITMAP_HELVETICA_18);
+        queueZonePrompt("Dive", center_x, bottom_y);
+        break;
+    case SHOT_IN_PROGRESS:
+        queueText(center_x - 10, bottom_y, "...", GLUT_BITMAP_HELVETICA_18);
+        break;
+    case DISPLAY_RESULT:
+        if (match.shot_outcome == SHOT_GOAL)
+            queueText(center_x - 30, center_x, "GOAL!", GLUT_BITMAP_TIMES_ROMAN_24);
+        else if (match.shot_outcome == SHOT_SAVED)
+            queueText(center_x - 30, center_x, "SAVED!", GLUT_BITMAP_TIMES_ROMAN_24);
+        else if (match.shot_outcome == SHOT_WOODWORK)
+            queueText(center_x - 60, center_x, "OFF THE POST!", GLUT_BITMAP_TIMES_ROMAN_24);
+        else
+            queueText(center_x - 30, center_x, "WIDE!", GLUT_BITMAP_TIMES_ROMAN_24);
+        queueText(center_x - 100, bottom_y, "Press SPACE to continue", GLUT_BITMAP_HELVETICA_18);
+        break;
+    case GAME_OVER:
+    {
+        queueText(center_x - 70, center_x + 50, "--- GAME OVER ---", GLUT_BITMAP_TIMES_ROMAN_24);
+        refreshHudText();
+        queueText(center_x - 120, center_x + 20, hudText.final_text.c_str(), GLUT_BITMAP_HELVETICA_18);
+        int own_goals = netplay_side == 1 ? match.ai_goals : match.player_goals;
+        int other_goals = netplay_side == 1 ? match.player_goals : match.ai_goals;
+        if (own_goals > other_goals)
+            queueText(center_x - 120, center_x - 10, "WORLD CLASS PERFORMANCE!", GLUT_BITMAP_HELVETICA_18);
+        else if (other_goals > own_goals)
+            queueText(center_x - 70, center_x - 10, "NEEDS PRACTICE!", GLUT_BITMAP_HELVETICA_18);
+        else
+            queueText(center_x - 70, center_x - 10, "A TIE!", GLUT_BITMAP_HELVETICA_18);
+        queueText(center_x - 140, bottom_y, "Press SPACE or ENTER to play again", GLUT_BITMAP_HELVETICA_18);
+        break;
+    }
+    }
+    drawHistoryScreen();
+    drawProfilerOverlay();
+    flushText();
+}
+
+/**
+ * @brief Moves every match showing a result on to its next kick, or to GAME_OVER once decided.
+ */
+void advanceRound(Match *matches, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        Match &m = matches[i];
+        if (m.state != DISPLAY_RESULT)
+            continue;
+        m.ball_x = GK_CENTER_X;
+        m.ball_y = BALL_Y;
+        m.ball_z = PENALTY_SPOT_Z;
+        m.ball_vx = m.ball_vy = m.ball_vz = 0.0f;
+        m.gk_x = GK_CENTER_X;
+        m.gk_y = 0.0f;
+        m.animation_steps = 0;
+        m.player_dive_choice = NO_ZONE;
+        if (m.is_player_turn)
+        {
+            m.is_player_turn = false;
+            m.state = WAITING_FOR_DIVE;
+        }
+        else
+        {
+            m.is_player_turn = true;
+            if (isShootoutDecided(m.current_round, m.player_goals, m.ai_goals))
+                m.state = GAME_OVER;
+            else
+            {
+                m.current_round++;
+                m.state = WAITING_FOR_SHOT;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Resets a match to the intro screen. Its RNG keeps running, so back-to-back matches differ.
+ */
+void resetMatch(Match &m)
+{
+    m.player_goals = 0;
+    m.ai_goals = 0;
+    m.current_round = 1;
+    m.is_player_turn = true;
+    m.last_shot_was_goal = false;
+    m.state = INTRO;
+    m.versus_ready = 0;
+    m.player_dive_choice = NO_ZONE;
+    m.player_shot_choice = MIDDLE;
+    m.ai_shot_choice = m.ai_dive_choice = MIDDLE;
+    m.shot_outcome = SHOT_PENDING;
+    m.hit_woodwork = false;
+    m.ball_x = m.prev_ball_x = GK_CENTER_X;
+    m.ball_y = m.prev_ball_y = BALL_Y;
+    m.ball_z = m.prev_ball_z = PENALTY_SPOT_Z;
+    m.ball_vx = m.ball_vy = m.ball_vz = m.spin_x = m.spin_y = 0.0f;
+    m.gk_x = m.prev_gk_x = m.start_gk_x = m.target_gk_x = GK_CENTER_X;
+    m.gk_y = m.prev_gk_y = m.start_gk_y = m.target_gk_y = 0.0f;
+    m.animation_steps = 0;
+}
+
+/**
+ * @brief Decides a kick from the first conclusive BallEvent; a woodwork hit only counts once the
+ * ball is clearly out.
+ */
+static void resolveShot(Match &m, uint32_t events)
+{
+    m.hit_woodwork = m.hit_woodwork || (events & BALL_HIT_WOODWORK);
+    if (m.shot_outcome != SHOT_PENDING)
+        return;
+    if (events & BALL_HIT_KEEPER)
+        m.shot_outcome = SHOT_SAVED;
+    else if (events & BALL_CROSSED_GOAL)
+        m.shot_outcome = SHOT_GOAL;
+    else if (events & BALL_CROSSED_WIDE)
+        m.shot_outcome = m.hit_woodwork ? SHOT_WOODWORK : SHOT_WIDE;
+}
+
+/**
+ * @brief Advances every shot in flight by one fixed step of SIM_STEP_SECONDS and scores the ones
+ * that reach their last step.
+ *
+ * Balls in flight are gathered into one BallBatch so the physics runs four lanes at a time.
+ */
+void updateGameLogic(Match *matches, size_t count)
+{
+    static BallBatch flight; // Scratch reused across calls; callers are single-threaded
+    static std::vector<Match *> flying;
+    flying.clear();
+    for (size_t i = 0; i < count; i++)
+        if (matches[i].state == SHOT_IN_PROGRESS && matches[i].animation_steps != 0)
+            flying.push_back(&matches[i]);
+    if (flying.empty())
+        return;
+
+    flight.resize(flying.size());
+    for (size_t i = 0; i < flying.size(); i++)
+    {
+        Match &m = *flying[i];
+        m.prev_ball_x = m.ball_x;
+        m.prev_ball_y = m.ball_y;
+        m.prev_ball_z = m.ball_z;
+        m.prev_gk_x = m.gk_x;
+        m.prev_gk_y = m.gk_y;
+        float t_gk = (float)m.animation_steps / (float)TOTAL_ANIMATION_STEPS;
+        m.gk_x = (1.0f - t_gk) * m.start_gk_x + t_gk * m.target_gk_x;
+        m.gk_y = (1.0f - t_gk) * m.start_gk_y + t_gk * m.target_gk_y;
+        flight.px[i] = m.ball_x;
+        flight.py[i] = m.ball_y;
+        flight.pz[i] = m.ball_z;
+        flight.vx[i] = m.ball_vx;
+        flight.vy[i] = m.ball_vy;
+        flight.vz[i] = m.ball_vz;
+        flight.spin_x[i] = m.spin_x;
+        flight.spin_y[i] = m.spin_y;
+        flight.keeper_x[i] = m.gk_x;
+        flight.keeper_y[i] = m.gk_y;
+        flight.keeper_top[i] = m.gk_y + matchGrid(m).reach_height;
+        flight.events[i] = 0;
+    }
+    stepBalls(flight, (float)SIM_STEP_SECONDS, true);
+
+    for (size_t i = 0; i < flying.size(); i++)
+    {
+        Match &m = *flying[i];
+        m.ball_x = flight.px[i];
+        m.ball_y = flight.py[i];
+        m.ball_z = flight.pz[i];
+        m.ball_vx = flight.vx[i];
+        m.ball_vy = flight.vy[i];
+        m.ball_vz = flight.vz[i];
+        resolveShot(m, flight.events[i]);
+        if (m.animation_steps < TOTAL_ANIMATION_STEPS)
+        {
+            m.animation_steps++;
+            continue;
+        }
+        // The kick is shown for exactly ANIMATION_DURATION_MS, then scored
+        if (m.shot_outcome == SHOT_PENDING)
+            m.shot_outcome = m.hit_woodwork ? SHOT_WOODWORK : SHOT_WIDE;
+        m.state = DISPLAY_RESULT;
+        m.gk_x = m.target_gk_x;
+        m.gk_y = m.target_gk_y;
+        m.last_shot_was_goal = m.shot_outcome == SHOT_GOAL;
+        if (m.is_player_turn)
+            m.player_goals += m.last_shot_was_goal;
+        else
+            m.ai_goals += m.last_shot_was_goal;
+    }
+}
+
+/**
+ * @brief Timer callback during a shot: runs every fixed step that is due on the real clock,
+ * requests a frame interpolated by the leftover fraction of a step, then sleeps until the next step.
+ */
+void gameLoop(int value)
+{
+    (void)value;
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(now - loop_last_time).count();
+    loop_last_time = now;
+    advanceSimulation(std::min(elapsed, MAX_FRAME_SECONDS));
+    if (match.state != SHOT_IN_PROGRESS && !netClothActive(netCloth, match))
+    {
+        sim_timer_armed = false; // Shot resolved and the net still: nothing moves until the next key press
+        return;
+    }
+    glutTimerFunc(nextStepDelayMs(), gameLoop, 0);
+}
+
+/**
+ * @brief Runs every fixed step covered by `elapsed_seconds` and sets the render interpolation.
+ *
+ * The window passes clamped real time from gameLoop(); offscreen rendering passes exactly one video
+ * frame and replays pass real time multiplied by their speed.
+ */
+void advanceSimulation(double elapsed_seconds)
+{
+    sim_accumulator += elapsed_seconds;
+    double net_us = 0.0;
+    while (sim_accumulator >= SIM_STEP_SECONDS && (match.state == SHOT_IN_PROGRESS || netClothActive(netCloth, match)))
+    {
+        if ((profiler.enabled || stepTiming.record) && match.state == SHOT_IN_PROGRESS)
+        {
+            double since_start = std::chrono::duration<double>(std::chrono::steady_clock::now() - shot_start_time).count();
+            noteStepLateness(std::max(0.0, since_start - match.animation_steps * SIM_STEP_SECONDS) * 1e6);
+        }
+        bool kicking = match.state == SHOT_IN_PROGRESS;
+        updateGameLogic(&match, 1);
+        if (kicking && match.state != SHOT_IN_PROGRESS)
+            logWindowShot(shotRecord(match));
+        if (net_us < NET_FRAME_BUDGET_US) // Past the budget the net skips steps rather than delay the frame
+            net_us += stepNetCloth(netCloth, match);
+        sim_accumulator -= SIM_STEP_SECONDS;
+    }
+    profileNetSim(net_us);
+    if (match.state == SHOT_IN_PROGRESS)
+        render_alpha = (float)(sim_accumulator / SIM_STEP_SECONDS);
+    else
+        render_alpha = 1.0f;
+    requestRedraw(REDRAW_SCENE);
+}
+
+// --- Simulation Thread ---
+// With --sim-thread the window's match runs on its own thread at SIM_STEPS_PER_SECOND whatever the
+// frame rate. Every change is published as a SimSnapshot through a triple buffer: the thread fills
+// its back slot and swaps it with the shared middle one, and the display callback swaps its front
+// slot with the middle only when a fresher one is waiting. Neither side ever waits for the other;
+// between shots the thread sleeps on a condition variable until a key arrives, and the window's
+// idle callback is unregistered once it has drawn the last snapshot.
+
+/**
+ * @brief Thread side: copies the live match and net into the back slot and hands it over.
+ */
+static void publishSimSnapshot(SimThread &t, ProfileClock::time_point step_time)
+{
+    SimSnapshot &s = t.slots[t.back];
+    s.match = t.state.match;
+    s.net_x.assign(t.net.x.begin(), t.net.x.end()); // Same size every time: no allocation after the first
+    s.net_y.assign(t.net.y.begin(), t.net.y.end());
+    s.net_z.assign(t.net.z.begin(), t.net.z.end());
+    s.net_awake = t.net.awake;
+    s.net_rest_ball_near = t.net.rest_ball_near;
+    s.step_time = step_time;
+    std::copy(t.state.inputs, t.state.inputs + SIM_HISTORY, s.inputs);
+    s.input_count = t.state.input_count;
+    std::copy(t.state.lateness_us, t.state.lateness_us + SIM_HISTORY, s.lateness_us);
+    s.lateness_count = t.state.lateness_count;
+    std::copy(t.state.shots, t.state.shots + SIM_HISTORY, s.shots);
+    s.shot_count = t.state.shot_count;
+    t.back = t.middle.exchange(t.back | SNAPSHOT_FRESH, std::memory_order_acq_rel) & 3;
+}
+
+/**
+ * @brief Window side: takes the newest snapshot if one was published since the last call.
+ */
+static bool acquireSimSnapshot(SimThread &t)
+{
+    if (!(t.middle.load(std::memory_order_relaxed) & SNAPSHOT_FRESH))
+        return false;
+    t.front = t.middle.exchange(t.front, std::memory_order_acq_rel) & 3;
+    return true;
+}
+
+/**
+ * @brief Window side: queues a key for the simulation thread. A full ring drops the key; the
+ * thread is then too far behind for it to matter.
+ */
+void postSimKey(unsigned char key, ProfileClock::time_point arrival)
+{
+    SimThread &t = simThread;
+    unsigned head = t.key_head.load(std::memory_order_relaxed);
+    if (head - t.key_tail.load(std::memory_order_acquire) == SIM_KEY_QUEUE)
+        return;
+    SimKey queued = {key, arrival};
+    t.keys[head % SIM_KEY_QUEUE] = queued;
+    {
+        std::lock_guard<std::mutex> lock(t.wake_mutex); // The thread cannot miss it between check and wait
+        t.key_head.store(head + 1, std::memory_order_release);
+    }
+    t.wake.notify_one();
+}
+
+/**
+ * @brief Thread side: the simulation half of handleInput(). Returns true if the key changed the match.
+ */
+static bool applySimKey(SimThread &t, const SimKey &key)
+{
+    Match &m = t.state.match;
+    LatencyKind kind = latencyKind(m, 0);
+    if (!applyMatchKey(m, key.key))
+        return false;
+    PendingInput input = {key.arrival, kind};
+    t.state.inputs[t.state.input_count++ % SIM_HISTORY] = input;
+    if (m.state == SHOT_IN_PROGRESS)
+        startAnimation(&m, 1);
+    recordReplayKey(key.key);
+    if (m.state == GAME_OVER)
+        recordReplayResult(m);
+    return true;
+}
+
+/**
+ * @brief The simulation thread: applies queued keys, runs every fixed step that is due on the real
+ * clock, publishes the result and sleeps until the next step falls due, or until a key arrives when
+ * nothing moves.
+ */
+static void simThreadMain()
+{
+    SimThread &t = simThread;
+    Match &m = t.state.match;
+    double accumulator = 0.0;
+    ProfileClock::time_point last = ProfileClock::now(), shot_start = last;
+    while (!t.stop.load(std::memory_order_acquire))
+    {
+        bool changed = false;
+        unsigned tail = t.key_tail.load(std::memory_order_relaxed);
+        for (; tail != t.key_head.load(std::memory_order_acquire); tail++)
+        {
+            if (!applySimKey(t, t.keys[tail % SIM_KEY_QUEUE]))
+                continue;
+            changed = true;
+            if (m.state == SHOT_IN_PROGRESS) // Keys are ignored mid-flight, so this one kicked
+            {
+                accumulator = 0.0;
+                last = shot_start = ProfileClock::now();
+            }
+        }
+
+        ProfileClock::time_point now = ProfileClock::now();
+        double elapsed = std::min(std::chrono::duration<double>(now - last).count(), MAX_FRAME_SECONDS);
+        last = now;
+        bool moving = m.state == SHOT_IN_PROGRESS || netClothActive(t.net, m);
+        accumulator = moving ? accumulator + elapsed : 0.0;
+        while (moving && accumulator >= SIM_STEP_SECONDS)
+        {
+            if (m.state == SHOT_IN_PROGRESS)
+            {
+                double since_start = std::chrono::duration<double>(ProfileClock::now() - shot_start).count();
+                t.state.lateness_us[t.state.lateness_count++ % SIM_HISTORY] =
+                    (float)(std::max(0.0, since_start - m.animation_steps * SIM_STEP_SECONDS) * 1e6);
+            }
+            bool kicking = m.state == SHOT_IN_PROGRESS;
+            updateGameLogic(&m, 1);
+            if (kicking && m.state != SHOT_IN_PROGRESS)
+                t.state.shots[t.state.shot_count++ % SIM_HISTORY] = shotRecord(m);
+            stepNetCloth(t.net, m);
+            accumulator -= SIM_STEP_SECONDS;
+            changed = true;
+            moving = m.state == SHOT_IN_PROGRESS || netClothActive(t.net, m);
+        }
+        if (changed)
+            publishSimSnapshot(t, now - std::chrono::duration_cast<ProfileClock::duration>(
+                                            std::chrono::duration<double>(accumulator)));
+        t.key_tail.store(tail, std::memory_order_release); // After the publish: simThreadIdle() relies on it
+
+        std::unique_lock<std::mutex> lock(t.wake_mutex);
+        if (moving) // A key or a spurious wake just runs the loop early
+            t.wake.wait_for(lock, std::chrono::duration<double>(SIM_STEP_SECONDS - accumulator));
+        else
+            while (!t.stop.load(std::memory_order_acquire) && t.key_head.load(std::memory_order_acquire) == tail)
+                t.wake.wait(lock); // Nothing moves: sleep until a key arrives
+    }
+}
+
+/**
+ * @brief Display side: copies the newest snapshot into the window's match and net, passes its new
+ * keys and step latenesses on to the latency report and profiler, and interpolates from the time
+ * since its last step. Does nothing without --sim-thread.
+ */
+void latchSimSnapshot()
+{
+    SimThread &t = simThread;
+    if (!t.running)
+        return;
+    bool fresh = acquireSimSnapshot(t);
+    const SimSnapshot &s = t.slots[t.front];
+    if (fresh)
+    {
+        pending_redraw |= netCloth.awake || s.net_awake ? (unsigned)REDRAW_SCENE : redrawForChange(match, s.match);
+        match = s.match;
+        netCloth.x.assign(s.net_x.begin(), s.net_x.end());
+        netCloth.y.assign(s.net_y.begin(), s.net_y.end());
+        netCloth.z.assign(s.net_z.begin(), s.net_z.end());
+        netCloth.awake = s.net_awake;
+        netCloth.rest_ball_near = s.net_rest_ball_near;
+        netCloth.vbo_dirty = true;
+        uint64_t i = std::max(t.inputs_seen, s.input_count > SIM_HISTORY ? s.input_count - SIM_HISTORY : 0);
+        for (; i < s.input_count; i++)
+            noteInputApplied(s.inputs[i % SIM_HISTORY].arrival, s.inputs[i % SIM_HISTORY].kind);
+        t.inputs_seen = s.input_count;
+        i = std::max(t.lateness_seen, s.lateness_count > SIM_HISTORY ? s.lateness_count - SIM_HISTORY : 0);
+        for (; i < s.lateness_count; i++)
+            noteStepLateness(s.lateness_us[i % SIM_HISTORY]);
+        t.lateness_seen = s.lateness_count;
+        i = std::max(t.shots_seen, s.shot_count > SIM_HISTORY ? s.shot_count - SIM_HISTORY : 0);
+        for (; i < s.shot_count; i++)
+            logWindowShot(s.shots[i % SIM_HISTORY]);
+        t.shots_seen = s.shot_count;
+    }
+    if (match.state == SHOT_IN_PROGRESS)
+    {
+        double since_step = std::chrono::duration<double>(ProfileClock::now() - s.step_time).count();
+        render_alpha = (float)std::min(1.0, std::max(0.0, since_step / SIM_STEP_SECONDS));
+    }
+    else
+        render_alpha = 1.0f;
+}
+
+/**
+ * @brief Idle callback for --sim-thread, registered by handleInput() for each key: asks for a frame
+ * while there is something new to show, and unregisters itself once the thread has taken every key,
+ * the last snapshot has been drawn and nothing moves.
+ */
+void simThreadIdle()
+{
+    SimThread &t = simThread;
+    bool keys_taken = t.key_tail.load(std::memory_order_acquire) == t.key_head.load(std::memory_order_relaxed);
+    if ((t.middle.load(std::memory_order_acquire) & SNAPSHOT_FRESH) || match.state == SHOT_IN_PROGRESS ||
+        netClothActive(netCloth, match))
+        requestRedraw(REDRAW_HUD); // latchSimSnapshot() decides whether the world is redrawn
+    else if (keys_taken)
+        glutIdleFunc(NULL);
+}
+
+/**
+ * @brief Hands the window's match and net to a new simulation thread.
+ */
+void startSimThread()
+{
+    SimThread &t = simThread;
+    t.state.match = match;
+    t.state.input_count = t.state.lateness_count = t.state.shot_count = 0;
+    t.net = netCloth;
+    t.inputs_seen = t.lateness_seen = t.shots_seen = 0;
+    t.front = 0;
+    t.back = 1;
+    t.middle.store(2);
+    t.key_head.store(0);
+    t.key_tail.store(0);
+    t.stop.store(false);
+    publishSimSnapshot(t, ProfileClock::now()); // The first frame has a snapshot to draw
+    t.running = true;
+    t.worker = std::thread(simThreadMain);
+}
+
+/**
+ * @brief Stops and joins the simulation thread; the window keeps the last snapshot it took.
+ * Registered with atexit() so the thread never outlives the globals it steps.
+ */
+void stopSimThread()
+{
+    if (!simThread.running)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(simThread.wake_mutex);
+        simThread.stop.store(true, std::memory_order_release);
+    }
+    simThread.wake.notify_one();
+    simThread.worker.join();
+    simThread.running = false;
+}
+
+// --- Replay Recording and Playback ---
+// A replay is the session seed plus every key that changed the game state, so playing it back
+// through handleInput() reproduces the match exactly. Layout (integers are LEB128 varints):
+//   "PSRP" | version byte | difficulty byte | grid byte | flags byte | seed (8 bytes, little endian)
+//   events: delta_ms | key byte            key 0xFF is a result: player_goals | ai_goals
+const char REPLAY_MAGIC[4] = {'P', 'S', 'R', 'P'};
+const unsigned char REPLAY_VERSION = 5; // 2: kicks are decided by ball-flight physics; 3: adaptive AI; 4: target grids; 5: flags
+const unsigned char REPLAY_LOW_LATENCY = 1; // Flag: recorded with --low-latency, so startShot() ran each shot's first step at once
+const unsigned char REPLAY_RESULT_KEY = 0xFF; // Written when GAME_OVER is reached; checked on playback
+
+struct ReplayEvent
+{
+    uint32_t time_ms;
+    unsigned char key;
+    int player_goals, ai_goals; // Only for REPLAY_RESULT_KEY
+};
+
+struct Replay
+{
+    uint64_t seed;
+    Difficulty difficulty;
+    unsigned char grid;
+    unsigned char flags;
+    std::vector<ReplayEvent> events;
+};
+
+struct ReplayRecorder
+{
+    FILE *out;
+    std::chrono::steady_clock::time_point start;
+    double offscreen_seconds; // Offscreen runs stamp events with video time, not the wall clock
+    uint32_t last_ms;
+};
+ReplayRecorder recorder = {NULL, std::chrono::steady_clock::time_point(), 0.0, 0};
+
+struct ReplayPlayback
+{
+    const Replay *replay;
+    size_t next;
+    double clock_seconds;
+    double speed;
+    int results_checked, mismatches;
+    std::chrono::steady_clock::time_point last_time; // Window playback only
+};
+ReplayPlayback playback = {NULL, 0, 0.0, 1.0, 0, 0, std::chrono::steady_clock::time_point()};
+
+static void writeVarint(FILE *out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        std::fputc((int)(value & 0x7F) | 0x80, out);
+        value >>= 7;
+    }
+    std::fputc((int)value, out);
+}
+
+static bool readVarint(const std::vector<unsigned char> &data, size_t &pos, uint64_t &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64 && pos < data.size(); shift += 7)
+    {
+        unsigned char byte = data[pos++];
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Opens `path` for recording and writes the header; match.rng must already hold `seed`,
+ * aiModel(match) its difficulty and match.grid its target grid.
+ */
+bool startReplayRecording(const char *path, uint64_t seed)
+{
+    recorder.out = std::fopen(path, "wb");
+    if (!recorder.out)
+    {
+        std::cerr << "Cannot open " << path << " for writing\n";
+        return false;
+    }
+    std::fwrite(REPLAY_MAGIC, 1, sizeof(REPLAY_MAGIC), recorder.out);
+    std::fputc(REPLAY_VERSION, recorder.out);
+    std::fputc(aiModel(match).difficulty, recorder.out);
+    std::fputc(match.grid, recorder.out);
+    std::fputc(inputLatency.low_latency ? REPLAY_LOW_LATENCY : 0, recorder.out);
+    for (int i = 0; i < 8; i++)
+        std::fputc((int)((seed >> (8 * i)) & 0xFF), recorder.out);
+    std::fflush(recorder.out);
+    recorder.start = std::chrono::steady_clock::now();
+    recorder.offscreen_seconds = 0.0;
+    recorder.last_ms = 0;
+    return true;
+}
+
+static void writeReplayEvent(unsigned char key)
+{
+    double seconds = offscreen_mode ? recorder.offscreen_seconds
+                                    : std::chrono::duration<double>(std::chrono::steady_clock::now() - recorder.start).count();
+    uint32_t now_ms = std::max(recorder.last_ms, (uint32_t)(seconds * 1000.0));
+    writeVarint(recorder.out, now_ms - recorder.last_ms);
+    std::fputc(key, recorder.out);
+    recorder.last_ms = now_ms;
+}
+
+/**
+ * @brief Appends an accepted key press. Flushed per event so a crash still leaves a usable replay.
+ */
+void recordReplayKey(unsigned char key)
+{
+    if (!recorder.out)
+        return;
+    writeReplayEvent(key);
+    std::fflush(recorder.out);
+}
+
+/**
+ * @brief Appends `m`'s final score so playback can prove it reached the same result.
+ */
+void recordReplayResult(const Match &m)
+{
+    if (!recorder.out)
+        return;
+    writeReplayEvent(REPLAY_RESULT_KEY);
+    writeVarint(recorder.out, (uint64_t)m.player_goals);
+    writeVarint(recorder.out, (uint64_t)m.ai_goals);
+    std::fflush(recorder.out);
+}
+
+bool loadReplay(const char *path, Replay &replay)
+{
+    FILE *in = std::fopen(path, "rb");
+    if (!in)
+    {
+        std::cerr << "Cannot open " << path << "\n";
+        return false;
+    }
+    std::vector<unsigned char> data;
+    unsigned char buffer[4096];
+    size_t n;
+    while ((n = std::fread(buffer, 1, sizeof(buffer), in)) > 0)
+        data.insert(data.end(), buffer, buffer + n);
+    std::fclose(in);
+    if (data.size() < 16 || std::memcmp(data.data(), REPLAY_MAGIC, sizeof(REPLAY_MAGIC)) != 0 ||
+        data[4] != REPLAY_VERSION || data[5] >= DIFFICULTY_COUNT || data[6] >= TARGET_GRID_COUNT)
+    {
+        std::cerr << path << " is not a version " << (int)REPLAY_VERSION << " replay\n";
+        return false;
+    }
+    replay.difficulty = (Difficulty)data[5];
+    replay.grid = data[6];
+    replay.flags = data[7];
+    replay.seed = 0;
+    for (int i = 0; i < 8; i++)
+        replay.seed |= (uint64_t)data[8 + i] << (8 * i);
+    replay.events.clear();
+    size_t pos = 16;
+    uint32_t time_ms = 0;
+    while (pos < data.size())
+    {
+        uint64_t delta, player = 0, ai = 0;
+        if (!readVarint(data, pos, delta) || pos >= data.size())
+            break; // Truncated tail (recording interrupted mid-write): keep what was complete
+        ReplayEvent event;
+        time_ms += (uint32_t)delta;
+        event.time_ms = time_ms;
+        event.key = data[pos++];
+        if (event.key == REPLAY_RESULT_KEY && (!readVarint(data, pos, player) || !readVarint(data, pos, ai)))
+            break;
+        event.player_goals = (int)player;
+        event.ai_goals = (int)ai;
+        replay.events.push_back(event);
+    }
+    return true;
+}
+
+/**
+ * @brief Resets the game to the replay's seed, difficulty and grid; the caller then drives advanceReplay().
+ */
+void beginReplay(const Replay &replay, double speed)
+{
+    playback.replay = &replay;
+    playback.next = 0;
+    playback.clock_seconds = 0.0;
+    playback.speed = speed;
+    playback.results_checked = playback.mismatches = 0;
+    replay_playing = true;
+    replay_low_latency = (replay.flags & REPLAY_LOW_LATENCY) != 0;
+    match.rng = SimRng(replay.seed);
+    resetOpponentModel(aiModel(match), replay.difficulty);
+    match.grid = replay.grid;
+    resetMatch(match);
+    requestRedraw(REDRAW_SCENE);
+}
+
+static void applyReplayEvent(const ReplayEvent &event)
+{
+    if (event.key != REPLAY_RESULT_KEY)
+    {
+        handleInput(event.key, 0, 0);
+        return;
+    }
+    playback.results_checked++;
+    if (event.player_goals != match.player_goals || event.ai_goals != match.ai_goals)
+        playback.mismatches++;
+}
+
+/**
+ * @brief Moves the replay clock on by `seconds` of recorded time, applying every key that is due.
+ *
+ * Shots always run their full fixed-step length, so a key recorded just as a shot ended waits for
+ * it here rather than being dropped. Returns false once every event has been applied.
+ */
+bool advanceReplay(double seconds)
+{
+    playback.clock_seconds += seconds;
+    if (match.state == SHOT_IN_PROGRESS || netClothActive(netCloth, match))
+        advanceSimulation(seconds);
+    const std::vector<ReplayEvent> &events = playback.replay->events;
+    while (playback.next < events.size() && match.state != SHOT_IN_PROGRESS &&
+           events[playback.next].time_ms <= playback.clock_seconds * 1000.0)
+        applyReplayEvent(events[playback.next++]);
+    return playback.next < events.size() || match.state == SHOT_IN_PROGRESS;
+}
+
+/**
+ * @brief Plays the whole replay with no clock and no rendering: shots resolve as fast as the
+ * fixed steps can run. Returns the number of events applied.
+ */
+size_t runReplayInstant(const Replay &replay)
+{
+    beginReplay(replay, 0.0);
+    for (size_t i = 0; i < replay.events.size(); i++)
+    {
+        while (match.state == SHOT_IN_PROGRESS)
+            updateGameLogic(&match, 1);
+        applyReplayEvent(replay.events[i]);
+    }
+    while (match.state == SHOT_IN_PROGRESS)
+        updateGameLogic(&match, 1);
+    replay_playing = false;
+    return replay.events.size();
+}
+
+/**
+ * @brief Idle callback for `--replay`: recorded time runs at `speed` times the real clock.
+ */
+void replayLoop()
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    double elapsed = std::min(std::chrono::duration<double>(now - playback.last_time).count(), MAX_FRAME_SECONDS);
+    playback.last_time = now;
+    if (!advanceReplay(elapsed * playback.speed))
+    {
+        glutIdleFunc(NULL);
+        replay_playing = false;
+        std::cerr << "Replay finished: " << match.player_goals << "-" << match.ai_goals
+                  << (playback.mismatches ? " (MISMATCH with recorded result)\n" : "\n");
+        return;
+    }
+    if (match.state != SHOT_IN_PROGRESS)
+    {
+        // Nothing moves between keys; sleep up to the next event instead of spinning
+        double wait = playback.replay->events[playback.next].time_ms / 1000.0 - playback.clock_seconds;
+        double sleep_seconds = std::min(wait / playback.speed, 0.01);
+        if (sleep_seconds > 0.0)
+            std::this_thread::sleep_for(std::chrono::duration<double>(sleep_seconds));
+    }
+}
+
+/**
+ * @brief Entry point for `--verify-replays FILE...`: replays each file headlessly and checks that
+ * it reaches the recorded final score, then reports throughput.
+ */
+int runReplayVerification(int argc, char **argv)
+{
+    std::vector<const char *> paths;
+    for (int i = 1; i < argc; i++)
+        if (std::strcmp(argv[i], "--verify-replays") != 0)
+            paths.push_back(argv[i]);
+    if (paths.empty())
+    {
+        std::cerr << "--verify-replays needs at least one replay file\n";
+        return 1;
+    }
+    offscreen_mode = true; // No window: requestRedraw() only sets flags
+    std::vector<Replay> replays(paths.size());
+    for (size_t i = 0; i < paths.size(); i++)
+        if (!loadReplay(paths[i], replays[i]))
+            return 1;
+
+    int failures = 0;
+    size_t events = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < replays.size(); i++)
+    {
+        events += runReplayInstant(replays[i]);
+        bool ok = playback.mismatches == 0 && playback.results_checked > 0;
+        if (!ok)
+            failures++;
+        std::cout << paths[i] << ": " << (ok ? "OK" : playback.results_checked ? "MISMATCH" : "NO RESULT") << " ("
+                  << match.player_goals << "-" << match.ai_goals << ", " << playback.results_checked << " match"
+                  << (playback.results_checked == 1 ? "" : "es") << ")\n";
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << replays.size() << " replays, " << events << " events in " << seconds * 1000.0 << " ms ("
+              << (seconds > 0.0 ? replays.size() / seconds : 0.0) << " replays/s)\n";
+    return failures ? 1 : 0;
+}
+
+// --- Headless Simulation ---
+// Plays complete shootouts with the same rules as the GLUT loop but without timers,
+// animation or a window, so AI policies can be tuned over millions of matches.
+
+/**
+ * @brief Per-side shooting and diving distribution over LEFT/MIDDLE/RIGHT.
+ *
+ * Stored as cumulative cut-offs on a 32-bit draw so sampling is two compares. An adaptive side
+ * ignores the cut-offs and plays the game's opponent model against the other side instead.
+ */
+struct AIPolicy
+{
+    uint64_t shot_cut[2];
+    uint64_t dive_cut[2];
+    bool adaptive;
+    Difficulty difficulty;
+};
+
+inline Zone samplePolicy(const uint64_t cut[2], uint32_t r)
+{
+    return r < cut[0] ? LEFT : (r < cut[1] ? MIDDLE : RIGHT);
+}
+
+static void setPolicyCuts(uint64_t cut[2], double w_left, double w_middle, double w_right)
+{
+    double total = w_left + w_middle + w_right;
+    cut[0] = (uint64_t)(w_left / total * 4294967296.0);
+    cut[1] = (uint64_t)((w_left + w_middle) / total * 4294967296.0);
+    if (w_right == 0.0)
+        cut[1] = 4294967296ULL;
+}
+
+/**
+ * @brief Weights that play like the human in a shot history: where they shot and where they dived
+ * on the classic grid over the last HISTORY_SCREEN_SHOTS kicks, plus one of each so no side is
+ * ruled out.
+ */
+static bool historyPolicyWeights(const std::string &path, double w[6])
+{
+    HistoryLog log = {-1, false, NULL, 0};
+    if (path.empty() || !openHistory(log, path, false))
+        return false;
+    ShotCounts<uint64_t> c = queryHistory(log, HISTORY_SCREEN_SHOTS, CLASSIC_GRID, SOURCE_PLAYED);
+    closeHistory(log);
+    for (int z = 0; z < 3; z++)
+    {
+        w[z] = c.shots[0][z] + 1.0;
+        w[3 + z] = c.dives[1][z] + 1.0;
+    }
+    return true;
+}
+
+/**
+ * @brief Parses "uniform", "adaptive[:easy|normal|hard]", "history[:FILE]" (the human's habits
+ * from a shot history, by default the window's) or six weights "shotL,shotM,shotR,diveL,diveM,diveR".
+ */
+bool parsePolicy(const char *spec, AIPolicy &policy)
+{
+    double w[6] = {1, 1, 1, 1, 1, 1};
+    policy.adaptive = std::strncmp(spec, "adaptive", 8) == 0;
+    policy.difficulty = DIFFICULTY_NORMAL;
+    if (policy.adaptive)
+    {
+        if (spec[8] != '\0' && (spec[8] != ':' || !parseDifficulty(spec + 9, policy.difficulty)))
+            return false;
+    }
+    else if (std::strncmp(spec, "history", 7) == 0)
+    {
+        if ((spec[7] != '\0' && spec[7] != ':') ||
+            !historyPolicyWeights(spec[7] ? std::string(spec + 8) : defaultHistoryPath(), w))
+            return false;
+    }
+    else if (std::strcmp(spec, "uniform") != 0)
+    {
+        std::stringstream ss(spec);
+        std::string field;
+        for (int i = 0; i < 6; i++)
+        {
+            if (!std::getline(ss, field, ','))
+                return false;
+            char *end = NULL;
+            w[i] = std::strtod(field.c_str(), &end);
+            if (end == field.c_str() || *end != '\0' || w[i] < 0.0)
+                return false;
+        }
+        if (std::getline(ss, field, ','))
+            return false;
+        if (w[0] + w[1] + w[2] <= 0.0 || w[3] + w[4] + w[5] <= 0.0)
+            return false;
+    }
+    setPolicyCuts(policy.shot_cut, w[0], w[1], w[2]);
+    setPolicyCuts(policy.dive_cut, w[3], w[4], w[5]);
+    return true;
+}
+
+struct MatchResult
+{
+    int player_goals;
+    int ai_goals;
+    int rounds;
+};
+
+/**
+ * @brief Both halves of one round's kick; an adaptive side picks from, then updates, its model of
+ * the other side. Fills the zones and outcome of `record` when one is given.
+ */
+static bool simulateKick(const AIPolicy &kicker, OpponentModel &kicker_model, const AIPolicy &keeper,
+                         OpponentModel &keeper_model, SimRng &rng, ShotRecord *record)
+{
+    const TargetGrid &grid = TARGET_GRIDS[CLASSIC_GRID];
+    Zone shot = kicker.adaptive ? chooseShot(kicker_model, grid, rng) : samplePolicy(kicker.shot_cut, rng.next());
+    Zone dive = keeper.adaptive ? chooseDive(keeper_model, grid, rng) : samplePolicy(keeper.dive_cut, rng.next());
+    if (kicker.adaptive)
+        observeDive(kicker_model, grid, dive);
+    if (keeper.adaptive)
+        observeShot(keeper_model, grid, shot);
+    bool goal = isGoal(grid, shot, dive, rng.next());
+    if (record)
+    {
+        record->grid = CLASSIC_GRID;
+        record->shot = shot;
+        record->dive = dive;
+        record->outcome = goal ? SHOT_GOAL : SHOT_SAVED;
+    }
+    return goal;
+}
+
+/**
+ * @brief Plays one full shootout: MAX_ROUNDS regulation rounds, then sudden death. Each side's
+ * model of the other carries over between matches, as it does across a play session. Every kick
+ * is appended to `log` when one is given.
+ */
+MatchResult simulateMatch(const AIPolicy &player, OpponentModel &player_model, const AIPolicy &ai,
+                          OpponentModel &ai_model, SimRng &rng, std::vector<ShotRecord> *log)
+{
+    MatchResult result = {0, 0, 0};
+    for (int round = 1;; round++)
+    {
+        ShotRecord kicks[2];
+        result.player_goals += simulateKick(player, player_model, ai, ai_model, rng, log ? &kicks[0] : NULL);
+        result.ai_goals += simulateKick(ai, ai_model, player, player_model, rng, log ? &kicks[1] : NULL);
+        for (int side = 0; log && side < 2; side++)
+        {
+            kicks[side].flags =
+                HISTORY_SIMULATED | (side ? HISTORY_AI_KICKED : 0) | (round > MAX_ROUNDS ? HISTORY_SUDDEN_DEATH : 0);
+            kicks[side].round = (unsigned char)std::min(round, 255);
+            log->push_back(kicks[side]);
+        }
+        result.rounds = round;
+        if (isShootoutDecided(round, result.player_goals, result.ai_goals) ||
+            round >= MAX_ROUNDS + MAX_SUDDEN_DEATH_ROUNDS)
+            break;
+    }
+    return result;
+}
+
+const int SIM_HISTOGRAM_SIZE = MAX_ROUNDS + MAX_SUDDEN_DEATH_ROUNDS + 1;
+
+struct SimStats
+{
+    uint64_t matches;
+    uint64_t player_wins;
+    uint64_t ai_wins;
+    uint64_t draws;
+    uint64_t player_goals;
+    uint64_t ai_goals;
+    uint64_t rounds_histogram[SIM_HISTOGRAM_SIZE];
+};
+
+/**
+ * @brief The history --simulate logs to, shared by its workers. Each worker appends its kicks a
+ * block's worth at a time, so memory stays flat however many matches are played.
+ */
+struct SimHistory
+{
+    HistoryLog *log;
+    std::mutex lock;
+};
+
+static void flushSimulatedShots(SimHistory &history, std::vector<ShotRecord> &shots)
+{
+    std::lock_guard<std::mutex> guard(history.lock);
+    for (size_t i = 0; i < shots.size(); i++)
+        appendShot(*history.log, shots[i]);
+    shots.clear();
+}
+
+static void simulateBatch(uint64_t matches, uint64_t seed, const AIPolicy *player, const AIPolicy *ai, SimStats *stats,
+                          SimHistory *history)
+{
+    std::vector<ShotRecord> shots, *log = history ? &shots : NULL;
+    if (history)
+        shots.reserve(HISTORY_BLOCK_SHOTS + 2 * (MAX_ROUNDS + MAX_SUDDEN_DEATH_ROUNDS)); // One batch plus a match
+    SimRng rng(seed);
+    OpponentModel player_model, ai_model;
+    resetOpponentModel(player_model, player->difficulty);
+    resetOpponentModel(ai_model, ai->difficulty);
+    std::memset(stats, 0, sizeof(SimStats));
+    for (uint64_t i = 0; i < matches; i++)
+    {
+        MatchResult r = simulateMatch(*player, player_model, *ai, ai_model, rng, log);
+        stats->player_goals += r.player_goals;
+        stats->ai_goals += r.ai_goals;
+        stats->player_wins += r.player_goals > r.ai_goals;
+        stats->ai_wins += r.ai_goals > r.player_goals;
+        stats->draws += r.ai_goals == r.player_goals;
+        stats->rounds_histogram[r.rounds]++;
+        if (history && shots.size() >= HISTORY_BLOCK_SHOTS)
+            flushSimulatedShots(*history, shots);
+    }
+    if (history)
+        flushSimulatedShots(*history, shots);
+    stats->matches = matches;
+}
+
+/**
+ * @brief Splits `matches` across `threads` workers and merges their private counters. With a
+ * `history`, the workers append their kicks to it in batches as they play, in whatever order the
+ * batches finish.
+ */
+SimStats runSimulation(uint64_t matches, unsigned threads, uint64_t seed, const AIPolicy &player, const AIPolicy &ai,
+                       HistoryLog *history)
+{
+    if (threads == 0)
+        threads = 1;
+    std::vector<SimStats> partial(threads);
+    SimHistory shared;
+    shared.log = history;
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++)
+    {
+        uint64_t share = matches / threads + (t < matches % threads ? 1 : 0);
+        uint64_t thread_seed = seed + 0x9E3779B97F4A7C15ULL * (t + 1);
+        workers.push_back(std::thread(simulateBatch, share, thread_seed, &player, &ai, &partial[t],
+                                      history ? &shared : (SimHistory *)NULL));
+    }
+    SimStats total;
+    std::memset(&total, 0, sizeof(total));
+    for (unsigned t = 0; t < threads; t++)
+    {
+        workers[t].join();
+        total.matches += partial[t].matches;
+        total.player_wins += partial[t].player_wins;
+        total.ai_wins += partial[t].ai_wins;
+        total.draws += partial[t].draws;
+        total.player_goals += partial[t].player_goals;
+        total.ai_goals += partial[t].ai_goals;
+        for (int i = 0; i < SIM_HISTOGRAM_SIZE; i++)
+            total.rounds_histogram[i] += partial[t].rounds_histogram[i];
+    }
+    return total;
+}
+
+void printSimStats(const SimStats &stats, double seconds, unsigned threads)
+{
+    double n = stats.matches ? (double)stats.matches : 1.0;
+    std::cout << "Matches:      " << stats.matches << " on " << threads << " thread(s) in " << seconds << " s ("
+              << (uint64_t)(stats.matches / (seconds > 0.0 ? seconds : 1e-9)) << " matches/s)\n";
+    std::cout << "Player wins:  " << stats.player_wins << " (" << 100.0 * stats.player_wins / n << "%)\n";
+    std::cout << "AI wins:      " << stats.ai_wins << " (" << 100.0 * stats.ai_wins / n << "%)\n";
+    std::cout << "Draws:        " << stats.draws << " (" << 100.0 * stats.draws / n << "%)\n";
+    std::cout << "Avg goals:    player " << stats.player_goals / n << ", AI " << stats.ai_goals / n << "\n";
+    std::cout << "Rounds histogram:\n";
+    for (int i = 1; i < SIM_HISTOGRAM_SIZE; i++)
+    {
+        if (stats.rounds_histogram[i] == 0)
+            continue;
+        std::cout << "  " << i << (i > MAX_ROUNDS ? " (SD)" : "     ") << "\t" << stats.rounds_histogram[i] << "\t"
+                  << 100.0 * stats.rounds_histogram[i] / n << "%\n";
+    }
+}
+
+/**
+ * @brief Parses a positive decimal count. Unlike a bare strtoull(), rejects a sign (which would
+ * wrap -5 to a huge count), non-digits, trailing characters, zero and values that overflow.
+ */
+bool parseCount(const char *text, uint64_t &count)
+{
+    if (!text || !std::isdigit((unsigned char)text[0]))
+        return false;
+    char *end = NULL;
+    errno = 0;
+    unsigned long long value = std::strtoull(text, &end, 10);
+    if (*end != '\0' || errno == ERANGE || value == 0)
+        return false;
+    count = value;
+    return true;
+}
+
+/**
+ * @brief Parses a non-negative decimal amount such as a percentage or a delay. Unlike atof(),
+ * rejects a sign, trailing characters and anything that is not a finite number.
+ */
+bool parseAmount(const char *text, double &amount)
+{
+    if (!text || !(std::isdigit((unsigned char)text[0]) || text[0] == '.'))
+        return false;
+    char *end = NULL;
+    double value = std::strtod(text, &end);
+    if (*end != '\0' || !std::isfinite(value))
+        return false;
+    amount = value;
+    return true;
+}
+
+const char SIMULATE_USAGE[] =
+    "Usage: penalty --simulate N [--threads N] [--seed N] [--history FILE] [--player-policy P] [--ai-policy P]\n";
+
+/**
+ * @brief Entry point for `--simulate N`; never touches GLUT so it runs without a display.
+ */
+int runHeadless(int argc, char **argv)
+{
+    uint64_t matches = 0;
+    unsigned threads = std::thread::hardware_concurrency();
+    uint64_t seed = (uint64_t)time(NULL);
+    const char *history_path = NULL;
+    AIPolicy player_policy, ai_policy;
+    parsePolicy("uniform", player_policy);
+    parsePolicy("uniform", ai_policy);
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!value)
+        {
+            std::cerr << "Missing value for " << arg << "\n";
+            return 1;
+        }
+        uint64_t count = 0;
+        if ((std::strcmp(arg, "--simulate") == 0 || std::strcmp(arg, "--threads") == 0) && !parseCount(value, count))
+        {
+            std::cerr << "Bad count for " << arg << ": " << value << "\n" << SIMULATE_USAGE;
+            return 1;
+        }
+        if (std::strcmp(arg, "--simulate") == 0)
+            matches = count;
+        else if (std::strcmp(arg, "--threads") == 0)
+            threads = (unsigned)std::min<uint64_t>(count, UINT32_MAX);
+        else if (std::strcmp(arg, "--seed") == 0)
+            seed = std::strtoull(value, NULL, 10);
+        else if (std::strcmp(arg, "--history") == 0)
+            history_path = value;
+        else if (std::strcmp(arg, "--player-policy") == 0)
+        {
+            if (!parsePolicy(value, player_policy))
+            {
+                std::cerr << "Bad policy: " << value << "\n";
+                return 1;
+            }
+        }
+        else if (std::strcmp(arg, "--ai-policy") == 0)
+        {
+            if (!parsePolicy(value, ai_policy))
+            {
+                std::cerr << "Bad policy: " << value << "\n";
+                return 1;
+            }
+        }
+        else
+        {
+            std::cerr << "Unknown option: " << arg << "\n";
+            return 1;
+        }
+        i++;
+    }
+    if (matches == 0)
+    {
+        std::cerr << SIMULATE_USAGE;
+        return 1;
+    }
+    if (threads == 0)
+        threads = 1;
+    if (threads > matches)
+        threads = (unsigned)matches; // The extra threads would have no matches to play
+    if (history_path && sameFile(history_path, defaultHistoryPath()))
+    {
+        // Counted apart or not, a million simulated kicks would push the human's out of the window's view
+        std::cerr << "--simulate will not log to the window's shot history; give --history another file\n";
+        return 1;
+    }
+    HistoryLog history = {-1, false, NULL, 0};
+    if (history_path && !openHistory(history, history_path, true))
+        return 1;
+    if (history_path && !history.writable)
+    {
+        std::cerr << "--simulate cannot log to a history another process is writing\n";
+        closeHistory(history);
+        return 1;
+    }
+
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    SimStats stats = runSimulation(matches, threads, seed, player_policy, ai_policy, history_path ? &history : NULL);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    printSimStats(stats, seconds, threads);
+    if (history_path)
+    {
+        std::cout << "History:      " << historyHeader(history).shots << " kicks in " << history_path << "\n";
+        closeHistory(history);
+    }
+    return 0;
+}
+
+const char HISTORY_STATS_USAGE[] =
+    "Usage: penalty --history-stats [--history FILE] [--last N] [--grid 3x1|3x2|3x3] [--simulated]\n";
+
+/**
+ * @brief Entry point for --history-stats: prints the stats screen's report for a shot history.
+ */
+int runHistoryStats(int argc, char **argv)
+{
+    const char *path = NULL;
+    uint64_t last = HISTORY_SCREEN_SHOTS;
+    unsigned char grid = CLASSIC_GRID;
+    HistorySource source = SOURCE_PLAYED;
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (std::strcmp(arg, "--history-stats") == 0)
+            continue;
+        if (std::strcmp(arg, "--simulated") == 0)
+        {
+            source = SOURCE_SIMULATED;
+            continue;
+        }
+        if (!value)
+        {
+            std::cerr << "Missing value for " << arg << "\n";
+            return 1;
+        }
+        if (std::strcmp(arg, "--history") == 0)
+            path = value;
+        else if (std::strcmp(arg, "--last") == 0)
+        {
+            if (!parseCount(value, last))
+            {
+                std::cerr << "Bad count for --last: " << value << "\n" << HISTORY_STATS_USAGE;
+                return 1;
+            }
+        }
+        else if (std::strcmp(arg, "--grid") == 0)
+        {
+            if (!parseTargetGrid(value, grid))
+            {
+                std::cerr << "Unknown grid " << value << "\n";
+                return 1;
+            }
+        }
+        else
+        {
+            std::cerr << "Unknown option: " << arg << "\n";
+            return 1;
+        }
+        i++;
+    }
+    std::string file = path ? path : defaultHistoryPath();
+    HistoryLog log = {-1, false, NULL, 0};
+    if (file.empty() || !openHistory(log, file, false))
+        return 1;
+    uint64_t shots = historyHeader(log).shots;
+    std::cout << file << ": " << shots << " kicks logged; the last " << std::min(last, shots) << ":\n";
+    std::vector<std::string> lines = historyReport(log, last, grid, source);
+    for (size_t i = 0; i < lines.size(); i++)
+        std::cout << lines[i] << "\n";
+    closeHistory(log);
+    return 0;
+}
+
+// --- Tournaments ---
+// Ranks many policies against each other in a round-robin league or a knockout bracket. Every
+// fixture is one simulateMatch() shootout, seeded from its own index, so the standings do not
+// depend on which thread played what. Workers share the fixtures by work stealing and add each
+// result straight into shared atomic standings, without locks or a merge step.
+
+const uint32_t TOURNAMENT_MAX_POLICIES = 65536; // Keeps a league's fixture count within 32 bits
+const uint32_t TOURNAMENT_CHUNK = 256;           // Fixtures a worker claims from its own range at once
+const int KNOCKOUT_REPLAYS = 8;                  // A drawn tie is replayed this often, then the home side goes through
+const double ELO_START = 1500.0, ELO_K = 16.0;
+const double ELO_SCALE = 65536.0; // Ratings are kept as fixed point so they can be added atomically
+
+struct TournamentPolicy
+{
+    std::string name;
+    AIPolicy policy;
+};
+
+/**
+ * @brief One policy's row of the table. Workers add to it with relaxed atomics; nothing reads it
+ * until every worker has joined, apart from the Elo update, which tolerates a stale rating.
+ */
+struct Standing
+{
+    std::atomic<uint32_t> wins, draws, losses;
+    std::atomic<uint64_t> goals_for, goals_against;
+    std::atomic<int64_t> elo;
+};
+
+struct Tournament
+{
+    std::vector<TournamentPolicy> policies;
+    std::vector<Standing> standings;
+    uint64_t seed;
+};
+
+/**
+ * @brief What one worker thread did, for the per-core throughput report.
+ */
+struct WorkerStats
+{
+    uint64_t fixtures;
+    uint64_t steals;
+    double seconds;
+};
+
+/**
+ * @brief Remaining fixture indices of one worker, packed as begin << 32 | end, so the owner's
+ * claims from the front and thieves' steals from the back are each a single compare-and-swap.
+ * Padded to a cache line so a busy owner does not slow its neighbours.
+ */
+struct WorkRange
+{
+    std::atomic<uint64_t> range;
+    char padding[64 - sizeof(std::atomic<uint64_t>)];
+};
+
+inline uint64_t packRange(uint32_t begin, uint32_t end)
+{
+    return (uint64_t)begin << 32 | end;
+}
+
+/**
+ * @brief Calls play(begin, end) on every fixture index in [0, count) across `threads` workers.
+ * play() returns how many fixtures it actually played, which goes into the worker's stats.
+ *
+ * Each worker starts with an equal slice and eats it TOURNAMENT_CHUNK fixtures at a time. A
+ * worker whose slice runs dry takes the back half of the first other slice that still has work,
+ * and stops once it finds none. Work only ever moves between slices, so nothing is lost when a
+ * worker stops while a steal is in flight: the thief plays what it took.
+ */
+template <typename Play>
+static void runWorkStealing(uint32_t count, unsigned threads, Play play, std::vector<WorkerStats> &stats)
+{
+    std::vector<WorkRange> queues(threads);
+    for (unsigned t = 0; t < threads; t++)
+        queues[t].range.store(packRange((uint32_t)((uint64_t)count * t / threads),
+                                        (uint32_t)((uint64_t)count * (t + 1) / threads)));
+    stats.assign(threads, WorkerStats());
+    std::vector<std::thread> workers;
+    for (unsigned self = 0; self < threads; self++)
+    {
+        workers.push_back(std::thread([&queues, &stats, &play, threads, self]() {
+            std::chrono::steady_clock::time_point begin_time = std::chrono::steady_clock::now();
+            WorkerStats &ws = stats[self];
+            std::atomic<uint64_t> &own = queues[self].range;
+            for (;;)
+            {
+                uint64_t r = own.load(std::memory_order_acquire);
+                uint32_t begin = (uint32_t)(r >> 32), end = (uint32_t)r;
+                if (begin < end)
+                {
+                    uint32_t take = std::min(TOURNAMENT_CHUNK, end - begin);
+                    if (!own.compare_exchange_weak(r, packRange(begin + take, end), std::memory_order_acq_rel))
+                        continue; // A thief got there first; re-read what is left
+                    ws.fixtures += play(begin, begin + take);
+                    continue;
+                }
+                bool stole = false;
+                for (unsigned k = 1; k < threads && !stole; k++)
+                {
+                    std::atomic<uint64_t> &victim = queues[(self + k) % threads].range;
+                    uint64_t v = victim.load(std::memory_order_acquire);
+                    for (;;)
+                    {
+                        uint32_t vb = (uint32_t)(v >> 32), ve = (uint32_t)v;
+                        if (vb >= ve)
+                            break;
+                        uint32_t mid = vb + (ve - vb) / 2;
+                        if (victim.compare_exchange_weak(v, packRange(vb, mid), std::memory_order_acq_rel))
+                        {
+                            own.store(packRange(mid, ve), std::memory_order_release);
+                            ws.steals++;
+                            stole = true;
+                            break;
+                        }
+                    }
+                }
+                if (!stole)
+                    break;
+            }
+            ws.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin_time).count();
+        }));
+    }
+    for (unsigned t = 0; t < threads; t++)
+        workers[t].join();
+}
+
+/**
+ * @brief Spreads a fixture's index over the seed, so neighbouring fixtures draw unrelated kicks.
+ */
+inline uint64_t fixtureSeed(uint64_t seed, uint64_t fixture)
+{
+    uint64_t z = seed + 0x9E3779B97F4A7C15ULL * (fixture + 1);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static void recordSide(Standing &s, int goals_for, int goals_against)
+{
+    s.wins.fetch_add(goals_for > goals_against, std::memory_order_relaxed);
+    s.draws.fetch_add(goals_for == goals_against, std::memory_order_relaxed);
+    s.losses.fetch_add(goals_for < goals_against, std::memory_order_relaxed);
+    s.goals_for.fetch_add((uint64_t)goals_for, std::memory_order_relaxed);
+    s.goals_against.fetch_add((uint64_t)goals_against, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Plays one fixture and adds it to both sides' standings. `home` kicks first. Adaptive
+ * policies start each fixture with a fresh model, so one fixture cannot coach the next.
+ *
+ * Elo moves as results arrive, from whatever ratings the two rows hold at that moment, so the
+ * ratings vary slightly with thread timing; the rest of the table does not.
+ */
+static MatchResult playFixture(Tournament &t, uint32_t home, uint32_t away, uint64_t fixture)
+{
+    const AIPolicy &home_policy = t.policies[home].policy, &away_policy = t.policies[away].policy;
+    OpponentModel home_model, away_model;
+    resetOpponentModel(home_model, home_policy.difficulty);
+    resetOpponentModel(away_model, away_policy.difficulty);
+    SimRng rng(fixtureSeed(t.seed, fixture));
+    MatchResult r = simulateMatch(home_policy, home_model, away_policy, away_model, rng, NULL);
+
+    Standing &h = t.standings[home], &a = t.standings[away];
+    recordSide(h, r.player_goals, r.ai_goals);
+    recordSide(a, r.ai_goals, r.player_goals);
+    double diff = (a.elo.load(std::memory_order_relaxed) - h.elo.load(std::memory_order_relaxed)) / ELO_SCALE;
+    double expected = 1.0 / (1.0 + std::pow(10.0, diff / 400.0));
+    double score = r.player_goals > r.ai_goals ? 1.0 : r.player_goals == r.ai_goals ? 0.5 : 0.0;
+    int64_t delta = (int64_t)(ELO_K * (score - expected) * ELO_SCALE);
+    h.elo.fetch_add(delta, std::memory_order_relaxed);
+    a.elo.fetch_sub(delta, std::memory_order_relaxed);
+    return r;
+}
+
+/**
+ * @brief Round-robin league by the circle method: with an even count n, round r pairs slot 0
+ * with the fixed team n-1 and slot s with the teams s steps either side of r. Any fixture index
+ * maps to its pair in O(1), so the schedule is never stored. An odd count adds a bye, and the
+ * bye's fixtures are skipped. Home and away alternate by round.
+ */
+static uint64_t runLeague(Tournament &t, unsigned threads, std::vector<WorkerStats> &stats)
+{
+    uint32_t count = (uint32_t)t.policies.size();
+    uint32_t n = count + (count & 1), half = n / 2, rounds = n - 1;
+    runWorkStealing(
+        rounds * half, threads,
+        [&t, count, n, half](uint32_t begin, uint32_t end) {
+            uint64_t played = 0;
+            for (uint32_t f = begin; f < end; f++)
+            {
+                uint32_t round = f / half, slot = f % half;
+                uint32_t a = slot == 0 ? n - 1 : (round + slot) % (n - 1);
+                uint32_t b = (round + n - 1 - slot) % (n - 1);
+                if (a == count || b == count)
+                    continue;
+                if (round & 1)
+                    std::swap(a, b);
+                playFixture(t, a, b, f);
+                played++;
+            }
+            return played;
+        },
+        stats);
+    uint64_t played = 0;
+    for (size_t w = 0; w < stats.size(); w++)
+        played += stats[w].fixtures;
+    return played;
+}
+
+/**
+ * @brief Single-elimination bracket in a seeded random draw. Each round's ties run in parallel;
+ * an odd survivor out gets a bye. A tie still level after MAX_SUDDEN_DEATH_ROUNDS is replayed.
+ */
+static uint64_t runKnockout(Tournament &t, unsigned threads, std::vector<WorkerStats> &stats, uint32_t &champion)
+{
+    std::vector<uint32_t> alive(t.policies.size());
+    for (uint32_t i = 0; i < alive.size(); i++)
+        alive[i] = i;
+    SimRng draw(t.seed ^ 0xD1B54A32D192ED03ULL);
+    for (size_t i = alive.size() - 1; i > 0; i--)
+        std::swap(alive[i], alive[draw.next() % (i + 1)]);
+
+    uint64_t played = 0;
+    stats.assign(threads, WorkerStats());
+    for (uint64_t round = 1; alive.size() > 1; round++)
+    {
+        uint32_t ties = (uint32_t)(alive.size() / 2);
+        std::vector<uint32_t> next((alive.size() + 1) / 2);
+        std::atomic<uint64_t> replays(0);
+        std::vector<WorkerStats> round_stats;
+        runWorkStealing(
+            ties, threads,
+            [&t, &alive, &next, &replays, round](uint32_t begin, uint32_t end) {
+                uint64_t played = 0;
+                for (uint32_t slot = begin; slot < end; slot++)
+                {
+                    uint32_t home = alive[2 * slot], away = alive[2 * slot + 1];
+                    MatchResult r = {0, 0, 0};
+                    int attempt = 0;
+                    for (; attempt <= KNOCKOUT_REPLAYS && r.player_goals == r.ai_goals; attempt++)
+                        r = playFixture(t, home, away, round << 40 | (uint64_t)attempt << 32 | slot);
+                    replays.fetch_add((uint64_t)(attempt - 1), std::memory_order_relaxed);
+                    next[slot] = r.ai_goals > r.player_goals ? away : home;
+                    played += (uint64_t)attempt;
+                }
+                return played;
+            },
+            round_stats);
+        if (alive.size() & 1)
+            next.back() = alive.back();
+        std::cout << "Round " << round << ":\t" << alive.size() << " left, " << ties << " ties";
+        if (replays.load())
+            std::cout << ", " << replays.load() << " replayed";
+        std::cout << "\n";
+        played += ties + replays.load();
+        for (unsigned w = 0; w < threads; w++)
+        {
+            stats[w].fixtures += round_stats[w].fixtures;
+            stats[w].steals += round_stats[w].steals;
+            stats[w].seconds += round_stats[w].seconds;
+        }
+        alive.swap(next);
+    }
+    champion = alive[0];
+    return played;
+}
+
+/**
+ * @brief Standings order: points (three for a win, one for a draw), then goal difference, then
+ * goals scored, then listing order.
+ */
+struct StandingOrder
+{
+    const std::vector<Standing> *standings;
+    static int64_t points(const Standing &s) { return 3 * (int64_t)s.wins.load() + s.draws.load(); }
+    bool operator()(uint32_t a, uint32_t b) const
+    {
+        const Standing &x = (*standings)[a], &y = (*standings)[b];
+        int64_t px = points(x), py = points(y);
+        if (px != py)
+            return px > py;
+        int64_t dx = (int64_t)x.goals_for.load() - (int64_t)x.goals_against.load();
+        int64_t dy = (int64_t)y.goals_for.load() - (int64_t)y.goals_against.load();
+        if (dx != dy)
+            return dx > dy;
+        if (x.goals_for.load() != y.goals_for.load())
+            return x.goals_for.load() > y.goals_for.load();
+        return a < b;
+    }
+};
+
+static void printStandings(const Tournament &t, size_t top)
+{
+    std::vector<uint32_t> order(t.policies.size());
+    for (uint32_t i = 0; i < order.size(); i++)
+        order[i] = i;
+    StandingOrder by_points = {&t.standings};
+    top = std::min(top, order.size());
+    std::partial_sort(order.begin(), order.begin() + top, order.end(), by_points);
+    std::cout << "Standings (top " << top << "):\n";
+    std::cout << "  Pos\tW\tD\tL\tGF\tGA\tPts\tElo\tPolicy\n";
+    for (size_t i = 0; i < top; i++)
+    {
+        const Standing &s = t.standings[order[i]];
+        std::cout << "  " << i + 1 << "\t" << s.wins.load() << "\t" << s.draws.load() << "\t" << s.losses.load()
+                  << "\t" << s.goals_for.load() << "\t" << s.goals_against.load() << "\t"
+                  << StandingOrder::points(s) << "\t" << (int)std::floor(s.elo.load() / ELO_SCALE + 0.5) << "\t"
+                  << t.policies[order[i]].name << "\n";
+    }
+}
+
+/**
+ * @brief Reads one policy spec per line (see parsePolicy()); blank lines and lines starting with
+ * '#' are skipped.
+ */
+static bool loadPolicies(const char *path, std::vector<TournamentPolicy> &policies)
+{
+    std::ifstream in(path);
+    if (!in)
+    {
+        std::cerr << "Cannot open " << path << "\n";
+        return false;
+    }
+    std::string line;
+    for (int number = 1; std::getline(in, line); number++)
+    {
+        line.erase(line.find_last_not_of(" \t\r") + 1);
+        if (line.empty() || line[0] == '#')
+            continue;
+        TournamentPolicy p;
+        p.name = line;
+        if (!parsePolicy(line.c_str(), p.policy))
+        {
+            std::cerr << path << ":" << number << ": bad policy: " << line << "\n";
+            return false;
+        }
+        policies.push_back(p);
+    }
+    return true;
+}
+
+const char TOURNAMENT_USAGE[] = "Usage: penalty --tournament N [--policies FILE] [--format league|knockout] [--threads T]\n"
+                                "       [--seed S] [--top K]\n";
+
+/**
+ * @brief Entry point for `--tournament N`: ranks N random fixed policies, plus any listed with
+ * --policies, in a league or knockout, and reports standings and per-thread throughput.
+ */
+int runTournament(int argc, char **argv)
+{
+    uint64_t generated = 0, thread_count = std::thread::hardware_concurrency(), top = 10;
+    uint64_t seed = (uint64_t)time(NULL);
+    bool knockout = false;
+    std::vector<TournamentPolicy> policies;
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!value)
+        {
+            std::cerr << "Missing value for " << arg << "\n";
+            return 1;
+        }
+        bool count_ok = true;
+        if (std::strcmp(arg, "--tournament") == 0)
+        {
+            if (std::strcmp(value, "0") != 0) // 0 ranks only the --policies file
+                count_ok = parseCount(value, generated);
+        }
+        else if (std::strcmp(arg, "--threads") == 0)
+            count_ok = parseCount(value, thread_count);
+        else if (std::strcmp(arg, "--seed") == 0)
+            seed = std::strtoull(value, NULL, 10);
+        else if (std::strcmp(arg, "--top") == 0)
+            count_ok = parseCount(value, top);
+        else if (std::strcmp(arg, "--format") == 0)
+        {
+            if (std::strcmp(value, "league") != 0 && std::strcmp(value, "knockout") != 0)
+            {
+                std::cerr << "Format must be league or knockout\n";
+                return 1;
+            }
+            knockout = std::strcmp(value, "knockout") == 0;
+        }
+        else if (std::strcmp(arg, "--policies") == 0)
+        {
+            if (!loadPolicies(value, policies))
+                return 1;
+        }
+        else
+        {
+            std::cerr << "Unknown option: " << arg << "\n";
+            return 1;
+        }
+        if (!count_ok)
+        {
+            std::cerr << "Bad count for " << arg << ": " << value << "\n" << TOURNAMENT_USAGE;
+            return 1;
+        }
+        i++;
+    }
+    // Fixtures are seeded by index, so the standings do not depend on the thread count; workers
+    // beyond the cores only time-slice and steal from each other
+    unsigned cores = std::thread::hardware_concurrency();
+    if (cores && thread_count > cores)
+        thread_count = cores;
+    unsigned threads = (unsigned)std::max<uint64_t>(1, std::min<uint64_t>(thread_count, UINT32_MAX));
+    if (policies.size() + generated > TOURNAMENT_MAX_POLICIES)
+    {
+        std::cerr << "At most " << TOURNAMENT_MAX_POLICIES << " policies\n";
+        return 1;
+    }
+    SimRng weights(seed);
+    for (uint32_t i = 0; i < generated; i++)
+    {
+        std::ostringstream spec;
+        spec.precision(2);
+        spec << std::fixed;
+        for (int w = 0; w < 6; w++)
+            spec << (w ? "," : "") << 0.05f + weights.nextFloat();
+        TournamentPolicy p;
+        p.name = spec.str();
+        parsePolicy(p.name.c_str(), p.policy);
+        policies.push_back(p);
+    }
+    if (policies.size() < 2)
+    {
+        std::cerr << "--tournament needs at least two policies\n";
+        return 1;
+    }
+
+    Tournament t;
+    t.policies.swap(policies);
+    t.standings = std::vector<Standing>(t.policies.size());
+    for (size_t i = 0; i < t.standings.size(); i++)
+    {
+        Standing &s = t.standings[i];
+        s.wins = 0;
+        s.draws = 0;
+        s.losses = 0;
+        s.goals_for = 0;
+        s.goals_against = 0;
+        s.elo = (int64_t)(ELO_START * ELO_SCALE);
+    }
+    t.seed = seed;
+
+    std::cout << "Policies:     " << t.policies.size() << " (" << (knockout ? "knockout" : "league") << ")\n";
+    std::vector<WorkerStats> stats;
+    uint32_t champion = 0;
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    uint64_t fixtures = knockout ? runKnockout(t, threads, stats, champion) : runLeague(t, threads, stats);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    std::cout << "Fixtures:     " << fixtures << " on " << threads << " thread(s) in " << seconds << " s ("
+              << (uint64_t)(fixtures / (seconds > 0.0 ? seconds : 1e-9)) << " fixtures/s, "
+              << (uint64_t)(fixtures / (seconds > 0.0 ? seconds * threads : 1e-9)) << " per thread)\n";
+    for (unsigned w = 0; w < threads; w++)
+        std::cout << "  thread " << w << "\t" << stats[w].fixtures << " fixtures\t" << stats[w].steals << " steals\t"
+                  << (uint64_t)(stats[w].fixtures / (stats[w].seconds > 0.0 ? stats[w].seconds : 1e-9))
+                  << " fixtures/s\n";
+    if (knockout)
+        std::cout << "Winner:       " << t.policies[champion].name << "\n";
+    printStandings(t, top);
+    return 0;
+}
+
+const char BALL_BENCH_USAGE[] = "Usage: penalty --ball-bench N [--seed S]\n";
+
+/**
+ * @brief Entry point for `--ball-bench N`: flies N random kicks for a whole shot, through the
+ * SIMD batch kernel and then lane by lane, and reports trajectories per millisecond for each.
+ */
+int runBallBench(int argc, char **argv)
+{
+    uint64_t trajectories = 0;
+    uint64_t seed = 1;
+    for (int i = 1; i + 1 < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--ball-bench") == 0)
+        {
+            if (!parseCount(argv[++i], trajectories))
+            {
+                std::cerr << "Bad count for --ball-bench: " << argv[i] << "\n" << BALL_BENCH_USAGE;
+                return 1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--seed") == 0)
+            seed = std::strtoull(argv[++i], NULL, 10);
+    }
+    if (trajectories == 0)
+    {
+        std::cerr << BALL_BENCH_USAGE;
+        return 1;
+    }
+    size_t count = (size_t)trajectories;
+    BallBatch start;
+    start.resize(count);
+    Match kicker = Match();
+    kicker.rng = SimRng(seed);
+    for (size_t i = 0; i < count; i++)
+    {
+        resetMatch(kicker);
+        kickBall(kicker, (Zone)(kicker.rng.next() % 3));
+        start.px[i] = kicker.ball_x;
+        start.py[i] = kicker.ball_y;
+        start.pz[i] = kicker.ball_z;
+        start.vx[i] = kicker.ball_vx;
+        start.vy[i] = kicker.ball_vy;
+        start.vz[i] = kicker.ball_vz;
+        start.spin_x[i] = kicker.spin_x;
+        start.spin_y[i] = kicker.spin_y;
+        start.keeper_x[i] = TARGET_GRIDS[CLASSIC_GRID].zone_x[kicker.rng.next() % 3] * 0.8f;
+        start.keeper_y[i] = 0.0f;
+        start.keeper_top[i] = GK_REACH_HEIGHT;
+    }
+    const char *labels[] = {"batch", "scalar"};
+    for (int mode = 0; mode < 2; mode++)
+    {
+        BallBatch batch = start;
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        for (int step = 0; step < TOTAL_ANIMATION_STEPS; step++)
+        {
+            if (mode == 0)
+                stepBalls(batch, (float)SIM_STEP_SECONDS, true);
+            else
+                for (size_t i = 0; i < count; i++)
+                    stepBallLanes<float>(batch, i, (float)SIM_STEP_SECONDS, true);
+        }
+        double ms = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count() * 1000.0;
+        size_t goals = 0;
+        for (size_t i = 0; i < count; i++)
+            goals += (batch.events[i] & BALL_CROSSED_GOAL) && !(batch.events[i] & BALL_HIT_KEEPER);
+        std::cout << labels[mode] << ": " << count << " kicks x " << TOTAL_ANIMATION_STEPS << " steps in " << ms
+                  << " ms (" << count / ms << " trajectories/ms, " << goals << " in the net)\n";
+    }
+    return 0;
+}
+
+const char AI_BENCH_USAGE[] = "Usage: penalty --ai-bench N [--seed S]\n";
+const int AI_BENCH_RETIMES = 5; // Reruns of a decision over budget, to tell a slow decision from a preempted one
+
+/**
+ * @brief Times one keeper decision: choose a dive, then learn the shot. Sets `dive`.
+ */
+static long timeAIDecision(OpponentModel &model, const TargetGrid &grid, SimRng &rng, Zone shot, Zone &dive)
+{
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    dive = chooseDive(model, grid, rng);
+    observeShot(model, grid, shot);
+    return (long)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin)
+        .count();
+}
+
+/**
+ * @brief Entry point for `--ai-bench N`: times N keeper decisions (choose, then learn the shot)
+ * per difficulty against a scripted human who changes habit halfway, and fails if the 99th
+ * percentile or the slowest decision is over AI_DECISION_BUDGET_NS.
+ *
+ * A decision that takes longer than the budget is rerun from the same model and RNG state, and
+ * keeps its fastest time. A decision that is slow in itself stays slow on every rerun; one that
+ * was only interrupted by the scheduler does not, so the maximum measures the AI, not the OS.
+ */
+int runAIBench(int argc, char **argv)
+{
+    uint64_t decisions = 0;
+    uint64_t seed = 1;
+    for (int i = 1; i + 1 < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--ai-bench") == 0)
+        {
+            if (!parseCount(argv[++i], decisions))
+            {
+                std::cerr << "Bad count for --ai-bench: " << argv[i] << "\n" << AI_BENCH_USAGE;
+                return 1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--seed") == 0)
+            seed = std::strtoull(argv[++i], NULL, 10);
+    }
+    if (decisions == 0)
+    {
+        std::cerr << AI_BENCH_USAGE;
+        return 1;
+    }
+    size_t count = (size_t)decisions;
+    const TargetGrid &grid = TARGET_GRIDS[CLASSIC_GRID];
+    const Zone habits[2][4] = {{LEFT, LEFT, RIGHT, MIDDLE}, {RIGHT, MIDDLE, RIGHT, LEFT}};
+    std::vector<long> samples(count);
+    bool within_budget = true;
+    for (int d = 0; d < DIFFICULTY_COUNT; d++)
+    {
+        OpponentModel model;
+        resetOpponentModel(model, (Difficulty)d);
+        SimRng rng(seed), human(seed ^ 0xD1B54A32D192ED03ULL);
+        size_t saves = 0, retimed = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            Zone shot = human.next() % 5 == 0 ? (Zone)(human.next() % 3) : habits[i >= count / 2][i % 4];
+            OpponentModel before = model;
+            SimRng rng_before = rng;
+            Zone dive;
+            samples[i] = timeAIDecision(model, grid, rng, shot, dive);
+            for (int r = 0; r < AI_BENCH_RETIMES && samples[i] > AI_DECISION_BUDGET_NS; r++)
+            {
+                OpponentModel rerun = before;
+                SimRng rerun_rng = rng_before;
+                Zone rerun_dive;
+                samples[i] = std::min(samples[i], timeAIDecision(rerun, grid, rerun_rng, shot, rerun_dive));
+                retimed++;
+            }
+            saves += dive == shot;
+        }
+        std::sort(samples.begin(), samples.end());
+        long p50 = samples[count / 2], p99 = samples[std::min(count - 1, count * 99 / 100)], max = samples[count - 1];
+        within_budget = within_budget && p99 <= AI_DECISION_BUDGET_NS && max <= AI_DECISION_BUDGET_NS;
+        std::cout << DIFFICULTY_TUNING[d].name << ": p50 " << p50 << " ns, p99 " << p99 << " ns, max " << max
+                  << " ns (" << retimed << " reruns); guessed " << 100.0 * saves / count << "% of shots (33.3% blind)\n";
+    }
+    std::cout << "Budget:       " << AI_DECISION_BUDGET_NS << " ns per decision at p99 and max: "
+              << (within_budget ? "OK" : "OVER") << "\n";
+    return within_budget ? 0 : 1;
+}
+
+// --- Match Hosting ---
+// Ticks many full matches (states, animation steps and all) in one process through the same
+// batch functions the window uses, as a game server hosting cabinets or spectator feeds would.
+
+/**
+ * @brief One server tick at SIM_STEPS_PER_SECOND: bots press keys for every waiting match, then
+ * each batch stage runs across the whole array. Returns the number of matches that finished.
+ */
+static uint64_t hostTick(std::vector<Match> &matches, SimRng &bots)
+{
+    uint64_t finished = 0;
+    for (size_t i = 0; i < matches.size(); i++)
+    {
+        Match &m = matches[i];
+        const TargetGrid &grid = matchGrid(m);
+        if (m.state == WAITING_FOR_SHOT || m.state == WAITING_FOR_DIVE)
+            applyMatchKey(m, grid.keys[bots.next() % grid.zones]);
+        else if (m.state == INTRO || m.state == GAME_OVER)
+        {
+            finished += m.state == GAME_OVER;
+            applyMatchKey(m, ' ');
+        }
+    }
+    startAnimation(matches.data(), matches.size());
+    updateGameLogic(matches.data(), matches.size());
+    advanceRound(matches.data(), matches.size());
+    return finished;
+}
+
+const char HOST_USAGE[] =
+    "Usage: penalty --host-matches N [--seconds S] [--seed S] [--difficulty easy|normal|hard] [--grid 3x1|3x2|3x3]\n";
+
+/**
+ * @brief Entry point for `--host-matches N`: runs N concurrent matches flat out for a while and
+ * reports tick cost and how many matches per tick fit in the real-time step budget.
+ */
+int runHost(int argc, char **argv)
+{
+    size_t count = 0;
+    double duration = 5.0;
+    uint64_t seed = (uint64_t)time(NULL);
+    Difficulty difficulty = DIFFICULTY_NORMAL;
+    unsigned char grid = CLASSIC_GRID;
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!value)
+        {
+            std::cerr << "Missing value for " << arg << "\n";
+            return 1;
+        }
+        if (std::strcmp(arg, "--host-matches") == 0)
+        {
+            uint64_t matches = 0;
+            if (!parseCount(value, matches))
+            {
+                std::cerr << "Bad count for --host-matches: " << value << "\n" << HOST_USAGE;
+                return 1;
+            }
+            count = (size_t)matches;
+        }
+        else if (std::strcmp(arg, "--seconds") == 0)
+            duration = std::atof(value);
+        else if (std::strcmp(arg, "--seed") == 0)
+            seed = std::strtoull(value, NULL, 10);
+        else if (std::strcmp(arg, "--difficulty") == 0)
+        {
+            if (!parseDifficulty(value, difficulty))
+            {
+                std::cerr << "Difficulty must be easy, normal or hard\n";
+                return 1;
+            }
+        }
+        else if (std::strcmp(arg, "--grid") == 0)
+        {
+            if (!parseTargetGrid(value, grid))
+            {
+                std::cerr << "Grid must be 3x1, 3x2 or 3x3\n";
+                return 1;
+            }
+        }
+        else
+        {
+            std::cerr << "Unknown option: " << arg << "\n";
+            return 1;
+        }
+        i++;
+    }
+    if (count == 0)
+    {
+        std::cerr << HOST_USAGE;
+        return 1;
+    }
+    offscreen_mode = true; // No window: nothing here may touch GLUT
+
+    std::vector<Match> matches(count);
+    opponentModels.resize(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        matches[i].rng = SimRng(seed + 0x9E3779B97F4A7C15ULL * (i + 1));
+        matches[i].ai_model = (unsigned)i;
+        resetOpponentModel(aiModel(matches[i]), difficulty);
+        matches[i].grid = grid;
+        resetMatch(matches[i]);
+    }
+    SimRng bots(seed ^ 0xD1B54A32D192ED03ULL);
+    uint64_t ticks = 0, finished = 0;
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    double seconds = 0.0;
+    while (seconds < duration)
+    {
+        for (int i = 0; i < SIM_STEPS_PER_SECOND; i++)
+            finished += hostTick(matches, bots);
+        ticks += SIM_STEPS_PER_SECOND;
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    }
+    double tick_us = seconds * 1e6 / ticks;
+    std::cout << "Matches:      " << count << " (" << sizeof(Match) << " bytes each)\n";
+    std::cout << "Ticks:        " << ticks << " in " << seconds << " s (" << tick_us << " us/tick, "
+              << tick_us * 1000.0 / count << " ns/match)\n";
+    std::cout << "Finished:     " << finished << " matches (" << finished / seconds << "/s)\n";
+    std::cout << "Real time:    " << (uint64_t)(count * SIM_STEP_SECONDS * 1e6 / tick_us)
+              << " matches fit in one " << SIM_STEPS_PER_SECOND << " Hz step on this thread\n";
+    return 0;
+}
+
+// --- Netplay ---
+// Two processes play each other over UDP: the host takes the player's side of a Match and the
+// guest the AI's. Both run the same Match in lockstep at SIM_STEPS_PER_SECOND and exchange only
+// key events, each stamped with the tick it applies on. Neither side ever waits for the other: a
+// tick the peer has not been heard from yet is simulated as "no key", and when a key for an
+// earlier tick arrives the match is rewound to the last state both sides agree on and
+// re-simulated to the present (rollback). Local keys may also be held for a few ticks of input
+// delay, so they usually reach the peer before they are due and nothing needs rolling back.
+
+struct NetConfig
+{
+    int side;             // 0 hosts, 1 joins; -1 when not playing online
+    const char *peer;     // Host to join, "name:port"
+    int port;             // Port to host on
+    int input_delay;      // Ticks a local key waits before it applies
+    double delay_seconds; // Artificial one-way delay added to everything this side sends
+    double loss;          // Artificial share of packets this side drops, 0 to 1
+    uint64_t seed;        // Host only; sent to the guest
+    unsigned char grid;   // Host only; sent to the guest
+};
+
+const char NETPLAY_USAGE[] = "Netplay options: --netplay host|join [--peer HOST:PORT] [--port N] [--input-delay TICKS]\n"
+                             "                 [--net-delay MS] [--net-loss PCT] [--seed S] [--grid 3x1|3x2|3x3]\n";
+const uint64_t NET_MAX_INPUT_DELAY = SIM_STEPS_PER_SECOND; // A second of delay is already unplayable
+
+/**
+ * @brief True if `arg` is one of the options parseNetOption() reads.
+ */
+bool isNetOption(const char *arg)
+{
+    const char *const options[] = {"--netplay", "--peer", "--port", "--input-delay", "--net-delay", "--net-loss",
+                                   "--seed", "--grid"};
+    for (size_t i = 0; i < sizeof(options) / sizeof(options[0]); i++)
+        if (std::strcmp(arg, options[i]) == 0)
+            return true;
+    return false;
+}
+
+/**
+ * @brief Reads one of the isNetOption() options and its value. Returns false if the value is bad,
+ * after reporting it with the usage lines.
+ */
+bool parseNetOption(NetConfig &config, const char *arg, const char *value)
+{
+    bool ok = true;
+    uint64_t count = 0;
+    double amount = 0.0;
+    if (std::strcmp(arg, "--netplay") == 0)
+    {
+        config.side = std::strcmp(value, "host") == 0 ? 0 : (std::strcmp(value, "join") == 0 ? 1 : -1);
+        ok = config.side >= 0;
+    }
+    else if (std::strcmp(arg, "--peer") == 0)
+        config.peer = value;
+    else if (std::strcmp(arg, "--port") == 0)
+    {
+        ok = parseCount(value, count) && count <= 65535;
+        config.port = (int)count;
+    }
+    else if (std::strcmp(arg, "--input-delay") == 0)
+    {
+        ok = std::strcmp(value, "0") == 0 || (parseCount(value, count) && count <= NET_MAX_INPUT_DELAY);
+        config.input_delay = (int)count;
+    }
+    else if (std::strcmp(arg, "--net-delay") == 0)
+    {
+        ok = parseAmount(value, amount);
+        config.delay_seconds = amount / 1000.0;
+    }
+    else if (std::strcmp(arg, "--net-loss") == 0)
+    {
+        ok = parseAmount(value, amount) && amount <= 100.0;
+        config.loss = amount / 100.0;
+    }
+    else if (std::strcmp(arg, "--seed") == 0)
+        config.seed = std::strtoull(value, NULL, 10);
+    else if (std::strcmp(arg, "--grid") == 0)
+        ok = parseTargetGrid(value, config.grid);
+    if (!ok)
+        std::cerr << "Bad value for " << arg << ": " << value << "\n" << NETPLAY_USAGE;
+    return ok;
+}
+
+NetConfig defaultNetConfig()
+{
+    NetConfig config = {-1, NULL, 7777, 2, 0.0, 0.0, (uint64_t)time(NULL), CLASSIC_GRID};
+    return config;
+}
+
+#ifdef PENALTY_HAS_SOCKETS
+const char NET_MAGIC[4] = {'P', 'S', 'N', 'P'};
+enum NetPacketType : unsigned char
+{
+    NET_HELLO,   // Guest to host until welcomed
+    NET_WELCOME, // Host to guest: seed (8 bytes) | target grid
+    NET_INPUT    // See sendNetInputs()
+};
+const uint32_t NET_MAX_PREDICTION = 2 * SIM_STEPS_PER_SECOND; // Ticks run unconfirmed before waiting
+const uint32_t NET_HASH_INTERVAL = SIM_STEPS_PER_SECOND / 4;  // Confirmed states are compared this often
+const int NET_HASH_HISTORY = 64;
+const size_t NET_MAX_EVENTS_PER_PACKET = 64;
+const double NET_RESEND_SECONDS = 0.05; // Inputs repeat at least this often, so a lost packet costs little
+const double NET_TIMEOUT_SECONDS = 5.0;
+
+struct NetEvent
+{
+    uint32_t tick;
+    unsigned char key;
+};
+
+struct NetHash
+{
+    uint32_t tick;
+    uint32_t value;
+    bool valid, compared;
+};
+
+struct DelayedPacket
+{
+    std::chrono::steady_clock::time_point due;
+    std::vector<unsigned char> bytes;
+};
+
+struct NetPress
+{
+    uint32_t tick;
+    std::chrono::steady_clock::time_point time;
+    LatencyKind kind;
+};
+
+struct NetSession
+{
+    NetConfig config;
+    int fd;
+    sockaddr_in remote;
+    bool connected;
+    std::chrono::steady_clock::time_point start, last_heard, last_sent;
+    std::vector<DelayedPacket> outgoing;
+    SimRng loss_rng;
+    std::vector<NetEvent> local_events, remote_events; // Only ticks from confirmed_ticks on
+    std::vector<NetPress> presses;                     // Local keys not yet on screen
+    uint32_t next_tick;       // Ticks simulated into `match`, confirmed or predicted
+    uint32_t confirmed_ticks; // Ticks simulated into `confirmed`, with both sides' keys known
+    uint32_t remote_known;    // The peer's keys are final for ticks below this
+    uint32_t remote_acked;    // The peer has our keys for ticks below this
+    uint32_t remote_next_tick;
+    int remote_advantage;     // How far the peer thinks it is ahead of us, in ticks
+    uint32_t rollback_from;   // Earliest late remote key since the last rollback; UINT32_MAX if none
+    int64_t clock_offset;     // Ticks the clock was held back: stalls plus time sync
+    Match confirmed;
+    NetHash local_hashes[NET_HASH_HISTORY], remote_hashes[NET_HASH_HISTORY];
+    int matches_finished;
+    uint64_t packets_sent, packets_dropped, packets_received;
+    uint64_t rollbacks, rollback_ticks, stall_ticks, sync_ticks, hashes_compared, desyncs;
+    std::vector<double> local_latency_ms, remote_late_ms;
+};
+NetSession net;
+
+static void putU32(std::vector<unsigned char> &out, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+        out.push_back((unsigned char)(value >> (8 * i)));
+}
+
+static uint32_t getU32(const unsigned char *in)
+{
+    return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+static std::vector<unsigned char> netPacket(NetPacketType type)
+{
+    std::vector<unsigned char> bytes(NET_MAGIC, NET_MAGIC + sizeof(NET_MAGIC));
+    bytes.push_back(type);
+    return bytes;
+}
+
+/**
+ * @brief Sends now, or after the artificial delay; the artificial loss drops packets here.
+ */
+static void sendNetPacket(const std::vector<unsigned char> &bytes)
+{
+    net.packets_sent++;
+    net.last_sent = std::chrono::steady_clock::now();
+    if (net.config.loss > 0.0 && net.loss_rng.nextFloat() < net.config.loss)
+    {
+        net.packets_dropped++;
+        return;
+    }
+    DelayedPacket packet = {net.last_sent + std::chrono::microseconds((long long)(net.config.delay_seconds * 1e6)), bytes};
+    net.outgoing.push_back(packet);
+}
+
+static void flushNetPackets()
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    size_t sent = 0;
+    while (sent < net.outgoing.size() && net.outgoing[sent].due <= now)
+    {
+        const std::vector<unsigned char> &bytes = net.outgoing[sent++].bytes;
+        sendto(net.fd, (const char *)&bytes[0], bytes.size(), 0, (const sockaddr *)&net.remote, sizeof(net.remote));
+    }
+    net.outgoing.erase(net.outgoing.begin(), net.outgoing.begin() + sent);
+}
+
+/**
+ * @brief Checksum of everything a tick can change, for catching desyncs between the peers.
+ */
+static uint32_t hashMatch(const Match &m)
+{
+    uint32_t words[13] = {(uint32_t)m.state, (uint32_t)m.animation_steps, (uint32_t)m.player_goals,
+                          (uint32_t)m.ai_goals, (uint32_t)m.current_round, (uint32_t)m.is_player_turn,
+                          m.versus_ready, (uint32_t)m.rng.state, (uint32_t)(m.rng.state >> 32)};
+    std::memcpy(&words[9], &m.ball_x, sizeof(float));
+    std::memcpy(&words[10], &m.ball_z, sizeof(float));
+    std::memcpy(&words[11], &m.gk_x, sizeof(float));
+    std::memcpy(&words[12], &m.gk_y, sizeof(float));
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < 13; i++)
+        hash = (hash ^ words[i]) * 16777619u;
+    return hash;
+}
+
+static void compareNetHash(uint32_t tick)
+{
+    int slot = (int)(tick / NET_HASH_INTERVAL % NET_HASH_HISTORY);
+    NetHash &local = net.local_hashes[slot];
+    const NetHash &remote = net.remote_hashes[slot];
+    if (!local.valid || !remote.valid || local.tick != tick || remote.tick != tick || local.compared)
+        return;
+    local.compared = true;
+    net.hashes_compared++;
+    if (local.value != remote.value)
+    {
+        net.desyncs++;
+        std::cerr << "Netplay desync at tick " << tick << "\n";
+    }
+}
+
+/**
+ * @brief Runs one tick of `m`: the keys both sides stamped with `tick`, host first, then the
+ * kick and flight stages.
+ */
+static void simulateNetTick(Match &m, uint32_t tick)
+{
+    for (int side = 0; side < 2; side++)
+    {
+        const std::vector<NetEvent> &events = side == net.config.side ? net.local_events : net.remote_events;
+        for (size_t i = 0; i < events.size(); i++)
+            if (events[i].tick == tick)
+                applyVersusKey(m, side, events[i].key);
+    }
+    startAnimation(&m, 1);
+    updateGameLogic(&m, 1);
+}
+
+/**
+ * @brief Moves the confirmed state up to the newest tick both sides' keys are known for, then
+ * rolls `match` back onto it and re-simulates if a remote key landed in the predicted past.
+ */
+static void confirmNetTicks()
+{
+    uint32_t limit = std::min(net.remote_known, net.next_tick);
+    while (net.confirmed_ticks < limit)
+    {
+        GameState before = net.confirmed.state;
+        simulateNetTick(net.confirmed, net.confirmed_ticks);
+        net.confirmed_ticks++;
+        if (before != GAME_OVER && net.confirmed.state == GAME_OVER)
+            net.matches_finished++;
+        if (net.confirmed_ticks % NET_HASH_INTERVAL == 0)
+        {
+            NetHash &slot = net.local_hashes[net.confirmed_ticks / NET_HASH_INTERVAL % NET_HASH_HISTORY];
+            slot.tick = net.confirmed_ticks;
+            slot.value = hashMatch(net.confirmed);
+            slot.valid = true;
+            slot.compared = false;
+            compareNetHash(net.confirmed_ticks);
+        }
+    }
+    size_t keep = 0;
+    for (size_t i = 0; i < net.remote_events.size(); i++)
+        if (net.remote_events[i].tick >= net.confirmed_ticks)
+            net.remote_events[keep++] = net.remote_events[i];
+    net.remote_events.resize(keep);
+    keep = 0;
+    for (size_t i = 0; i < net.local_events.size(); i++)
+        if (net.local_events[i].tick >= std::min(net.confirmed_ticks, net.remote_acked))
+            net.local_events[keep++] = net.local_events[i]; // Also kept until the peer has them
+    net.local_events.resize(keep);
+
+    if (net.rollback_from == UINT32_MAX)
+        return;
+    match = net.confirmed;
+    for (uint32_t tick = net.confirmed_ticks; tick < net.next_tick; tick++)
+        simulateNetTick(match, tick);
+    net.rollbacks++;
+    net.rollback_ticks += net.next_tick - net.rollback_from;
+    net.rollback_from = UINT32_MAX;
+    requestRedraw(REDRAW_SCENE);
+}
+
+/**
+ * @brief Starts the lockstep clock from the shared seed; both sides start from the same state.
+ */
+static void beginNetMatch(uint64_t seed, unsigned char grid)
+{
+    net.connected = true;
+    net.start = net.last_heard = std::chrono::steady_clock::now();
+    match.rng = SimRng(seed);
+    match.grid = grid;
+    resetOpponentModel(aiModel(match), DIFFICULTY_NORMAL);
+    match.versus = true;
+    resetMatch(match);
+    net.confirmed = match;
+    requestRedraw(REDRAW_SCENE);
+}
+
+/**
+ * @brief Input packet: next_tick | advantage | known | acked | hash tick | hash | count | count x
+ * (tick | key), integers as 4-byte little endian. Carries every local key the peer has not
+ * acknowledged, so any later packet repairs a lost one.
+ */
+static void sendNetInputs()
+{
+    std::vector<unsigned char> bytes = netPacket(NET_INPUT);
+    putU32(bytes, net.next_tick);
+    putU32(bytes, (uint32_t)(int32_t)((int64_t)net.next_tick - net.remote_next_tick));
+    size_t known_at = bytes.size();
+    putU32(bytes, 0); // Filled in below
+    putU32(bytes, net.remote_known);
+    const NetHash &hash = net.local_hashes[net.confirmed_ticks / NET_HASH_INTERVAL % NET_HASH_HISTORY];
+    putU32(bytes, hash.valid ? hash.tick : 0);
+    putU32(bytes, hash.value);
+    size_t count_at = bytes.size();
+    bytes.push_back(0);
+    uint32_t known = net.next_tick + net.config.input_delay;
+    for (size_t i = 0; i < net.local_events.size(); i++)
+    {
+        const NetEvent &event = net.local_events[i];
+        if (event.tick < net.remote_acked || event.tick >= known)
+            continue;
+        if (bytes[count_at] == NET_MAX_EVENTS_PER_PACKET)
+        {
+            known = event.tick; // Only claim what this packet fully covers
+            break;
+        }
+        putU32(bytes, event.tick);
+        bytes.push_back(event.key);
+        bytes[count_at]++;
+    }
+    for (int i = 0; i < 4; i++)
+        bytes[known_at + i] = (unsigned char)(known >> (8 * i));
+    sendNetPacket(bytes);
+}
+
+static void receiveNetInputs(const unsigned char *data, size_t size)
+{
+    if (size < 25 || size < 25 + (size_t)data[24] * 5)
+        return;
+    net.remote_next_tick = std::max(net.remote_next_tick, getU32(data));
+    net.remote_advantage = (int32_t)getU32(data + 4);
+    uint32_t known = getU32(data + 8);
+    net.remote_acked = std::max(net.remote_acked, getU32(data + 12));
+    uint32_t hash_tick = getU32(data + 16);
+    if (hash_tick > 0)
+    {
+        NetHash &slot = net.remote_hashes[hash_tick / NET_HASH_INTERVAL % NET_HASH_HISTORY];
+        slot.tick = hash_tick;
+        slot.value = getU32(data + 20);
+        slot.valid = true;
+        compareNetHash(hash_tick);
+    }
+    for (int i = 0; i < data[24]; i++)
+    {
+        NetEvent event = {getU32(data + 25 + i * 5), data[29 + i * 5]};
+        if (event.tick < net.remote_known)
+            continue; // Already have it
+        net.remote_events.push_back(event);
+        uint32_t late = event.tick < net.next_tick ? net.next_tick - event.tick : 0;
+        net.remote_late_ms.push_back(late * SIM_STEP_SECONDS * 1000.0);
+        if (late)
+            net.rollback_from = std::min(net.rollback_from, event.tick);
+    }
+    net.remote_known = std::max(net.remote_known, known);
+}
+
+static void receiveNetPackets()
+{
+    unsigned char buffer[1500];
+    sockaddr_in from;
+    socklen_t from_size = sizeof(from);
+    ssize_t n;
+    while ((n = recvfrom(net.fd, (char *)buffer, sizeof(buffer), 0, (sockaddr *)&from, &from_size)) > 0)
+    {
+        from_size = sizeof(from);
+        if (n < 5 || std::memcmp(buffer, NET_MAGIC, sizeof(NET_MAGIC)) != 0)
+            continue;
+        if (net.connected && (from.sin_addr.s_addr != net.remote.sin_addr.s_addr || from.sin_port != net.remote.sin_port))
+            continue; // Someone else; one opponent per session
+        net.packets_received++;
+        net.last_heard = std::chrono::steady_clock::now();
+        if (buffer[4] == NET_HELLO && net.config.side == 0)
+        {
+            if (!net.connected)
+            {
+                net.remote = from;
+                beginNetMatch(net.config.seed, net.config.grid);
+                std::cerr << "Guest joined\n";
+            }
+            std::vector<unsigned char> bytes = netPacket(NET_WELCOME); // Repeated if the first was lost
+            putU32(bytes, (uint32_t)net.config.seed);
+            putU32(bytes, (uint32_t)(net.config.seed >> 32));
+            bytes.push_back(net.config.grid);
+            sendNetPacket(bytes);
+        }
+        else if (buffer[4] == NET_WELCOME && net.config.side == 1 && !net.connected && n >= 14 &&
+                 buffer[13] < TARGET_GRID_COUNT)
+        {
+            beginNetMatch(getU32(buffer + 5) | ((uint64_t)getU32(buffer + 9) << 32), buffer[13]);
+            std::cerr << "Joined host\n";
+        }
+        else if (buffer[4] == NET_INPUT && net.connected)
+            receiveNetInputs(buffer + 5, (size_t)n - 5);
+    }
+    confirmNetTicks();
+}
+
+/**
+ * @brief Opens the socket: the host binds --port, the guest resolves --peer and says hello.
+ */
+bool startNetplay(const NetConfig &config)
+{
+    net.config = config;
+    net.fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (net.fd < 0)
+    {
+        std::cerr << "Cannot open a UDP socket\n";
+        return false;
+    }
+    fcntl(net.fd, F_SETFL, fcntl(net.fd, F_GETFL, 0) | O_NONBLOCK);
+    std::memset(&net.remote, 0, sizeof(net.remote));
+    if (config.side == 0)
+    {
+        sockaddr_in local;
+        std::memset(&local, 0, sizeof(local));
+        local.sin_family = AF_INET;
+        local.sin_addr.s_addr = htonl(INADDR_ANY);
+        local.sin_port = htons((unsigned short)config.port);
+        if (bind(net.fd, (const sockaddr *)&local, sizeof(local)) != 0)
+        {
+            std::cerr << "Cannot listen on UDP port " << config.port << "\n";
+            return false;
+        }
+        std::cerr << "Hosting on UDP port " << config.port << "; waiting for a guest\n";
+    }
+    else
+    {
+        std::string peer = config.peer ? config.peer : "";
+        size_t colon = peer.rfind(':');
+        addrinfo hints, *found = NULL;
+        std::memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_DGRAM;
+        if (colon == std::string::npos ||
+            getaddrinfo(peer.substr(0, colon).c_str(), peer.substr(colon + 1).c_str(), &hints, &found) != 0)
+        {
+            std::cerr << "--netplay join needs --peer HOST:PORT\n";
+            return false;
+        }
+        std::memcpy(&net.remote, found->ai_addr, sizeof(net.remote));
+        freeaddrinfo(found);
+    }
+    net.connected = false;
+    net.loss_rng = SimRng(config.seed ^ (0xA24BAED4963EE407ULL * (config.side + 1)));
+    net.next_tick = net.confirmed_ticks = net.remote_known = net.remote_acked = net.remote_next_tick = 0;
+    net.remote_advantage = 0;
+    net.rollback_from = UINT32_MAX;
+    net.clock_offset = 0;
+    net.last_heard = net.last_sent = std::chrono::steady_clock::now();
+    netplay_side = config.side;
+    match.versus = true;
+    resetMatch(match);
+    return true;
+}
+
+/**
+ * @brief Queues a local key for tick next_tick + input_delay. Only keys the match uses are sent.
+ */
+void queueNetKey(unsigned char key)
+{
+    std::chrono::steady_clock::time_point arrival = std::chrono::steady_clock::now();
+    key = tolower(key);
+    if (!net.connected || (matchGrid(match).key_zone[key] == NO_ZONE && key != ' ' && key != '\r'))
+        return;
+    NetEvent event = {net.next_tick + net.config.input_delay, key};
+    net.local_events.push_back(event);
+    NetPress press = {event.tick, arrival, latencyKind(match, net.config.side)};
+    net.presses.push_back(press);
+}
+
+/**
+ * @brief Receives, runs every tick that is due on the lockstep clock and sends this side's keys.
+ * Returns false once the peer has been silent for NET_TIMEOUT_SECONDS.
+ */
+bool pumpNetplay()
+{
+    receiveNetPackets();
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (!net.connected)
+    {
+        if (net.config.side == 1 && std::chrono::duration<double>(now - net.last_sent).count() >= 0.1)
+            sendNetPacket(netPacket(NET_HELLO));
+        flushNetPackets();
+        return true; // The host waits for a guest as long as it takes
+    }
+    double clock_ticks = std::chrono::duration<double>(now - net.start).count() * SIM_STEPS_PER_SECOND - net.clock_offset;
+    uint32_t due = (uint32_t)std::max(0.0, clock_ticks);
+    bool ticked = false;
+    // Time sync: a side that runs ahead of its peer sees every remote key late, so it eases off
+    int lead = ((int)((int64_t)net.next_tick - net.remote_next_tick) - net.remote_advantage) / 2;
+    while (net.next_tick < due)
+    {
+        if (net.next_tick - net.confirmed_ticks >= NET_MAX_PREDICTION)
+        {
+            net.stall_ticks += due - net.next_tick;
+            net.clock_offset += due - net.next_tick;
+            break;
+        }
+        if (lead > 1 && net.next_tick % 16 == 0 && !ticked)
+        {
+            net.sync_ticks++;
+            net.clock_offset++;
+            break;
+        }
+        Match before = match;
+        simulateNetTick(match, net.next_tick);
+        net.next_tick++;
+        ticked = true;
+        bool net_moved = stepNetCloth(netCloth, match) > 0.0;
+        if (match.state == SHOT_IN_PROGRESS || net_moved)
+            requestRedraw(REDRAW_SCENE);
+        else if (match.state != before.state || match.versus_ready != before.versus_ready)
+            requestRedraw(redrawForChange(before, match));
+    }
+    size_t shown = 0;
+    for (; shown < net.presses.size() && net.presses[shown].tick < net.next_tick; shown++)
+    {
+        net.local_latency_ms.push_back(std::chrono::duration<double>(now - net.presses[shown].time).count() * 1000.0);
+        noteInputApplied(net.presses[shown].time, net.presses[shown].kind);
+    }
+    net.presses.erase(net.presses.begin(), net.presses.begin() + shown);
+    render_alpha = match.state == SHOT_IN_PROGRESS ? (float)std::min(1.0, std::max(0.0, clock_ticks - net.next_tick)) : 1.0f;
+    if (ticked || std::chrono::duration<double>(now - net.last_sent).count() >= NET_RESEND_SECONDS)
+        sendNetInputs();
+    flushNetPackets();
+    return std::chrono::duration<double>(now - net.last_heard).count() < NET_TIMEOUT_SECONDS;
+}
+
+/**
+ * @brief Prints link and latency statistics for the session so far.
+ */
+void printNetStats()
+{
+    std::cout << "Netplay:      " << (net.config.side == 0 ? "host" : "guest") << ", input delay "
+              << net.config.input_delay << " ticks, sending with " << net.config.delay_seconds * 1000.0
+              << " ms delay and " << net.config.loss * 100.0 << "% loss\n";
+    std::cout << "Matches:      " << net.matches_finished << " finished, score " << net.confirmed.player_goals << "-"
+              << net.confirmed.ai_goals << " at tick " << net.confirmed_ticks << "\n";
+    std::cout << "Ticks:        " << net.next_tick << " (" << net.rollbacks << " rollbacks re-simulating "
+              << net.rollback_ticks << " ticks, " << net.stall_ticks << " stalled, " << net.sync_ticks
+              << " held for time sync)\n";
+    std::cout << "Packets:      " << net.packets_sent << " sent (" << net.packets_dropped << " dropped), "
+              << net.packets_received << " received\n";
+    std::cout << "Local keys:   " << net.local_latency_ms.size() << ", on screen after p50 "
+              << percentile(net.local_latency_ms, 0.5) << " ms, p99 " << percentile(net.local_latency_ms, 0.99)
+              << " ms\n";
+    std::cout << "Remote keys:  " << net.remote_late_ms.size() << ", arrived late by p50 "
+              << percentile(net.remote_late_ms, 0.5) << " ms, p99 " << percentile(net.remote_late_ms, 0.99)
+              << " ms (rolled back; the opponent's move skips ahead by this much)\n";
+    std::cout << "Checksums:    " << net.hashes_compared << " compared, " << net.desyncs << " mismatched\n";
+}
+
+#else
+bool startNetplay(const NetConfig &config)
+{
+    std::cerr << "--netplay needs BSD sockets, which this platform build does not include\n";
+    return false;
+}
+
+bool pumpNetplay()
+{
+    return false;
+}
+
+void queueNetKey(unsigned char key)
+{
+}
+
+void printNetStats()
+{
+}
+#endif
+
+/**
+ * @brief GLUT idle callback while playing online.
+ */
+void netplayLoop()
+{
+    if (!pumpNetplay())
+    {
+        std::cerr << "Lost the connection to the other player\n";
+        printNetStats();
+        std::exit(1);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1)); // Ticks are 8 ms apart; no need to spin
+}
+
+void netplayKey(unsigned char key, int x, int y)
+{
+    (void)x;
+    (void)y;
+    queueNetKey(key);
+    if (inputLatency.low_latency && pumpNetplay() && pending_redraw)
+        renderScene(); // With --input-delay 0 a key already due is on screen before the next idle pass
+}
+
+const char NETPLAY_BOT_USAGE[] = "Usage: penalty --netplay-bot N --netplay host|join [netplay options]\n";
+
+/**
+ * @brief Entry point for `--netplay-bot N`: plays N online matches headlessly with both keys
+ * pressed by a bot after a human-like pause, then prints the link and latency statistics.
+ * Run one with `--netplay host` and one with `--netplay join` to test over loopback.
+ */
+int runNetplayBot(int argc, char **argv)
+{
+    NetConfig config = defaultNetConfig();
+    uint64_t matches = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!value)
+        {
+            std::cerr << "Missing value for " << arg << "\n";
+            return 1;
+        }
+        if (std::strcmp(arg, "--netplay-bot") == 0)
+        {
+            if (!parseCount(value, matches))
+            {
+                std::cerr << "Bad count for --netplay-bot: " << value << "\n" << NETPLAY_BOT_USAGE << NETPLAY_USAGE;
+                return 1;
+            }
+        }
+        else if (!isNetOption(arg))
+        {
+            std::cerr << "Unknown option: " << arg << "\n";
+            return 1;
+        }
+        else if (!parseNetOption(config, arg, value))
+            return 1;
+        i++;
+    }
+    if (matches == 0 || config.side < 0)
+    {
+        std::cerr << NETPLAY_BOT_USAGE << NETPLAY_USAGE;
+        return 1;
+    }
+#ifndef PENALTY_HAS_SOCKETS
+    return startNetplay(config) ? 0 : 1;
+#else
+    offscreen_mode = true;
+    if (!startNetplay(config))
+        return 1;
+    SimRng bot(config.seed * 0x9E3779B97F4A7C15ULL + config.side + 1);
+    GameState seen = INTRO;
+    double wait = 0.5;
+    std::chrono::steady_clock::time_point state_since = std::chrono::steady_clock::now(), finished_at;
+    bool done = false;
+    while (true)
+    {
+        if (!pumpNetplay())
+        {
+            std::cerr << "Lost the connection to the other player\n";
+            printNetStats();
+            return 1;
+        }
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (!done && (uint64_t)net.matches_finished >= matches)
+        {
+            done = true;
+            finished_at = now;
+        }
+        if (done && std::chrono::duration<double>(now - finished_at).count() > 1.0)
+            break; // Keep acknowledging for a moment so the peer can finish too
+        if (match.state != seen)
+        {
+            seen = match.state;
+            state_since = now;
+            wait = 0.2 + bot.nextFloat() * 0.6;
+        }
+        bool choosing = match.state == WAITING_FOR_SHOT || match.state == WAITING_FOR_DIVE;
+        bool pressed = !net.presses.empty() || (choosing && (match.versus_ready & (1 << config.side)));
+        if (net.connected && !done && !pressed && match.state != SHOT_IN_PROGRESS &&
+            std::chrono::duration<double>(now - state_since).count() >= wait)
+            queueNetKey(choosing ? matchGrid(match).keys[bot.next() % matchGrid(match).zones] : ' ');
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    printNetStats();
+    return net.desyncs ? 1 : 0;
+#endif
+}
+
+// --- Offscreen Rendering ---
+// Renders complete shootouts into an EGL pbuffer, with no window or display server, and streams
+// the frames as PPM or raw RGB24. Readback goes through a ring of pixel-pack buffers, so
+// glReadPixels for frame N returns immediately and frame N-2 is written while the GPU works.
+
+const int READBACK_DEPTH = 3;
+
+struct FrameSink
+{
+    FILE *out;
+    bool ppm;
+    int width, height;
+    GLuint pbos[READBACK_DEPTH];
+    uint64_t issued, written;
+    std::vector<unsigned char> flipped;
+};
+
+/**
+ * @brief Starts an asynchronous read of the finished frame into the next PBO in the ring.
+ */
+static void captureFrame(FrameSink &sink)
+{
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, sink.pbos[sink.issued % READBACK_DEPTH]);
+    glReadPixels(0, 0, sink.width, sink.height, GL_RGB, GL_UNSIGNED_BYTE, (GLvoid *)0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    sink.issued++;
+}
+
+/**
+ * @brief Maps the oldest in-flight PBO and writes it top row first. Returns false on a write error.
+ */
+static bool writeOldestFrame(FrameSink &sink)
+{
+    if (sink.written == sink.issued)
+        return true;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, sink.pbos[sink.written % READBACK_DEPTH]);
+    const unsigned char *pixels = (const unsigned char *)glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+    bool ok = pixels != NULL;
+    if (ok)
+    {
+        size_t row = (size_t)sink.width * 3;
+        for (int y = 0; y < sink.height; y++)
+            std::memcpy(&sink.flipped[(size_t)(sink.height - 1 - y) * row], pixels + (size_t)y * row, row);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        if (sink.ppm)
+            std::fprintf(sink.out, "P6\n%d %d\n255\n", sink.width, sink.height);
+        ok = std::fwrite(&sink.flipped[0], 1, sink.flipped.size(), sink.out) == sink.flipped.size();
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    sink.written++;
+    return ok;
+}
+
+struct AutoPlayer
+{
+    GameState state;
+    double held_seconds;
+    SimRng rng; // Kept apart from match.rng so the AI's draws match a recorded session
+};
+
+/**
+ * @brief Presses keys for both sides so an offscreen run plays a whole shootout unattended.
+ *
+ * Each state is held on screen for a while first, like a viewer would see it. Returns false
+ * once GAME_OVER has been shown.
+ */
+static bool autoPlay(AutoPlayer &player, double frame_seconds)
+{
+    if (match.state != player.state)
+    {
+        player.state = match.state;
+        player.held_seconds = 0.0;
+    }
+    player.held_seconds += frame_seconds;
+    const TargetGrid &grid = matchGrid(match);
+    if (match.state != SHOT_IN_PROGRESS && netClothActive(netCloth, match))
+        advanceSimulation(frame_seconds); // The net is still settling
+    switch (match.state)
+    {
+    case INTRO:
+        if (player.held_seconds >= 1.0)
+            handleInput(' ', 0, 0);
+        break;
+    case WAITING_FOR_SHOT:
+    case WAITING_FOR_DIVE:
+        if (player.held_seconds >= 0.5)
+            handleInput(grid.keys[player.rng.next() % grid.zones], 0, 0);
+        break;
+    case SHOT_IN_PROGRESS:
+        advanceSimulation(frame_seconds);
+        break;
+    case DISPLAY_RESULT:
+        if (player.held_seconds >= 1.0)
+            handleInput(' ', 0, 0);
+        break;
+    case GAME_OVER:
+        return player.held_seconds < 2.0;
+    }
+    return true;
+}
+
+/**
+ * @brief Handles the flags that pick the render path; returns false for anything else.
+ */
+static bool parseRenderPathFlag(const char *arg)
+{
+    if (std::strcmp(arg, "--gl-core") == 0)
+        gl_core_profile = true;
+    else if (std::strcmp(arg, "--fixed-function") == 0)
+        force_fixed_function = true;
+    else
+        return false;
+    return true;
+}
+
+#ifdef PENALTY_HAS_EGL
+/**
+ * @brief Creates a desktop-GL context on a width x height pbuffer, preferring the surfaceless
+ * Mesa platform (no X server) over the default display. With `core_profile` the context is GL 3.3
+ * core. Replaces (and destroys) any context this thread already has.
+ */
+static bool createOffscreenContext(int width, int height, bool core_profile)
+{
+    EGLDisplay display = EGL_NO_DISPLAY;
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (get_platform_display)
+        display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL))
+    {
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL))
+            return false;
+    }
+    const EGLint config_attribs[] = {EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                                     EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+                                     EGL_DEPTH_SIZE, 24, EGL_NONE};
+    EGLConfig config;
+    EGLint config_count = 0;
+    if (!eglBindAPI(EGL_OPENGL_API) || !eglChooseConfig(display, config_attribs, &config, 1, &config_count) ||
+        config_count == 0)
+        return false;
+    const EGLint surface_attribs[] = {EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE};
+    EGLSurface surface = eglCreatePbufferSurface(display, config, surface_attribs);
+    const EGLint core_attribs[] = {EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 3,
+                                   EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE};
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, core_profile ? core_attribs : NULL);
+    EGLContext previous = eglGetCurrentContext();
+    EGLSurface previous_surface = eglGetCurrentSurface(EGL_DRAW);
+    if (surface == EGL_NO_SURFACE || context == EGL_NO_CONTEXT || !eglMakeCurrent(display, surface, surface, context))
+        return false;
+    if (previous != EGL_NO_CONTEXT)
+    {
+        eglDestroyContext(display, previous);
+        eglDestroySurface(display, previous_surface);
+    }
+    return true;
+}
+#endif
+
+/**
+ * @brief Entry point for `--render-frames PATH`: plays one seeded shootout (or `--replay FILE`)
+ * through renderScene() at a fixed video frame rate and streams every frame to PATH ("-" for stdout).
+ */
+const char RENDER_FRAMES_USAGE[] =
+    "Usage: penalty --render-frames PATH|- [--format ppm|raw] [--size WxH] [--fps N] [--seed S] [--max-frames N]\n"
+    "       [--record FILE] [--replay FILE] [--difficulty easy|normal|hard] [--grid 3x1|3x2|3x3]\n";
+const uint64_t MAX_RENDER_FPS = 1000; // Highest --fps accepted
+
+int runOffscreen(int argc, char **argv)
+{
+    const char *path = NULL;
+    int width = 1280, height = 720, fps = 60;
+    uint64_t max_frames = 0;
+    unsigned int seed = (unsigned int)time(NULL);
+    bool ppm = true;
+    Difficulty difficulty = DIFFICULTY_NORMAL;
+    unsigned char grid = CLASSIC_GRID;
+    const char *record_path = NULL, *replay_path = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (parseRenderPathFlag(arg))
+            continue;
+        if (!value)
+        {
+            std::cerr << "Missing value for " << arg << "\n";
+            return 1;
+        }
+        if (std::strcmp(arg, "--render-frames") == 0)
+            path = value;
+        else if (std::strcmp(arg, "--size") == 0)
+        {
+            if (std::sscanf(value, "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0)
+            {
+                std::cerr << "Bad size: " << value << "\n";
+                return 1;
+            }
+        }
+        else if (std::strcmp(arg, "--fps") == 0)
+        {
+            uint64_t count = 0;
+            if (!parseCount(value, count) || count > MAX_RENDER_FPS)
+            {
+                std::cerr << "Bad count for --fps: " << value << "\n" << RENDER_FRAMES_USAGE;
+                return 1;
+            }
+            fps = (int)count;
+        }
+        else if (std::strcmp(arg, "--max-frames") == 0)
+        {
+            if (!parseCount(value, max_frames))
+            {
+                std::cerr << "Bad count for --max-frames: " << value << "\n" << RENDER_FRAMES_USAGE;
+                return 1;
+            }
+        }
+        else if (std::strcmp(arg, "--seed") == 0)
+            seed = (unsigned int)std::strtoul(value, NULL, 10);
+        else if (std::strcmp(arg, "--format") == 0)
+        {
+            if (std::strcmp(value, "ppm") != 0 && std::strcmp(value, "raw") != 0)
+            {
+                std::cerr << "Format must be ppm or raw\n";
+                return 1;
+            }
+            ppm = std::strcmp(value, "ppm") == 0;
+        }
+        else if (std::strcmp(arg, "--record") == 0)
+            record_path = value;
+        else if (std::strcmp(arg, "--replay") == 0)
+            replay_path = value;
+        else if (std::strcmp(arg, "--difficulty") == 0)
+        {
+            if (!parseDifficulty(value, difficulty))
+            {
+                std::cerr << "Difficulty must be easy, normal or hard\n";
+                return 1;
+            }
+        }
+        else if (std::strcmp(arg, "--grid") == 0)
+        {
+            if (!parseTargetGrid(value, grid))
+            {
+                std::cerr << "Grid must be 3x1, 3x2 or 3x3\n";
+                return 1;
+            }
+        }
+        else
+        {
+            std::cerr << "Unknown option: " << arg << "\n";
+            return 1;
+        }
+        i++;
+    }
+#ifndef PENALTY_HAS_EGL
+    (void)path;
+    (void)width;
+    (void)height;
+    (void)fps;
+    (void)max_frames;
+    (void)seed;
+    (void)ppm;
+    (void)difficulty;
+    (void)grid;
+    (void)record_path;
+    (void)replay_path;
+    std::cerr << "--render-frames needs EGL, which this platform build does not include\n";
+    return 1;
+#else
+    offscreen_mode = true;
+    Replay replay;
+    if (replay_path && !loadReplay(replay_path, replay))
+        return 1;
+    if (!createOffscreenContext(width, height, false))
+    {
+        std::cerr << "Could not create an offscreen EGL context\n";
+        return 1;
+    }
+    if (std::getenv("DISPLAY"))
+    {
+        glutInit(&argc, argv); // Only for the bitmap fonts; no window is created
+        glut_initialised = true;
+    }
+    else
+        std::cerr << "No DISPLAY: rendering without HUD text\n";
+    if (gl_core_profile)
+    {
+        if (glut_initialised)
+            rasterizeGlyphAtlas(glyphAtlasPixels); // The fonts need the compatibility context
+        if (!createOffscreenContext(width, height, true))
+        {
+            std::cerr << "Could not create an offscreen GL 3.3 core context\n";
+            return 1;
+        }
+    }
+    FILE *out = std::strcmp(path, "-") == 0 ? stdout : std::fopen(path, "wb");
+    if (!out)
+    {
+        std::cerr << "Cannot open " << path << " for writing\n";
+        return 1;
+    }
+
+    match.rng = SimRng(seed);
+    resetOpponentModel(aiModel(match), difficulty);
+    match.grid = grid;
+    if (record_path && !replay_path && !startReplayRecording(record_path, seed))
+        return 1;
+    initGraphics();
+    glEnable(GL_DEPTH_TEST);
+    glClearColor(0.0f, 0.2f, 0.4f, 1.0f);
+    reshape(width, height);
+    resetMatch(match);
+
+    FrameSink sink;
+    sink.out = out;
+    sink.ppm = ppm;
+    sink.width = width;
+    sink.height = height;
+    sink.issued = sink.written = 0;
+    sink.flipped.resize((size_t)width * height * 3);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glGenBuffers(READBACK_DEPTH, sink.pbos);
+    for (int i = 0; i < READBACK_DEPTH; i++)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, sink.pbos[i]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, sink.flipped.size(), NULL, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    AutoPlayer player = {INTRO, 0.0, SimRng((uint64_t)seed * 0x9E3779B97F4A7C15ULL)};
+    double frame_seconds = 1.0 / fps;
+    double replay_tail_seconds = 0.0; // Final frame stays up for 2 s, as with the autoplayer
+    bool ok = true;
+    if (replay_path)
+        beginReplay(replay, 1.0);
+    requestRedraw(REDRAW_SCENE);
+    for (uint64_t frame = 0; ok && (max_frames == 0 || frame < max_frames); frame++)
+    {
+        renderScene();
+        if (sink.issued - sink.written == (uint64_t)READBACK_DEPTH)
+            ok = writeOldestFrame(sink);
+        captureFrame(sink);
+        recorder.offscreen_seconds += frame_seconds;
+        if (replay_path)
+        {
+            if (!advanceReplay(frame_seconds) && (replay_tail_seconds += frame_seconds) >= 2.0)
+                break;
+        }
+        else if (!autoPlay(player, frame_seconds))
+            break;
+    }
+    if (recorder.out)
+        std::fclose(recorder.out);
+    while (ok && sink.written < sink.issued)
+        ok = writeOldestFrame(sink);
+    if (out != stdout)
+        std::fclose(out);
+    else
+        std::fflush(out);
+    if (!ok)
+    {
+        std::cerr << "Frame write failed\n";
+        return 1;
+    }
+    std::cerr << "Wrote " << sink.written << " frames (" << width << "x" << height << " @ " << fps
+              << " fps, final score " << match.player_goals << "-" << match.ai_goals << ")\n";
+    return 0;
+#endif
 }
 
-/**
- * @brief Reshape callback (Implementation unchanged)
- */
-void reshape(int w, int h)
+// --- Benchmarks ---
+// `--bench` times each batch stage of the state machine and full offscreen frames, and writes the
+// median of several runs as JSON. Given a baseline from an earlier run it compares every metric
+// and fails if any got slower than the threshold allows.
+
+const int BENCH_MATCHES = 4096;
+
+struct BenchMetric
 {
-    if (h == 0)
-        h = 1;
-    float aspect = (float)w / (float)h;
-    window_width = w;
-    window_height = h;
-    glViewport(0, 0, w, h);
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    gluPerspective(45.0f, aspect, 0.1f, 100.0f);
-    glMatrixMode(GL_MODELVIEW);
+    std::string name; // Unit suffix in the name; lower is always better
+    double value;
+};
+
+static double secondsSince(std::chrono::steady_clock::time_point begin)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
 }
 
 /**
- * @brief Utility function to draw 2D text overlay. (Implementation unchanged)
+ * @brief One run through a whole kick for BENCH_MATCHES matches, timing each stage. Fills
+ * `ns` with: applyMatchKey per key, startAnimation per kick, updateGameLogic per match step,
+ * advanceRound per match and handleInput per key.
  */
-void drawText_2D(float x, float y, const char string, void font)
+static void benchStateRun(std::vector<Match> &matches, uint64_t seed, double ns[5])
 {
-    glMatrixMode(GL_PROJECTION);
-    glPushMatrix();
-    glLoadIdentity();
-    gluOrtho2D(0, window_width, 0, window_height);
-    glMatrixMode(GL_MODELVIEW);
-    glPushMatrix();
-    glLoadIdentity();
-    glDisable(GL_DEPTH_TEST);
-    glDisable(GL_LIGHTING);
-    glColor3f(1.0f, 1.0f, 1.0f);
-    glRasterPos2f(x, y);
-    while (*string)
+    opponentModels.resize(matches.size());
+    for (size_t i = 0; i < matches.size(); i++)
     {
-        glutBitmapCharacter(font, *string++);
+        matches[i].rng = SimRng(seed + 0x9E3779B97F4A7C15ULL * (i + 1));
+        matches[i].ai_model = (unsigned)i;
+        resetOpponentModel(aiModel(matches[i]), DIFFICULTY_NORMAL);
+        resetMatch(matches[i]);
     }
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_LIGHTING);
-    glMatrixMode(GL_PROJECTION);
-    glPopMatrix();
-    glMatrixMode(GL_MODELVIEW);
-    glPopMatrix();
-}
-
-void renderScene()
-{
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glLoadIdentity();
+    const char *direction_keys = "lmr";
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < matches.size(); i++)
+    {
+        applyMatchKey(matches[i], ' ');
+        applyMatchKey(matches[i], 'x'); // Ignored keys are part of the real mix
+        applyMatchKey(matches[i], direction_keys[i % 3]);
+    }
+    ns[0] = secondsSince(begin) * 1e9 / (matches.size() * 3);
 
-    gluLookAt(
-        0.0f, 1.5f, KICKER_POS_Z + 3.0f,
-        0.0f, 0.8f, GOAL_LINE_Z + 1.0f,
-        0.0f, 1.0f, 0.0f);
+    begin = std::chrono::steady_clock::now();
+    startAnimation(matches.data(), matches.size());
+    ns[1] = secondsSince(begin) * 1e9 / matches.size();
 
-    drawScene();
+    begin = std::chrono::steady_clock::now();
+    for (int step = 0; step < TOTAL_ANIMATION_STEPS; step++)
+        updateGameLogic(matches.data(), matches.size());
+    ns[2] = secondsSince(begin) * 1e9 / ((double)matches.size() * TOTAL_ANIMATION_STEPS);
 
-    glPushMatrix();
-    glTranslatef(ball_x, ball_y, ball_z);
-    glColor3f(1.0f, 1.0f, 1.0f);
-    glutSolidSphere(BALL_RADIUS, 16, 16);
-    glColor3f(0.0f, 0.0f, 0.0f);
-    glDisable(GL_LIGHTING);
-    glutWireSphere(BALL_RADIUS * 1.01, 10, 10);
-    glEnable(GL_LIGHTING);
-    glPopMatrix();
+    begin = std::chrono::steady_clock::now();
+    advanceRound(matches.data(), matches.size());
+    ns[3] = secondsSince(begin) * 1e9 / matches.size();
 
-    if (game_state != INTRO)
+    // The window's path: one match, with redraw bookkeeping and the kick each direction key starts
+    const int cycles = 256;
+    match.rng = SimRng(seed);
+    resetOpponentModel(aiModel(match), DIFFICULTY_NORMAL);
+    begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < cycles; i++)
     {
-        if (is_player_turn)
-        {
-            drawPlayerFigure(GK_CENTER_X, GROUND_Y, KICKER_POS_Z, 0.0f, 0.0f, 1.0f, false); // Player Kicker
-            drawPlayerFigure(gk_x, GROUND_Y, gk_z, 1.0f, 0.0f, 0.0f, true);                 // AI GK
-        }
-        else
-        {
-            drawPlayerFigure(GK_CENTER_X, GROUND_Y, KICKER_POS_Z, 1.0f, 0.0f, 0.0f, false); // AI Kicker
-            drawPlayerFigure(gk_x, GROUND_Y, gk_z, 0.0f, 0.0f, 1.0f, true);                 // Player GK
-        }
+        resetMatch(match);
+        handleInput(' ', 0, 0);
+        handleInput('x', 0, 0);
+        handleInput(direction_keys[i % 3], 0, 0);
     }
-
-    drawUI();
-
-    glutSwapBuffers();
+    ns[4] = secondsSince(begin) * 1e9 / (cycles * 3);
+    resetMatch(match);
 }
 
 /**
- * @brief Handles keyboard input and related game state changes.
+ * @brief Fires a ball into the top corner of a settled net and times every cloth step from the
+ * impact until the net is still again, or two seconds pass. Returns microseconds per step.
  */
-void handleInput(unsigned char key, int x, int y)
+static double benchNetRun()
 {
-    key = tolower(key);
-    switch (game_state)
+    NetCloth cloth;
+    initNetCloth(cloth);
+    BallBatch ball;
+    ball.resize(1);
+    ball.px[0] = GOAL_WIDTH / 4;
+    ball.py[0] = GOAL_HEIGHT * 0.7f;
+    ball.pz[0] = GOAL_LINE_Z + 1.0f;
+    ball.vz[0] = -SHOT_MAX_SPEED;
+    ball.keeper_x[0] = 100.0f; // Out of the way
+    Match m = Match();
+    m.ball_x = ball.px[0];
+    m.ball_y = ball.py[0];
+    m.ball_z = ball.pz[0];
+    double total_us = 0.0;
+    int steps = 0;
+    for (int step = 0; step < 2 * SIM_STEPS_PER_SECOND; step++)
     {
-    case INTRO:
-        if (key == ' ')
-            game_state = WAITING_FOR_SHOT;
-        break;
-    case WAITING_FOR_SHOT:
-        if (key == 'l')
-            player_shot_choice = LEFT;
-        else if (key == 'm')
-            player_shot_choice = MIDDLE;
-        else if (key == 'r')
-            player_shot_choice = RIGHT;
-        else
-            break;
-        game_state = SHOT_IN_PROGRESS;
-        startAnimation();
-        break;
-    case WAITING_FOR_DIVE:
-        if (key == 'l')
-            player_dive_choice = LEFT;
-        else if (key == 'm')
-            player_dive_choice = MIDDLE;
-        else if (key == 'r')
-            player_dive_choice = RIGHT;
-        else
-            break;
-        game_state = SHOT_IN_PROGRESS;
-        startAnimation();
-        break;
-    case SHOT_IN_PROGRESS:
-        break; // Input ignored during animation
-    case DISPLAY_RESULT:
-        if (key == ' ')
-            advanceRound();
-        break; // advanceRound changes state
-    case GAME_OVER:
-        if (key == ' ' || key == 13)
+        m.prev_ball_x = m.ball_x;
+        m.prev_ball_y = m.ball_y;
+        m.prev_ball_z = m.ball_z;
+        stepBalls(ball, (float)SIM_STEP_SECONDS, true);
+        m.ball_x = ball.px[0];
+        m.ball_y = ball.py[0];
+        m.ball_z = ball.pz[0];
+        double us = stepNetCloth(cloth, m);
+        if (us > 0.0)
         {
-            resetGame();
-            game_state = WAITING_FOR_SHOT;
+            total_us += us;
+            steps++;
         }
-        break;
+        else if (steps)
+            break;
     }
-    glutPostRedisplay(); // Request redraw if state might have changed visually
+    return steps ? total_us / steps : 0.0;
+}
+
+static double median(std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    return values.empty() ? 0.0 : values[values.size() / 2];
 }
 
+#ifdef PENALTY_HAS_EGL
 /**
- * @brief Draws a more articulated player figure. (Implementation unchanged)
+ * @brief Plays `frames` frames of autoplayed kicks through renderScene(), finishing the GPU work
+ * of each, and splits the frame times into full redraws during a shot and scene-cache repaints.
+ * Shot frames also report the render queue's draw calls and state changes.
  */
-void drawPlayerFigure(float x, float y_base, float z, float r, float g, float b, bool is_goalkeeper)
+static void benchRenderRun(int frames, std::vector<double> &shot_ms, std::vector<double> &cached_ms,
+                           std::vector<double> &draw_calls, std::vector<double> &state_changes)
 {
-    glColor3f(r, g, b);
-    float head_radius = 0.15f;
-    float torso_height = PLAYER_HEIGHT * 0.4f;
-    float limb_length = PLAYER_HEIGHT * 0.3f;
-    float torso_width = PLAYER_BODY_WIDTH;
-    float torso_depth = PLAYER_BODY_DEPTH;
-    glPushMatrix();
-    glTranslatef(x, y_base + torso_height / 2.0f, z);
-    glScalef(torso_width, torso_height, torso_depth);
-    glutSolidCube(1.0);
-    glPopMatrix();
-    glColor3f(0.9f, 0.7f, 0.6f);
-    glPushMatrix();
-    glTranslatef(x, y_base + torso_height + head_radius * 0.8f, z);
-    glutSolidSphere(head_radius, 16, 16);
-    glPopMatrix();
-    glColor3f(r, g, b);
-    glPushMatrix();
-    glTranslatef(x + torso_width / 2.0f + limb_length / 2.0f, y_base + torso_height * 0.7f, z);
-    glScalef(limb_length, PLAYER_LIMB_THICKNESS, PLAYER_LIMB_THICKNESS);
-    glutSolidCube(1.0);
-    glPopMatrix();
-    glPushMatrix();
-    glTranslatef(x - torso_width / 2.0f - limb_length / 2.0f, y_base + torso_height * 0.7f, z);
-    glScalef(limb_length, PLAYER_LIMB_THICKNESS, PLAYER_LIMB_THICKNESS);
-    glutSolidCube(1.0);
-    glPopMatrix();
-    glColor3f(r * 0.5f, g * 0.5f, b * 0.5f);
-    glPushMatrix();
-    glTranslatef(x + torso_width * 0.2f, y_base + limb_length / 2.0f, z);
-    glScalef(PLAYER_LIMB_THICKNESS, limb_length, PLAYER_LIMB_THICKNESS);
-    glutSolidCube(1.0);
-    glPopMatrix();
-    glPushMatrix();
-    glTranslatef(x - torso_width * 0.2f, y_base + limb_length / 2.0f, z);
-    glScalef(PLAYER_LIMB_THICKNESS, limb_length, PLAYER_LIMB_THICKNESS);
-    glutSolidCube(1.0);
-    glPopMatrix();
+    const char *direction_keys = "lmr";
+    match.rng = SimRng(1);
+    resetOpponentModel(aiModel(match), DIFFICULTY_NORMAL);
+    resetMatch(match);
+    handleInput(' ', 0, 0);
+    for (int frame = 0; frame < frames; frame++)
+    {
+        bool in_flight = match.state == SHOT_IN_PROGRESS;
+        if (in_flight || netClothActive(netCloth, match))
+            advanceSimulation(1.0 / 60.0);
+        bool full_redraw = pending_redraw != 0 || !scene_cache_valid;
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        renderScene();
+        glFinish();
+        double ms = secondsSince(begin) * 1000.0;
+        if (in_flight)
+        {
+            shot_ms.push_back(ms);
+            draw_calls.push_back(renderQueue.last_frame.draw_calls);
+            state_changes.push_back(renderQueue.last_frame.state_changes);
+        }
+        else if (!full_redraw)
+            cached_ms.push_back(ms);
+        if (match.state == WAITING_FOR_SHOT || match.state == WAITING_FOR_DIVE)
+            handleInput(direction_keys[frame % 3], 0, 0);
+        else if (match.state != SHOT_IN_PROGRESS && !netCloth.awake && frame % 8 == 0)
+            handleInput(' ', 0, 0); // Results stay up until the net is still, so cached repaints get measured
+    }
 }
+#endif
+
 /**
- * @brief Helper function to set targets and start animation timer. (Implementation unchanged)
+ * @brief Reads the "metrics" object of a file written by writeBenchJson().
  */
-void startAnimation()
+static bool loadBenchBaseline(const char *path, std::vector<BenchMetric> &metrics)
 {
-    if (animation_steps != 0)
-        return;
-    animation_steps = 1;
-    if (is_player_turn)
+    std::ifstream in(path);
+    if (!in)
     {
-        ai_dive_choice = (Direction)(rand() % 3);
-        if (player_shot_choice == LEFT)
-            target_ball_x = GK_LEFT_X;
-        else if (player_shot_choice == RIGHT)
-            target_ball_x = GK_RIGHT_X;
-        else
-            target_ball_x = GK_CENTER_X;
-        if (ai_dive_choice == LEFT)
-            target_gk_x = GK_LEFT_X;
-        else if (ai_dive_choice == RIGHT)
-            target_gk_x = GK_RIGHT_X;
-        else
-            target_gk_x = GK_CENTER_X;
+        std::cerr << "Cannot open " << path << "\n";
+        return false;
     }
-    else
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    std::string text = buffer.str();
+    size_t pos = text.find("\"metrics\"");
+    if (pos == std::string::npos || (pos = text.find('{', pos)) == std::string::npos)
     {
-        ai_shot_choice = (Direction)(rand() % 3);
-        if (ai_shot_choice == LEFT)
-            target_ball_x = GK_LEFT_X;
-        else if (ai_shot_choice == RIGHT)
-            target_ball_x = GK_RIGHT_X;
-        else
-            target_ball_x = GK_CENTER_X;
-        if (player_dive_choice == LEFT)
-            target_gk_x = GK_LEFT_X;
-        else if (player_dive_choice == RIGHT)
-            target_gk_x = GK_RIGHT_X;
-        else
-            target_gk_x = GK_CENTER_X;
+        std::cerr << path << " has no metrics object\n";
+        return false;
+    }
+    size_t end = text.find('}', pos);
+    while (true)
+    {
+        size_t open = text.find('"', pos);
+        if (open == std::string::npos || open > end)
+            break;
+        size_t close = text.find('"', open + 1);
+        size_t colon = text.find(':', close);
+        if (close == std::string::npos || colon == std::string::npos || colon > end)
+            break;
+        BenchMetric metric;
+        metric.name = text.substr(open + 1, close - open - 1);
+        char *number_end = NULL;
+        metric.value = std::strtod(text.c_str() + colon + 1, &number_end);
+        if (number_end == text.c_str() + colon + 1)
+        {
+            std::cerr << path << ": bad value for " << metric.name << "\n";
+            return false;
+        }
+        metrics.push_back(metric);
+        pos = number_end - text.c_str();
     }
-    start_ball_x = ball_x;
-    start_ball_z = ball_z;
-    start_gk_x = gk_x;
-    glutTimerFunc(ANIMATION_TIMER_MS, updateGameLogic, 0); // Call the logic update function
+    return !metrics.empty();
 }
 
+static void writeBenchJson(std::ostream &out, const std::vector<BenchMetric> &metrics, int runs)
+{
+    out << "{\n  \"benchmark\": \"penalty-shootout\",\n  \"runs\": " << runs << ",\n  \"metrics\": {\n";
+    for (size_t i = 0; i < metrics.size(); i++)
+        out << "    \"" << metrics[i].name << "\": " << metrics[i].value << (i + 1 < metrics.size() ? ",\n" : "\n");
+    out << "  }\n}\n";
+}
+
+const char BENCH_USAGE[] = "Usage: penalty --bench OUT|- [--baseline FILE] [--threshold PCT] [--runs N] [--frames N]\n"
+                           "       [--size WxH] [--gl-core|--fixed-function]\n";
+const uint64_t BENCH_MAX_COUNT = 1000000; // Highest --runs or --frames accepted
+
 /**
- * @brief Draws the scoreboard and UI text. (Implementation unchanged)
+ * @brief Entry point for `--bench OUT`: measures everything, writes JSON to OUT ("-" for stdout)
+ * and, with `--baseline FILE`, returns non-zero if any metric regressed by more than `--threshold`
+ * percent.
  */
-void drawUI()
+int runBench(int argc, char **argv)
 {
-    if (game_state != INTRO)
+    const char *out_path = NULL, *baseline_path = NULL;
+    double threshold = 10.0;
+    int runs = 7, frames = 240, width = 1280, height = 720;
+    uint64_t seed = 1;
+    for (int i = 1; i < argc; i++)
     {
-        std::stringstream ss_round;
-        ss_round << "Round: " << current_round;
-        if (current_round > MAX_ROUNDS)
-            ss_round << " (SUDDEN DEATH)";
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (parseRenderPathFlag(arg))
+            continue;
+        if (!value)
+        {
+            std::cerr << "Missing value for " << arg << "\n";
+            return 1;
+        }
+        if (std::strcmp(arg, "--bench") == 0)
+            out_path = value;
+        else if (std::strcmp(arg, "--baseline") == 0)
+            baseline_path = value;
+        else if (std::strcmp(arg, "--threshold") == 0)
+        {
+            if (!parseAmount(value, threshold))
+            {
+                std::cerr << "Bad percentage for --threshold: " << value << "\n" << BENCH_USAGE;
+                return 1;
+            }
+        }
+        else if (std::strcmp(arg, "--runs") == 0)
+        {
+            uint64_t count = 0;
+            if (!parseCount(value, count) || count > BENCH_MAX_COUNT)
+            {
+                std::cerr << "Bad count for --runs: " << value << "\n" << BENCH_USAGE;
+                return 1;
+            }
+            runs = (int)count;
+        }
+        else if (std::strcmp(arg, "--frames") == 0)
+        {
+            uint64_t count = 0; // --frames 0 skips the render metrics
+            if (std::strcmp(value, "0") != 0 && (!parseCount(value, count) || count > BENCH_MAX_COUNT))
+            {
+                std::cerr << "Bad count for --frames: " << value << "\n" << BENCH_USAGE;
+                return 1;
+            }
+            frames = (int)count;
+        }
+        else if (std::strcmp(arg, "--seed") == 0)
+            seed = std::strtoull(value, NULL, 10);
+        else if (std::strcmp(arg, "--size") == 0)
+        {
+            if (std::sscanf(value, "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0)
+            {
+                std::cerr << "Bad size: " << value << "\n";
+                return 1;
+            }
+        }
         else
-            ss_round << " of " << MAX_ROUNDS;
-        drawText_2D(20, window_height - 30, ss_round.str().c_str(), GLUT_BITMAP_HELVETICA_18);
-        std::stringstream ss_score;
-        ss_score << "Player: " << player_goals << "  |  AI: " << ai_goals;
-        drawText_2D(window_width - 180, window_height - 30, ss_score.str().c_str(), GLUT_BITMAP_HELVETICA_18);
+        {
+            std::cerr << "Unknown option: " << arg << "\n";
+            return 1;
+        }
+        i++;
     }
-    float center_x = window_width / 2.0f;
-    float bottom_y = 50;
-    switch (game_state)
+    std::vector<BenchMetric> baseline;
+    if (baseline_path && !loadBenchBaseline(baseline_path, baseline))
+        return 1;
+    offscreen_mode = true;
+
+    const char *state_names[5] = {"apply_match_key_ns", "start_animation_ns", "update_game_logic_ns",
+                                  "advance_round_ns", "handle_input_ns"};
+    std::vector<double> state_samples[5];
+    std::vector<Match> matches(BENCH_MATCHES);
+    for (int run = 0; run < runs; run++)
     {
-    case INTRO:
-        drawText_2D(center_x - 100, center_x - 50, "PENALTY SHOOTOUT 3D", GLUT_BITMAP_TIMES_ROMAN_24);
-        drawText_2D(center_x - 110, center_x - 80, "Press SPACE to Start", GLUT_BITMAP_HELVETICA_18);
-        break;
-    case WAITING_FOR_SHOT:
-        drawText_2D(center_x - 50, window_height - 60, "PLAYER KICKS", GLUT_BITMAP_HELVETICA_18);
-        drawText_2D(center_x - 180, bottom_y, "Shoot Directly: [L] Left, [M] Middle, [R] Right", GLUT_BITMAP_HELVETICA_18);
-        break;
-    case WAITING_FOR_DIVE:
-        drawText_2D(center_x - 30, window_height - 60, "AI KICKS", GLUT_BITMAP_HELVETICA_18);
-        drawText_2D(center_x - 180, bottom_y, "Dive Directly: [L] Left, [M] Middle, [R] Right", GLUT_BITMAP_HELVETICA_18);
-        break;
-    case SHOT_IN_PROGRESS:
-        drawText_2D(center_x - 10, bottom_y, "...", GLUT_BITMAP_HELVETICA_18);
-        break;
-    case DISPLAY_RESULT:
-        if (last_shot_was_goal)
-            drawText_2D(center_x - 30, center_x, "GOAL!", GLUT_BITMAP_TIMES_ROMAN_24);
-        else
-            drawText_2D(center_x - 30, center_x, "SAVED!", GLUT_BITMAP_TIMES_ROMAN_24);
-        drawText_2D(center_x - 100, bottom_y, "Press SPACE to continue", GLUT_BITMAP_HELVETICA_18);
-        break;
-    case GAME_OVER:
-        drawText_2D(center_x - 70, center_x + 50, "--- GAME OVER ---", GLUT_BITMAP_TIMES_ROMAN_24);
-        std::stringstream ss_final;
-        ss_final << "Final Score: Player " << player_goals << " - " << ai_goals << " AI";
-        drawText_2D(center_x - 120, center_x + 20, ss_final.str().c_str(), GLUT_BITMAP_HELVETICA_18);
-        if (player_goals > ai_goals)
-            drawText_2D(center_x - 120, center_x - 10, "WORLD CLASS PERFORMANCE!", GLUT_BITMAP_HELVETICA_18);
-        else if (ai_goals > player_goals)
-            drawText_2D(center_x - 70, center_x - 10, "NEEDS PRACTICE!", GLUT_BITMAP_HELVETICA_18);
-        else
-            drawText_2D(center_x - 70, center_x - 10, "A TIE!", GLUT_BITMAP_HELVETICA_18);
-        drawText_2D(center_x - 140, bottom_y, "Press SPACE or ENTER to play again", GLUT_BITMAP_HELVETICA_18);
-        break;
+        double ns[5];
+        benchStateRun(matches, seed + run, ns);
+        for (int m = 0; m < 5; m++)
+            state_samples[m].push_back(ns[m]);
     }
-}
+    std::vector<BenchMetric> metrics;
+    for (int m = 0; m < 5; m++)
+    {
+        BenchMetric metric = {state_names[m], median(state_samples[m])};
+        metrics.push_back(metric);
+    }
+    std::vector<double> net_samples;
+    for (int run = 0; run < runs; run++)
+        net_samples.push_back(benchNetRun());
+    BenchMetric net_step = {"net_step_us", median(net_samples)};
+    metrics.push_back(net_step);
+    if (net_step.value > NET_STEP_BUDGET_US)
+        std::cerr << "net_step_us " << net_step.value << " is over its budget of " << NET_STEP_BUDGET_US << " us\n";
 
-/**
- * @brief Advances the game state. (Implementation unchanged)
- */
-void advanceRound()
-{
-    ball_x = GK_CENTER_X;
-    ball_y = BALL_Y;
-    ball_z = PENALTY_SPOT_Z;
-    gk_x = GK_CENTER_X;
-    gk_z = GOAL_LINE_Z;
-    gk_y = GROUND_Y + GK_BODY_Y_OFFSET;
-    animation_steps = 0;
-    player_dive_choice = NONE;
-    if (is_player_turn)
+#ifdef PENALTY_HAS_EGL
+    if (frames > 0 && createOffscreenContext(width, height, gl_core_profile))
     {
-        is_player_turn = false;
-        game_state = WAITING_FOR_DIVE;
+        initGraphics(); // No glutInit: HUD text is skipped so results do not depend on DISPLAY
+        glEnable(GL_DEPTH_TEST);
+        glClearColor(0.0f, 0.2f, 0.4f, 1.0f);
+        reshape(width, height);
+        std::vector<double> shot_ms, cached_ms, draw_calls, state_changes;
+        benchRenderRun(std::min(frames, 30), shot_ms, cached_ms, draw_calls, state_changes); // Warm-up
+        shot_ms.clear();
+        cached_ms.clear();
+        draw_calls.clear();
+        state_changes.clear();
+        for (int run = 0; run < runs; run++)
+            benchRenderRun(frames, shot_ms, cached_ms, draw_calls, state_changes);
+        BenchMetric shot = {"render_shot_frame_ms", median(shot_ms)};
+        BenchMetric cached = {"render_cached_frame_ms", median(cached_ms)};
+        metrics.push_back(shot);
+        metrics.push_back(cached);
+        if (renderQueue.active)
+        {
+            BenchMetric draws = {"render_shot_draw_calls", median(draw_calls)};
+            BenchMetric changes = {"render_shot_state_changes", median(state_changes)};
+            metrics.push_back(draws);
+            metrics.push_back(changes);
+        }
     }
+    else if (frames > 0)
+        std::cerr << "No offscreen EGL context: skipping render benchmarks\n";
+#else
+    if (frames > 0)
+        std::cerr << "No EGL in this build: skipping render benchmarks\n";
+#endif
+
+    bool to_stdout = !out_path || std::strcmp(out_path, "-") == 0;
+    if (to_stdout)
+        writeBenchJson(std::cout, metrics, runs);
     else
     {
-        is_player_turn = true;
-        if (current_round >= MAX_ROUNDS)
+        std::ofstream out(out_path);
+        writeBenchJson(out, metrics, runs);
+        if (!out)
         {
-            if (player_goals != ai_goals)
-                game_state = GAME_OVER;
-            else
-            {
-                current_round++;
-                game_state = WAITING_FOR_SHOT;
-            }
+            std::cerr << "Cannot write " << out_path << "\n";
+            return 1;
         }
-        else
+    }
+
+    std::ostream &report = to_stdout ? std::cerr : std::cout;
+    int regressions = 0, missing = 0;
+    for (size_t b = 0; b < baseline.size(); b++)
+    {
+        const BenchMetric *current = NULL;
+        for (size_t m = 0; m < metrics.size(); m++)
+            if (metrics[m].name == baseline[b].name)
+                current = &metrics[m];
+        report << baseline[b].name << ": ";
+        if (!current)
         {
-            current_round++;
-            game_state = WAITING_FOR_SHOT;
+            // A metric that silently stops being measured would otherwise hide any regression in it
+            report << baseline[b].value << " -> not measured MISSING\n";
+            missing++;
+            continue;
         }
+        double change = baseline[b].value > 0.0 ? (current->value / baseline[b].value - 1.0) * 100.0 : 0.0;
+        bool regressed = change > threshold;
+        regressions += regressed;
+        report << baseline[b].value << " -> " << current->value << " (" << (change >= 0.0 ? "+" : "") << change
+               << "%)" << (regressed ? " REGRESSED" : "") << "\n";
     }
+    if (baseline_path)
+        report << regressions << " of " << baseline.size() << " metrics regressed by more than " << threshold
+               << "%, " << missing << " missing from this run\n";
+    return regressions || missing ? 1 : 0;
 }
+
+// --- Simulation Stress Test ---
+// --sim-stress plays kicks in real time with every frame slowed by --render-delay, first with the
+// steps run between frames as the window does by default, then on the simulation thread, and
+// reports how late the fixed steps ran in each case.
+const double STRESS_TIMEOUT_SECONDS = 60.0;
+const uint64_t STRESS_MAX_KICKS = 100000; // Highest --kicks accepted
+const double MAX_RENDER_DELAY_MS = 1000.0; // Highest --render-delay accepted, here and in the window
+
+const char SIM_STRESS_USAGE[] =
+    "Usage: penalty --sim-stress [--kicks N] [--render-delay MS] [--seed S] [--size WxH] [--gl-core] [--fixed-function]\n";
+
 /**
- * @brief Resets game state variables. (Implementation unchanged)
+ * @brief Sets render_delay_ms from a --render-delay value; false unless it is a number of
+ * milliseconds up to MAX_RENDER_DELAY_MS.
  */
-void resetGame()
+bool parseRenderDelay(const char *text)
 {
-    player_goals = 0;
-    ai_goals = 0;
-    current_round = 1;
-    is_player_turn = true;
-    game_state = INTRO;
-    player_dive_choice = NONE;
-    player_shot_choice = MIDDLE;
-    ball_x = GK_CENTER_X;
-    ball_y = BALL_Y;
-    ball_z = PENALTY_SPOT_Z;
-    gk_x = GK_CENTER_X;
-    gk_y = GROUND_Y + GK_BODY_Y_OFFSET;
-    gk_z = GOAL_LINE_Z;
-    animation_steps = 0;
+    double delay = 0.0;
+    if (!parseAmount(text, delay) || delay > MAX_RENDER_DELAY_MS)
+        return false;
+    render_delay_ms = delay;
+    return true;
 }
 
+struct StressResult
+{
+    int frames;
+    double seconds;
+    std::vector<double> lateness_us;
+};
+
+#ifdef PENALTY_HAS_EGL
 /**
- * @brief Handles time-based updates, primarily animation.
+ * @brief Renders frames until `kicks` kicks have been resolved, pressing a key whenever the state on
+ * screen changes. Inline, the due steps run before each frame; threaded, on the simulation thread.
  */
-void updateGameLogic(int value)
+static StressResult stressRun(bool threaded, int kicks, uint64_t seed)
 {
-    if (game_state != SHOT_IN_PROGRESS || animation_steps == 0)
-        return;
-
-    if (animation_steps <= TOTAL_ANIMATION_STEPS)
+    match.rng = SimRng(seed);
+    resetOpponentModel(aiModel(match), DIFFICULTY_NORMAL);
+    resetMatch(match);
+    stepTiming.lateness_us.clear();
+    stepTiming.record = true;
+    if (threaded)
+        startSimThread();
+    SimRng keys(seed);
+    StressResult result = StressResult();
+    GameState shown = SHOT_IN_PROGRESS;
+    bool first = true;
+    int resolved = 0;
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    while (resolved < kicks && secondsSince(begin) < STRESS_TIMEOUT_SECONDS)
     {
-        float t = (float)animation_steps / (float)TOTAL_ANIMATION_STEPS;
-        float t_ball = t * t;
-        float t_gk = t;
-        ball_x = (1.0f - t_ball) * start_ball_x + t_ball * target_ball_x;
-        ball_z = (1.0f - t_ball) * start_ball_z + t_ball * GOAL_LINE_Z;
-        ball_y = BALL_Y;
-        gk_x = (1.0f - t_gk) * start_gk_x + t_gk * target_gk_x;
-        gk_y = GROUND_Y + GK_BODY_Y_OFFSET;
-        animation_steps++;
-        glutTimerFunc(ANIMATION_TIMER_MS, updateGameLogic, 0); // Continue loop
+        if (!threaded && (match.state == SHOT_IN_PROGRESS || netClothActive(netCloth, match)))
+        {
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            double elapsed = std::chrono::duration<double>(now - loop_last_time).count();
+            loop_last_time = now;
+            advanceSimulation(std::min(elapsed, MAX_FRAME_SECONDS)); // What gameLoop() does between frames
+        }
+        renderScene();
+        glFinish();
+        result.frames++;
+        if (match.state == shown && !first)
+            continue;
+        if (shown == SHOT_IN_PROGRESS && !first)
+            resolved++;
+        first = false;
+        shown = match.state;
+        const TargetGrid &grid = matchGrid(match);
+        if (shown == WAITING_FOR_SHOT || shown == WAITING_FOR_DIVE)
+            handleInput(grid.keys[keys.next() % grid.zones], 0, 0);
+        else if (shown != SHOT_IN_PROGRESS)
+            handleInput(' ', 0, 0);
     }
-    else
+    if (threaded)
+        stopSimThread();
+    result.seconds = secondsSince(begin);
+    result.lateness_us.swap(stepTiming.lateness_us);
+    stepTiming.record = false;
+    return result;
+}
+#endif
+
+static void printStressResult(const char *name, const StressResult &result)
+{
+    size_t late = 0;
+    for (size_t i = 0; i < result.lateness_us.size(); i++)
+        late += result.lateness_us[i] > SIM_STEP_SECONDS * 1e6;
+    std::printf("%-8s %5d frames (%5.1f fps)  %5zu shot steps  lateness p50 %6.2f ms  p99 %6.2f ms  max %6.2f ms"
+                "  %5.1f%% over one step\n",
+                name, result.frames, result.frames / std::max(result.seconds, 1e-9), result.lateness_us.size(),
+                percentile(result.lateness_us, 0.5) / 1000.0, percentile(result.lateness_us, 0.99) / 1000.0,
+                percentile(result.lateness_us, 1.0) / 1000.0,
+                result.lateness_us.empty() ? 0.0 : 100.0 * late / result.lateness_us.size());
+}
+
+/**
+ * @brief Entry point for --sim-stress: the inline and threaded simulation under the same slow
+ * renderer, offscreen.
+ */
+int runSimStress(int argc, char **argv)
+{
+    int kicks = 10, width = 640, height = 360;
+    uint64_t seed = 1;
+    render_delay_ms = 40.0;
+    for (int i = 1; i < argc; i++)
     {
-        // Animation finished: Determine result and change state
-        game_state = DISPLAY_RESULT;
-        ball_x = target_ball_x;
-        ball_z = GOAL_LINE_Z;
-        gk_x = target_gk_x;
-        if (is_player_turn)
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (std::strcmp(arg, "--sim-stress") == 0 || parseRenderPathFlag(arg))
+            continue;
+        if (!value)
+        {
+            std::cerr << "Missing value for " << arg << "\n";
+            return 1;
+        }
+        if (std::strcmp(arg, "--render-delay") == 0)
+        {
+            if (!parseRenderDelay(value))
+            {
+                std::cerr << "Bad delay for --render-delay: " << value << "\n" << SIM_STRESS_USAGE;
+                return 1;
+            }
+        }
+        else if (std::strcmp(arg, "--kicks") == 0)
+        {
+            uint64_t count = 0;
+            if (!parseCount(value, count) || count > STRESS_MAX_KICKS)
+            {
+                std::cerr << "Bad count for --kicks: " << value << "\n" << SIM_STRESS_USAGE;
+                return 1;
+            }
+            kicks = (int)count;
+        }
+        else if (std::strcmp(arg, "--seed") == 0)
+            seed = std::strtoull(value, NULL, 10);
+        else if (std::strcmp(arg, "--size") == 0)
         {
-            last_shot_was_goal = (player_shot_choice != ai_dive_choice);
-            if (last_shot_was_goal)
-                player_goals++;
+            if (std::sscanf(value, "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0)
+            {
+                std::cerr << "Bad size: " << value << "\n";
+                return 1;
+            }
         }
         else
         {
-            last_shot_was_goal = (ai_shot_choice != player_dive_choice);
-            if (last_shot_was_goal)
-                ai_goals++;
+            std::cerr << "Unknown option: " << arg << "\n";
+            return 1;
         }
+        i++;
     }
-    glutPostRedisplay(); // Request redraw after state change
+#ifndef PENALTY_HAS_EGL
+    (void)kicks;
+    (void)seed;
+    std::cerr << "--sim-stress needs EGL, which this platform build does not include\n";
+    return 1;
+#else
+    offscreen_mode = true;
+    if (!createOffscreenContext(width, height, gl_core_profile))
+        return 1;
+    initGraphics();
+    glEnable(GL_DEPTH_TEST);
+    glClearColor(0.0f, 0.2f, 0.4f, 1.0f);
+    reshape(width, height);
+    std::printf("%d kicks, every frame slowed by %.1f ms; one step is %.2f ms\n", kicks, render_delay_ms,
+                SIM_STEP_SECONDS * 1000.0);
+    StressResult inline_result = stressRun(false, kicks, seed);
+    printStressResult("inline", inline_result);
+    StressResult threaded_result = stressRun(true, kicks, seed);
+    printStressResult("threaded", threaded_result);
+    return 0;
+#endif
 }
 
 // --- Main Function and GLUT Setup ---
 
+/**
+ * @brief Makes the next glutCreateWindow() ask for a GL 3.3 core profile. glutBitmapCharacter()
+ * needs a compatibility context, so the HUD font atlas is rasterised first in a hidden window.
+ */
+static void requestCoreProfileWindow()
+{
+#ifdef GLUT_CORE_PROFILE
+    int fonts_window = glutCreateWindow("");
+    glutHideWindow();
+    rasterizeGlyphAtlas(glyphAtlasPixels);
+    glutDestroyWindow(fonts_window);
+    glutInitContextVersion(3, 3);
+    glutInitContextProfile(GLUT_CORE_PROFILE);
+#else
+    std::cerr << "--gl-core needs freeglut; using the default context\n";
+    gl_core_profile = false;
+#endif
+}
+
 int main(int argc, char **argv)
 {
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--simulate") == 0)
+            return runHeadless(argc, argv);
+        if (std::strcmp(argv[i], "--render-frames") == 0)
+            return runOffscreen(argc, argv);
+        if (std::strcmp(argv[i], "--verify-replays") == 0)
+            return runReplayVerification(argc, argv);
+        if (std::strcmp(argv[i], "--host-matches") == 0)
+            return runHost(argc, argv);
+        if (std::strcmp(argv[i], "--tournament") == 0)
+            return runTournament(argc, argv);
+        if (std::strcmp(argv[i], "--ball-bench") == 0)
+            return runBallBench(argc, argv);
+        if (std::strcmp(argv[i], "--ai-bench") == 0)
+            return runAIBench(argc, argv);
+        if (std::strcmp(argv[i], "--bench") == 0)
+            return runBench(argc, argv);
+        if (std::strcmp(argv[i], "--netplay-bot") == 0)
+            return runNetplayBot(argc, argv);
+        if (std::strcmp(argv[i], "--sim-stress") == 0)
+            return runSimStress(argc, argv);
+        if (std::strcmp(argv[i], "--history-stats") == 0)
+            return runHistoryStats(argc, argv);
+    }
+
+    for (int i = 1; i < argc; i++)
+        parseRenderPathFlag(argv[i]); // Needed before the window, and so its context, exists
+
     glutInit(&argc, argv);
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
     glutInitWindowSize(window_width, window_height);
     glutInitWindowPosition(100, 100);
+    glut_initialised = true;
+    if (gl_core_profile)
+        requestCoreProfileWindow();
     glutCreateWindow("Penalty Shootout 3D - Refactored");
 
-    srand(static_cast<unsigned int>(time(NULL)));
-
     initGraphics();
+    uint64_t seed = (uint64_t)time(NULL);
+    const char *record_path = NULL, *replay_path = NULL, *history_path = NULL;
+    double replay_speed = 1.0;
+    bool vsync = true, sim_thread = false, keep_history = true;
+    Difficulty difficulty = DIFFICULTY_NORMAL;
+    unsigned char grid = CLASSIC_GRID;
+    NetConfig net_config = defaultNetConfig();
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--profile") == 0)
+            initProfiler(true, NULL);
+        else if (std::strcmp(argv[i], "--profile-csv") == 0 && i + 1 < argc)
+            initProfiler(false, argv[++i]);
+        else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+            seed = std::strtoull(argv[++i], NULL, 10);
+        else if (std::strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+            record_path = argv[++i];
+        else if (std::strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+            replay_path = argv[++i];
+        else if (std::strcmp(argv[i], "--speed") == 0 && i + 1 < argc)
+            replay_speed = std::max(0.01, std::atof(argv[++i]));
+        else if (std::strcmp(argv[i], "--difficulty") == 0 && i + 1 < argc && !parseDifficulty(argv[++i], difficulty))
+            std::cerr << "Unknown difficulty " << argv[i] << "; playing normal\n";
+        else if (std::strcmp(argv[i], "--grid") == 0 && i + 1 < argc && !parseTargetGrid(argv[++i], grid))
+            std::cerr << "Unknown grid " << argv[i] << "; playing 3x1\n";
+        else if (std::strcmp(argv[i], "--low-latency") == 0)
+            inputLatency.low_latency = inputLatency.measure = true;
+        else if (std::strcmp(argv[i], "--late-latch") == 0)
+            inputLatency.late_latch = true;
+        else if (std::strcmp(argv[i], "--input-latency") == 0)
+            inputLatency.measure = true;
+        else if (std::strcmp(argv[i], "--no-vsync") == 0)
+            vsync = false;
+        else if (std::strcmp(argv[i], "--sim-thread") == 0)
+            sim_thread = true;
+        else if (std::strcmp(argv[i], "--render-delay") == 0 && i + 1 < argc)
+        {
+            if (!parseRenderDelay(argv[++i]))
+            {
+                std::cerr << "Bad delay for --render-delay: " << argv[i] << "\n";
+                return 1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--history") == 0 && i + 1 < argc)
+            history_path = argv[++i];
+        else if (std::strcmp(argv[i], "--no-history") == 0)
+            keep_history = false;
+        else if (i + 1 < argc && isNetOption(argv[i]))
+        {
+            if (!parseNetOption(net_config, argv[i], argv[i + 1]))
+                return 1;
+            i++;
+        }
+    }
+    setSwapInterval(vsync ? 1 : 0);
+    if (inputLatency.measure)
+        std::atexit(printInputLatency);
+    match.rng = SimRng(seed);
+    resetOpponentModel(aiModel(match), difficulty);
+    match.grid = grid;
+    net_config.seed = seed;
+    net_config.grid = grid;
+    if (net_config.side >= 0 && !startNetplay(net_config))
+        return 1;
+    static Replay replay; // Outlives main()'s frame for the GLUT callbacks
+    if (replay_path && !loadReplay(replay_path, replay))
+        return 1;
+    if (record_path && !replay_path && !startReplayRecording(record_path, seed))
+        return 1;
+    if (keep_history && !replay_path && net_config.side < 0)
+    {
+        std::string path = history_path ? history_path : defaultHistoryPath();
+        if (!path.empty() && !openHistory(shotHistory, path, true))
+            std::cerr << "Playing on without a shot history\n";
+    }
     glEnable(GL_DEPTH_TEST);
     glClearColor(0.0f, 0.2f, 0.4f, 1.0f); // Sky blue
 
     // Register callbacks to the new primary functions
     glutDisplayFunc(renderScene); // Drawing function
     glutReshapeFunc(reshape);
-    glutKeyboardFunc(handleInput); // Input function
-    // The timer is started initially by handleInput calling startAnimation,
-    // which then calls updateGameLogic recursively via glutTimerFunc.
+    if (net_config.side >= 0)
+        glutKeyboardFunc(netplayKey); // Keys go to the lockstep queue, not straight to the match
+    else if (!replay_path)
+        glutKeyboardFunc(handleInput); // Input function; a replay supplies its own keys
+    glutSpecialFunc(handleSpecialInput);
+    // A kick starts in handleInput via startShot(), which runs gameLoop as a timer callback
+    // until updateGameLogic() resolves the shot.
 
-    resetGame();
+    resetMatch(match);
+    if (replay_path)
+    {
+        beginReplay(replay, replay_speed);
+        playback.last_time = std::chrono::steady_clock::now();
+        glutIdleFunc(replayLoop);
+    }
+    else if (net_config.side >= 0)
+        glutIdleFunc(netplayLoop); // Runs the lockstep clock for the whole session
+    if (sim_thread && (replay_path || net_config.side >= 0))
+        std::cerr << "--sim-thread is ignored for replays and netplay, which keep their own clocks\n";
+    else if (sim_thread)
+    {
+        startSimThread();
+        std::atexit(stopSimThread);
+        glutIdleFunc(simThreadIdle); // Draws the first snapshot; handleInput() registers it again per key
+    }
     glutMainLoop();
     return 0;
 }
\ No newline at end of file